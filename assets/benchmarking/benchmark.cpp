@@ -8,6 +8,7 @@
 #include "cli.h"
 #include "db.h"
 #include "query.h"
+#include "trace.h"
 #include "utils.h"
 
 std::vector<std::pair<Timestamp, Timestamp>> load_intervals_from_csv(const std::string& filename)
@@ -119,12 +120,33 @@ int main()
 	double rows_per_s = rows_per_us * 1000 * 1000; 
 	double cache_miss_percentage = db.get_table("benchmark")->get_metrics().get_cache_miss_percentage(); 
 	
+	// Batched query: the same intervals executed as one plan
+	std::vector<TableQuery> batch{};
+	batch.reserve(intervals.size());
+	for (const auto& [start, end] : intervals)
+	{
+		batch.push_back({ "benchmark", Query{ TimeRange{ start, end } } });
+	}
+	watch.start();
+	auto batch_results = db.query_batch(batch);
+	auto batch_time_us = watch.elapsed<stopwatch::mus>();
+
 	// Output operation times
 	std::cout << "Queries Ran: " << intervals.size() << "\n";
 	std::cout << "Average Query Time: " << avg_query_time_ms << " ms" << "\n";
 	std::cout << "Rows Queried: " << total_rows_queried << "\n";
 	std::cout << "Average Rows/s: " << rows_per_s << "\n";
 	std::cout << "DB_Cache Miss %: " << cache_miss_percentage << "\n";
+	std::cout << "Batched Query Time: " << static_cast<double>(batch_time_us) / 1000 << " ms ("
+			  << batch_results.size() << " queries)" << "\n";
+
+	// Timeline of the run, viewable in chrome://tracing or Perfetto
+	if (trace::enabled())
+	{
+		std::ofstream trace_file("assets/trace.json");
+		trace::dump_chrome_json(trace_file);
+		std::cout << "Trace written to assets/trace.json" << "\n";
+	}
 
 	return 0;
 }
@@ -0,0 +1,247 @@
+// Network load generator for tsdb_server.
+//
+// Opens several client connections and keeps `depth` pipelined queries in flight on each,
+// reporting requests per second and round-trip latency percentiles. Without --port or --unix
+// it starts an in-process server on a loopback port and preloads a table to query.
+//
+// Usage: loadtest [--connections=N] [--depth=N] [--duration=SECS] [--query-span=SECS]
+//                 [--preload=POINTS] [--port=N | --unix=PATH] [--table=NAME] [--path=DIR]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "client.h"
+#include "db.h"
+#include "query.h"
+#include "server.h"
+#include "utils.h"
+
+namespace
+{
+struct LoadConfig
+{
+	size_t connections{ 4 };
+	size_t depth{ 16 }; // Pipelined requests per round trip
+	double duration_secs{ 10 };
+	TimeDelta query_span_secs{ 3600 };
+	size_t preload_points{ 200000 };
+	long port{ -1 }; // -1 = start an in-process server
+	std::string unix_path{};
+	std::string table{ "loadtest" };
+	std::string path{ "tmp/loadtest" };
+};
+
+LoadConfig parse_args(int argc, char** argv)
+{
+	LoadConfig config{};
+	for (int i{ 1 }; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		auto eq = arg.find('=');
+		if (arg.rfind("--", 0) != 0 || eq == std::string::npos)
+		{
+			throw std::invalid_argument("Expected --name=value, got: " + arg);
+		}
+		std::string name = arg.substr(2, eq - 2);
+		std::string value = arg.substr(eq + 1);
+
+		if (name == "connections")
+			config.connections = std::max<size_t>(1, std::stoull(value));
+		else if (name == "depth")
+			config.depth = std::max<size_t>(1, std::stoull(value));
+		else if (name == "duration")
+			config.duration_secs = std::stod(value);
+		else if (name == "query-span")
+			config.query_span_secs = std::stoll(value);
+		else if (name == "preload")
+			config.preload_points = std::stoull(value);
+		else if (name == "port")
+			config.port = std::stol(value);
+		else if (name == "unix")
+			config.unix_path = value;
+		else if (name == "table")
+			config.table = value;
+		else if (name == "path")
+			config.path = value;
+		else
+			throw std::invalid_argument("Unknown option: --" + name);
+	}
+	return config;
+}
+
+using Clock = std::chrono::steady_clock;
+
+uint64_t elapsed_ns(Clock::time_point start)
+{
+	return static_cast<uint64_t>(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()
+	);
+}
+
+Client connect(const LoadConfig& config, uint16_t port)
+{
+	return config.unix_path.empty() ? Client::tcp("127.0.0.1", port) : Client::unix_socket(config.unix_path);
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+	LoadConfig config;
+	try
+	{
+		config = parse_args(argc, argv);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Error: " << e.what() << "\n";
+		return 1;
+	}
+
+	const Timestamp anchor = 1740618000;
+	std::unique_ptr<DataBase> db{};
+	std::unique_ptr<Server> server{};
+	std::thread server_thread{};
+	uint16_t port = static_cast<uint16_t>(std::max<long>(config.port, 0));
+
+	if (config.port < 0 && config.unix_path.empty())
+	{
+		std::filesystem::remove_all(config.path);
+		db = std::make_unique<DataBase>("loadtest", config.path);
+		server = std::make_unique<Server>(*db);
+		port = server->listen_tcp(0);
+		server_thread = std::thread([&]() { server->run(); });
+	}
+
+	Timestamp latest = anchor;
+	try
+	{
+		// Preload over the wire so an external server gets the same table
+		if (config.preload_points > 0)
+		{
+			auto client = connect(config, port);
+			Table::Config table_config{ 3600, 64, 12, 30, 1 };
+			auto names = client.table_names();
+			if (std::find(names.begin(), names.end(), config.table) == names.end())
+			{
+				client.create_table(config.table, table_config);
+			}
+			std::vector<DataPoint> points{};
+			for (size_t i{ 0 }; i < config.preload_points; i++)
+			{
+				points.push_back(DataPoint{ anchor + static_cast<Timestamp>(i), static_cast<double>(i % 1000) });
+				if (points.size() == 10000 || i + 1 == config.preload_points)
+				{
+					client.insert(config.table, points);
+					points.clear();
+				}
+			}
+			latest = anchor + static_cast<Timestamp>(config.preload_points);
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Error: " << e.what() << "\n";
+		if (server)
+		{
+			server->stop();
+			server_thread.join();
+		}
+		return 1;
+	}
+
+	std::atomic<bool> running{ true };
+	std::atomic<bool> failed{ false };
+	std::vector<std::vector<uint64_t>> latencies(config.connections);
+	std::vector<uint64_t> rows(config.connections, 0);
+	std::vector<std::thread> threads{};
+
+	for (size_t c{ 0 }; c < config.connections; c++)
+	{
+		threads.emplace_back([&, c]() {
+			try
+			{
+				auto client = connect(config, port);
+				std::mt19937_64 rng(300 + c);
+				std::uniform_int_distribution<Timestamp> end_ts(anchor + config.query_span_secs, std::max(latest, anchor + config.query_span_secs));
+				std::vector<TableQuery> batch(config.depth);
+
+				while (running.load(std::memory_order_relaxed))
+				{
+					for (auto& query : batch)
+					{
+						Timestamp end = end_ts(rng);
+						query = TableQuery{ config.table, Query{ TimeRange{ end - config.query_span_secs, end } } };
+					}
+					auto op_start = Clock::now();
+					auto results = client.query_pipelined(batch);
+					latencies[c].push_back(elapsed_ns(op_start));
+					for (const auto& result : results)
+					{
+						rows[c] += result.size();
+					}
+				}
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << "Connection " << c << ": " << e.what() << "\n";
+				failed = true;
+			}
+		});
+	}
+
+	const auto run_start = Clock::now();
+	std::this_thread::sleep_for(std::chrono::duration<double>(config.duration_secs));
+	running = false;
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+	const double secs = static_cast<double>(elapsed_ns(run_start)) / 1e9;
+
+	if (server)
+	{
+		server->stop();
+		server_thread.join();
+	}
+
+	std::vector<uint64_t> merged{};
+	uint64_t total_rows{ 0 };
+	for (size_t c{ 0 }; c < config.connections; c++)
+	{
+		merged.insert(merged.end(), latencies[c].begin(), latencies[c].end());
+		total_rows += rows[c];
+	}
+	std::sort(merged.begin(), merged.end());
+	auto percentile_us = [&](double q) {
+		if (merged.empty())
+			return 0.0;
+		auto index = static_cast<size_t>(q * static_cast<double>(merged.size() - 1));
+		return static_cast<double>(merged[index]) / 1000;
+	};
+
+	const double requests = static_cast<double>(merged.size() * config.depth);
+	std::cout << "Connections: " << config.connections << ", Depth: " << config.depth
+			  << ", Duration: " << secs << " s\n\n";
+	std::cout << std::right << std::setw(12) << "requests/s" << std::setw(14) << "rows/s"
+			  << std::setw(11) << "p50 us" << std::setw(11) << "p99 us" << std::setw(11)
+			  << "p999 us" << "\n";
+	std::cout << std::setw(12) << std::fixed << std::setprecision(1) << requests / secs
+			  << std::setw(14) << total_rows / secs << std::setw(11) << percentile_us(0.5)
+			  << std::setw(11) << percentile_us(0.99) << std::setw(11) << percentile_us(0.999)
+			  << "\n";
+	std::cout << "(latency is per pipelined round trip of " << config.depth << " requests)\n";
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,297 @@
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "chunk.h"
+#include "chunkfile.h"
+#include "db.h"
+#include "query.h"
+#include "table.h"
+#include "tree.h"
+#include "utils.h"
+
+// Synthetic data shared by every benchmark: a random walk sampled at a fixed resolution
+namespace
+{
+constexpr Timestamp ANCHOR_TS = 1740618000;
+constexpr TimeDelta RESOLUTION_SECS = 1;
+constexpr TimeDelta CHUNK_SECS = 4096;
+
+std::vector<DataPoint> generate_series(size_t count, Timestamp start = ANCHOR_TS)
+{
+	std::mt19937_64 rng(42);
+	std::normal_distribution<double> step(0.0, 1.0);
+	std::vector<DataPoint> points{};
+	points.reserve(count);
+	double value = 100.0;
+	for (size_t i{ 0 }; i < count; i++)
+	{
+		value += step(rng);
+		points.push_back(DataPoint{ start + static_cast<Timestamp>(i) * RESOLUTION_SECS, value });
+	}
+	return points;
+}
+
+std::string scratch_dir(const std::string& name)
+{
+	auto path = std::filesystem::temp_directory_path() / "tsdb_microbench" / name;
+	std::filesystem::remove_all(path);
+	std::filesystem::create_directories(path);
+	return path.string();
+}
+
+std::unique_ptr<Chunk> make_full_chunk(size_t rows)
+{
+	auto chunk = std::make_unique<Chunk>(
+		TimeRange{ ANCHOR_TS, ANCHOR_TS + static_cast<Timestamp>(rows) * RESOLUTION_SECS },
+		1,
+		rows
+	);
+	for (const auto& point : generate_series(rows))
+	{
+		chunk->append(point);
+	}
+	return chunk;
+}
+
+ChunkMetadata make_metadata(ChunkId id, Timestamp start, TimeDelta width)
+{
+	return ChunkMetadata{
+		.chunk_id = id,
+		.chunk_range = TimeRange{ start, start + width },
+		.row_count = 0,
+		.capacity = 1,
+		.min_value = 0.0,
+		.max_value = 0.0,
+		.value_type = ValueType::Float64,
+		.columns = 1,
+		.resolution = 0,
+	};
+}
+} // namespace
+
+// Chunk
+static void BM_ChunkAppend(benchmark::State& state)
+{
+	const auto rows = static_cast<size_t>(state.range(0));
+	auto points = generate_series(rows);
+	for (auto _ : state)
+	{
+		Chunk chunk(TimeRange{ ANCHOR_TS, ANCHOR_TS + static_cast<Timestamp>(rows) }, 1, rows);
+		for (const auto& point : points)
+		{
+			chunk.append(point);
+		}
+		benchmark::DoNotOptimize(chunk.size());
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ChunkAppend)->Arg(1 << 10)->Arg(1 << 14)->Arg(1 << 17);
+
+// Range scan at a given selectivity (percent of the chunk)
+static void BM_ChunkGetDataInRange(benchmark::State& state)
+{
+	constexpr size_t rows = 1 << 16;
+	auto chunk = make_full_chunk(rows);
+	const auto width = static_cast<Timestamp>(rows * state.range(0) / 100);
+	const TimeRange range{ ANCHOR_TS + (static_cast<Timestamp>(rows) - width) / 2,
+						   ANCHOR_TS + (static_cast<Timestamp>(rows) + width) / 2 - 1 };
+	for (auto _ : state)
+	{
+		auto results = chunk->get_data_in_range(range);
+		benchmark::DoNotOptimize(results.data());
+	}
+	state.SetItemsProcessed(state.iterations() * width);
+}
+BENCHMARK(BM_ChunkGetDataInRange)->Arg(1)->Arg(10)->Arg(50)->Arg(100);
+
+// Whole chunk scan with a value predicate at a given selectivity (percent of values kept)
+static void BM_ChunkPredicateScan(benchmark::State& state)
+{
+	constexpr size_t rows = 1 << 16;
+	auto chunk = std::make_unique<Chunk>(TimeRange{ 0, static_cast<Timestamp>(rows) }, 1, rows);
+	std::mt19937_64 rng(7);
+	std::uniform_real_distribution<double> uniform(0.0, 100.0);
+	for (size_t i{ 0 }; i < rows; i++)
+	{
+		chunk->append(DataPoint{ static_cast<Timestamp>(i), uniform(rng) });
+	}
+	const auto predicate = ValuePredicate::less(static_cast<double>(state.range(0)));
+	for (auto _ : state)
+	{
+		auto results = chunk->get_data_in_range(TimeRange(), predicate);
+		benchmark::DoNotOptimize(results.data());
+	}
+	state.SetItemsProcessed(state.iterations() * rows);
+}
+BENCHMARK(BM_ChunkPredicateScan)->Arg(1)->Arg(10)->Arg(50)->Arg(100);
+
+// ChunkFile
+static void BM_ChunkFileSave(benchmark::State& state)
+{
+	const auto rows = static_cast<size_t>(state.range(0));
+	auto chunk = make_full_chunk(rows);
+	ChunkFile file(scratch_dir("save"), chunk->metadata());
+	for (auto _ : state)
+	{
+		file.save(*chunk);
+	}
+	state.SetBytesProcessed(state.iterations() * rows * (sizeof(Timestamp) + sizeof(double)));
+}
+BENCHMARK(BM_ChunkFileSave)->Arg(1 << 10)->Arg(1 << 14)->Arg(1 << 17);
+
+static void BM_ChunkFileLoad(benchmark::State& state)
+{
+	const auto rows = static_cast<size_t>(state.range(0));
+	auto chunk = make_full_chunk(rows);
+	ChunkFile file(scratch_dir("load"), chunk->metadata());
+	file.save(*chunk);
+	for (auto _ : state)
+	{
+		auto loaded = file.load();
+		benchmark::DoNotOptimize(loaded.get());
+	}
+	state.SetBytesProcessed(state.iterations() * rows * (sizeof(Timestamp) + sizeof(double)));
+}
+BENCHMARK(BM_ChunkFileLoad)->Arg(1 << 10)->Arg(1 << 14)->Arg(1 << 17);
+
+// ChunkTree
+static void BM_ChunkTreeInsert(benchmark::State& state)
+{
+	const auto num_chunks = static_cast<size_t>(state.range(0));
+	std::vector<std::shared_ptr<ChunkFile>> files{};
+	files.reserve(num_chunks);
+	for (size_t i{ 0 }; i < num_chunks; i++)
+	{
+		files.push_back(std::make_shared<ChunkFile>(
+			"", make_metadata(static_cast<ChunkId>(i), static_cast<Timestamp>(i) * CHUNK_SECS, CHUNK_SECS)
+		));
+	}
+	for (auto _ : state)
+	{
+		ChunkTree tree("", CHUNK_SECS);
+		for (const auto& file : files)
+		{
+			tree.insert(file->get_metadata().chunk_range, file);
+		}
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * num_chunks);
+}
+BENCHMARK(BM_ChunkTreeInsert)->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMillisecond);
+
+// Lookup of a window spanning 16 chunks at a random position
+static void BM_ChunkTreeRangeQuery(benchmark::State& state)
+{
+	const auto num_chunks = static_cast<size_t>(state.range(0));
+	ChunkTree tree("", CHUNK_SECS);
+	for (size_t i{ 0 }; i < num_chunks; i++)
+	{
+		auto metadata =
+			make_metadata(static_cast<ChunkId>(i), static_cast<Timestamp>(i) * CHUNK_SECS, CHUNK_SECS);
+		tree.insert(metadata.chunk_range, std::make_shared<ChunkFile>("", metadata));
+	}
+	std::mt19937_64 rng(3);
+	std::uniform_int_distribution<size_t> position(0, num_chunks - 1);
+	for (auto _ : state)
+	{
+		Timestamp start = static_cast<Timestamp>(position(rng)) * CHUNK_SECS;
+		auto files = tree.range_query(TimeRange{ start, start + 16 * CHUNK_SECS });
+		benchmark::DoNotOptimize(files.data());
+	}
+}
+BENCHMARK(BM_ChunkTreeRangeQuery)->RangeMultiplier(10)->Range(1000, 1000000);
+
+// Table queries served from the chunk cache, or loaded from disk on every query
+static void table_query(benchmark::State& state, size_t cache_size)
+{
+	constexpr size_t num_chunks = 64;
+	DataBase db{ "microbench", scratch_dir("table") };
+	Table::Config config{ CHUNK_SECS, cache_size, 12, 30, RESOLUTION_SECS };
+	db.create_table("bench", config);
+	db.insert("bench", generate_series(num_chunks * CHUNK_SECS, 0));
+
+	// Stride through chunks so a small cache never holds the next one
+	size_t chunk_index{ 0 };
+	for (auto _ : state)
+	{
+		Timestamp start = static_cast<Timestamp>(chunk_index) * CHUNK_SECS;
+		auto results = db.query("bench", Query{ TimeRange{ start, start + CHUNK_SECS - 1 } });
+		benchmark::DoNotOptimize(results.data());
+		chunk_index = (chunk_index + 7) % num_chunks;
+	}
+	const auto& metrics = db.get_table("bench")->get_metrics();
+	state.counters["cache_miss_pct"] = metrics.get_cache_miss_percentage();
+}
+
+static void BM_TableQueryCacheHit(benchmark::State& state)
+{
+	table_query(state, 128);
+}
+BENCHMARK(BM_TableQueryCacheHit);
+
+static void BM_TableQueryCacheMiss(benchmark::State& state)
+{
+	table_query(state, 2);
+}
+BENCHMARK(BM_TableQueryCacheMiss);
+
+// CSV parsing
+static void BM_LoadDataFromCSV(benchmark::State& state)
+{
+	const auto rows = static_cast<size_t>(state.range(0));
+	const auto dir = scratch_dir("csv");
+	const auto path = dir + "/data.csv";
+	{
+		std::ofstream csv(path);
+		csv << "Timestamp,Value\n";
+		for (const auto& point : generate_series(rows))
+		{
+			csv << point.ts << ',' << point.value << '\n';
+		}
+	}
+
+	DataBase db{ "microbench", dir };
+	for (auto _ : state)
+	{
+		auto data = db.load_data_from_csv(path);
+		benchmark::DoNotOptimize(data.data());
+	}
+	state.SetItemsProcessed(state.iterations() * rows);
+}
+BENCHMARK(BM_LoadDataFromCSV)->Arg(1 << 14)->Arg(1 << 18)->Unit(benchmark::kMillisecond);
+
+// Results are always written as JSON (microbenchmarks.json unless --benchmark_out is given)
+// so runs can be compared between releases, e.g. with google benchmark's compare.py.
+int main(int argc, char** argv)
+{
+	std::vector<char*> args(argv, argv + argc);
+	std::string out_arg = "--benchmark_out=microbenchmarks.json";
+	std::string format_arg = "--benchmark_out_format=json";
+	bool has_out = false;
+	for (int i{ 1 }; i < argc; i++)
+	{
+		has_out |= std::string(argv[i]).rfind("--benchmark_out=", 0) == 0;
+	}
+	if (!has_out)
+	{
+		args.push_back(out_arg.data());
+		args.push_back(format_arg.data());
+	}
+
+	int args_count = static_cast<int>(args.size());
+	benchmark::Initialize(&args_count, args.data());
+	if (benchmark::ReportUnrecognizedArguments(args_count, args.data()))
+	{
+		return 1;
+	}
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
@@ -0,0 +1,280 @@
+// Concurrent mixed read/write workload driver.
+//
+// Runs writer and reader threads against one DataBase table and reports throughput and
+// latency percentiles per operation type. All data is generated in-process.
+//
+// Usage: workload [--writers=N] [--readers=N] [--duration=SECS] [--batch=POINTS]
+//                 [--insert-rate=POINTS_PER_SEC_PER_WRITER] [--query-span=SECS]
+//                 [--recent-fraction=F] [--recent-window=SECS] [--preload=POINTS]
+//                 [--resolution=SECS] [--chunk-secs=SECS] [--cache-chunks=N]
+//                 [--path=DIR]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "db.h"
+#include "query.h"
+#include "utils.h"
+
+namespace
+{
+struct WorkloadConfig
+{
+	size_t writers{ 2 };
+	size_t readers{ 4 };
+	double duration_secs{ 10 };
+	size_t batch_points{ 100 };
+	double insert_rate{ 0 }; // Points per second per writer, 0 = unthrottled
+	TimeDelta query_span_secs{ 3600 };
+	double recent_fraction{ 0.8 }; // Share of queries hitting the most recent window
+	TimeDelta recent_window_secs{ 6 * 3600 };
+	size_t preload_points{ 100000 };
+	TimeDelta resolution_secs{ 1 };
+	TimeDelta chunk_secs{ 3600 };
+	size_t cache_chunks{ 64 };
+	std::string path{ "tmp/workload" };
+};
+
+WorkloadConfig parse_args(int argc, char** argv)
+{
+	WorkloadConfig config{};
+	for (int i{ 1 }; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		auto eq = arg.find('=');
+		if (arg.rfind("--", 0) != 0 || eq == std::string::npos)
+		{
+			throw std::invalid_argument("Expected --name=value, got: " + arg);
+		}
+		std::string name = arg.substr(2, eq - 2);
+		std::string value = arg.substr(eq + 1);
+
+		if (name == "writers")
+			config.writers = std::stoull(value);
+		else if (name == "readers")
+			config.readers = std::stoull(value);
+		else if (name == "duration")
+			config.duration_secs = std::stod(value);
+		else if (name == "batch")
+			config.batch_points = std::max<size_t>(1, std::stoull(value));
+		else if (name == "insert-rate")
+			config.insert_rate = std::stod(value);
+		else if (name == "query-span")
+			config.query_span_secs = std::stoll(value);
+		else if (name == "recent-fraction")
+			config.recent_fraction = std::stod(value);
+		else if (name == "recent-window")
+			config.recent_window_secs = std::stoll(value);
+		else if (name == "preload")
+			config.preload_points = std::stoull(value);
+		else if (name == "resolution")
+			config.resolution_secs = std::stoll(value);
+		else if (name == "chunk-secs")
+			config.chunk_secs = std::stoll(value);
+		else if (name == "cache-chunks")
+			config.cache_chunks = std::stoull(value);
+		else if (name == "path")
+			config.path = value;
+		else
+			throw std::invalid_argument("Unknown option: --" + name);
+	}
+	return config;
+}
+
+// Per-thread results, merged once the run ends
+struct OpResults
+{
+	std::vector<uint64_t> latencies_ns{};
+	uint64_t items{ 0 }; // Points written or rows returned
+};
+
+using Clock = std::chrono::steady_clock;
+
+uint64_t elapsed_ns(Clock::time_point start)
+{
+	return static_cast<uint64_t>(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()
+	);
+}
+
+// Synthetic series: a noisy daily sine wave
+double sample_value(Timestamp ts, std::mt19937_64& rng)
+{
+	std::normal_distribution<double> noise(0.0, 0.5);
+	return 50.0 + 20.0 * std::sin(static_cast<double>(ts) * 2 * 3.14159265358979 / 86400) + noise(rng);
+}
+
+void report(const std::string& name, std::vector<OpResults>& per_thread, double secs)
+{
+	std::vector<uint64_t> latencies{};
+	uint64_t items{ 0 };
+	for (auto& results : per_thread)
+	{
+		latencies.insert(latencies.end(), results.latencies_ns.begin(), results.latencies_ns.end());
+		items += results.items;
+	}
+	std::sort(latencies.begin(), latencies.end());
+
+	auto percentile_us = [&](double q) {
+		if (latencies.empty())
+			return 0.0;
+		auto index = static_cast<size_t>(q * static_cast<double>(latencies.size() - 1));
+		return static_cast<double>(latencies[index]) / 1000;
+	};
+
+	std::cout << std::left << std::setw(8) << name << std::right << std::setw(10)
+			  << latencies.size() << std::setw(12) << std::fixed << std::setprecision(1)
+			  << latencies.size() / secs << std::setw(14) << items / secs << std::setw(11)
+			  << percentile_us(0.5) << std::setw(11) << percentile_us(0.99) << std::setw(11)
+			  << percentile_us(0.999) << std::setw(12) << percentile_us(1.0) << "\n";
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+	WorkloadConfig config;
+	try
+	{
+		config = parse_args(argc, argv);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Error: " << e.what() << "\n";
+		return 1;
+	}
+
+	std::filesystem::remove_all(config.path);
+	DataBase db{ "workload", config.path };
+	Table::Config table_config{ config.chunk_secs, config.cache_chunks, 12, 30, config.resolution_secs };
+	db.create_table("workload", table_config);
+
+	// Each batch claims a block of timestamps from a shared clock, so concurrent batches land
+	// slightly out of order, as they would from independent collectors
+	const Timestamp anchor = 1740618000;
+	std::atomic<Timestamp> next_ts{ anchor };
+	std::atomic<Timestamp> latest_ts{ anchor };
+
+	// Preload history so historical queries have something to read
+	{
+		std::mt19937_64 rng(1);
+		std::vector<DataPoint> points{};
+		points.reserve(config.preload_points);
+		for (size_t i{ 0 }; i < config.preload_points; i++)
+		{
+			Timestamp ts = next_ts.fetch_add(config.resolution_secs);
+			points.push_back(DataPoint{ ts, sample_value(ts, rng) });
+		}
+		db.insert("workload", points);
+		latest_ts = next_ts.load() - config.resolution_secs;
+	}
+
+	std::atomic<bool> running{ true };
+	std::vector<OpResults> writer_results(config.writers);
+	std::vector<OpResults> reader_results(config.readers);
+	std::vector<std::thread> threads{};
+
+	for (size_t w{ 0 }; w < config.writers; w++)
+	{
+		threads.emplace_back([&, w]() {
+			std::mt19937_64 rng(100 + w);
+			auto& results = writer_results[w];
+			std::vector<DataPoint> batch{};
+			batch.reserve(config.batch_points);
+			const auto start = Clock::now();
+			uint64_t written{ 0 };
+
+			while (running.load(std::memory_order_relaxed))
+			{
+				// Throttle to the configured rate
+				if (config.insert_rate > 0)
+				{
+					auto due = start + std::chrono::duration_cast<Clock::duration>(
+										   std::chrono::duration<double>(written / config.insert_rate)
+									   );
+					std::this_thread::sleep_until(due);
+				}
+
+				batch.clear();
+				Timestamp first_ts = next_ts.fetch_add(config.resolution_secs * config.batch_points);
+				for (size_t i{ 0 }; i < config.batch_points; i++)
+				{
+					Timestamp ts = first_ts + static_cast<Timestamp>(i) * config.resolution_secs;
+					batch.push_back(DataPoint{ ts, sample_value(ts, rng) });
+				}
+
+				auto op_start = Clock::now();
+				db.insert("workload", batch);
+				results.latencies_ns.push_back(elapsed_ns(op_start));
+
+				Timestamp latest = latest_ts.load();
+				while (batch.back().ts > latest && !latest_ts.compare_exchange_weak(latest, batch.back().ts))
+				{
+				}
+				results.items += batch.size();
+				written += batch.size();
+			}
+		});
+	}
+
+	for (size_t r{ 0 }; r < config.readers; r++)
+	{
+		threads.emplace_back([&, r]() {
+			std::mt19937_64 rng(200 + r);
+			std::uniform_real_distribution<double> unit(0.0, 1.0);
+			auto& results = reader_results[r];
+
+			while (running.load(std::memory_order_relaxed))
+			{
+				// Recent queries end at the head; historical ones anywhere in the series
+				Timestamp latest = latest_ts.load();
+				Timestamp span = static_cast<Timestamp>(config.query_span_secs * (0.5 + unit(rng)));
+				Timestamp end_ts{};
+				if (unit(rng) < config.recent_fraction)
+				{
+					end_ts = latest - static_cast<Timestamp>(unit(rng) * config.recent_window_secs);
+				}
+				else
+				{
+					end_ts = anchor + static_cast<Timestamp>(unit(rng) * (latest - anchor));
+				}
+
+				auto op_start = Clock::now();
+				size_t rows = db.query("workload", Query{ TimeRange{ end_ts - span, end_ts } }).size();
+				results.latencies_ns.push_back(elapsed_ns(op_start));
+				results.items += rows;
+			}
+		});
+	}
+
+	const auto run_start = Clock::now();
+	std::this_thread::sleep_for(std::chrono::duration<double>(config.duration_secs));
+	running = false;
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+	const double secs = static_cast<double>(elapsed_ns(run_start)) / 1e9;
+
+	std::cout << "Writers: " << config.writers << ", Readers: " << config.readers
+			  << ", Duration: " << secs << " s, Rows: " << db.get_table("workload")->rows() << "\n\n";
+	std::cout << std::left << std::setw(8) << "op" << std::right << std::setw(10) << "count"
+			  << std::setw(12) << "ops/s" << std::setw(14) << "items/s" << std::setw(11)
+			  << "p50 us" << std::setw(11) << "p99 us" << std::setw(11) << "p999 us"
+			  << std::setw(12) << "max us" << "\n";
+	report("insert", writer_results, secs);
+	report("query", reader_results, secs);
+
+	return 0;
+}
@@ -0,0 +1,335 @@
+#include "aio.h"
+#include "config.h"
+#include "trace.h"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <thread_pool/thread_pool.h>
+#include <vector>
+
+namespace {
+// Larger transfers are split, as a read or write length is 32 bits
+constexpr size_t MAX_TRANSFER_BYTES{size_t{1} << 30};
+
+int io_uring_setup(unsigned entries, io_uring_params *params) {
+	return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+	return static_cast<int>(
+		syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+	return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+// A submission and completion queue pair mapped from the kernel. Used by one batch at a time.
+class Ring {
+  public:
+	explicit Ring(unsigned entries) {
+		io_uring_params params{};
+		m_fd = io_uring_setup(entries, &params);
+		if (m_fd < 0) {
+			throw std::system_error(errno, std::generic_category(), "io_uring_setup");
+		}
+		m_entries = params.sq_entries;
+
+		m_sq_bytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		m_cq_bytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+		if (single_mmap) {
+			m_sq_bytes = m_cq_bytes = std::max(m_sq_bytes, m_cq_bytes);
+		}
+		m_sq = map(m_sq_bytes, IORING_OFF_SQ_RING);
+		m_cq = single_mmap ? m_sq : map(m_cq_bytes, IORING_OFF_CQ_RING);
+		m_sqe_bytes = params.sq_entries * sizeof(io_uring_sqe);
+		m_sqes = static_cast<io_uring_sqe *>(map(m_sqe_bytes, IORING_OFF_SQES));
+
+		auto *sq = static_cast<char *>(m_sq);
+		m_sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+		m_sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+		m_sq_mask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+		m_sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+		auto *cq = static_cast<char *>(m_cq);
+		m_cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+		m_cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+		m_cq_mask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+		m_cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+	}
+
+	~Ring() { release(); }
+
+	Ring(const Ring &) = delete;
+	Ring &operator=(const Ring &) = delete;
+
+	bool supports(uint8_t opcode) const {
+		constexpr unsigned ops{256};
+		std::vector<char> storage(sizeof(io_uring_probe) + ops * sizeof(io_uring_probe_op), 0);
+		auto *probe = reinterpret_cast<io_uring_probe *>(storage.data());
+		if (io_uring_register(m_fd, IORING_REGISTER_PROBE, probe, ops) < 0) {
+			return false;
+		}
+		return opcode <= probe->last_op && (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED);
+	}
+
+	void run(std::span<aio::Request> requests) {
+		TSDB_TRACE_SPAN("aio.uring_batch");
+		std::vector<size_t> done(requests.size(), 0);
+		std::deque<size_t> waiting{};
+		for (size_t i{0}; i < requests.size(); i++) {
+			waiting.push_back(i);
+		}
+
+		size_t in_flight{0};
+		while (!waiting.empty() || in_flight > 0) {
+			// Queue as many transfers as there are free slots, then submit and wait for one
+			unsigned tail = std::atomic_ref<unsigned>(*m_sq_tail).load(std::memory_order_relaxed);
+			while (!waiting.empty() && in_flight < m_entries) {
+				const size_t i = waiting.front();
+				waiting.pop_front();
+				const auto &request = requests[i];
+				const unsigned index = tail & m_sq_mask;
+				io_uring_sqe &sqe = m_sqes[index];
+				std::memset(&sqe, 0, sizeof(sqe));
+				sqe.opcode = request.write ? IORING_OP_WRITE : IORING_OP_READ;
+				sqe.fd = request.fd;
+				sqe.off = request.offset + done[i];
+				sqe.addr = reinterpret_cast<uint64_t>(request.data + done[i]);
+				sqe.len = static_cast<uint32_t>(std::min(request.length - done[i], MAX_TRANSFER_BYTES));
+				sqe.user_data = i;
+				m_sq_array[index] = index;
+				tail++;
+				in_flight++;
+			}
+			std::atomic_ref<unsigned>(*m_sq_tail).store(tail, std::memory_order_release);
+
+			// Entries the kernel has not consumed yet, including any left by an interrupted call
+			const unsigned to_submit =
+				tail - std::atomic_ref<unsigned>(*m_sq_head).load(std::memory_order_acquire);
+			if (io_uring_enter(m_fd, to_submit, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR &&
+				errno != EAGAIN && errno != EBUSY) {
+				throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+			}
+
+			unsigned head = std::atomic_ref<unsigned>(*m_cq_head).load(std::memory_order_relaxed);
+			const unsigned ready = std::atomic_ref<unsigned>(*m_cq_tail).load(std::memory_order_acquire);
+			for (; head != ready; head++) {
+				const io_uring_cqe &cqe = m_cqes[head & m_cq_mask];
+				const auto i = static_cast<size_t>(cqe.user_data);
+				auto &request = requests[i];
+				in_flight--;
+				if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+					waiting.push_back(i);
+				} else if (cqe.res < 0) {
+					request.result = cqe.res;
+				} else {
+					done[i] += static_cast<size_t>(cqe.res);
+					if (cqe.res > 0 && done[i] < request.length) {
+						waiting.push_back(i);
+					} else {
+						request.result = static_cast<ssize_t>(done[i]);
+					}
+				}
+			}
+			std::atomic_ref<unsigned>(*m_cq_head).store(head, std::memory_order_release);
+		}
+	}
+
+  private:
+	int m_fd{-1};
+	unsigned m_entries{0};
+	void *m_sq{MAP_FAILED};
+	void *m_cq{MAP_FAILED};
+	io_uring_sqe *m_sqes{nullptr};
+	size_t m_sq_bytes{0};
+	size_t m_cq_bytes{0};
+	size_t m_sqe_bytes{0};
+	unsigned *m_sq_head{nullptr};
+	unsigned *m_sq_tail{nullptr};
+	unsigned m_sq_mask{0};
+	unsigned *m_sq_array{nullptr};
+	unsigned *m_cq_head{nullptr};
+	unsigned *m_cq_tail{nullptr};
+	unsigned m_cq_mask{0};
+	io_uring_cqe *m_cqes{nullptr};
+
+	void *map(size_t bytes, off_t offset) {
+		void *mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, offset);
+		if (mapped == MAP_FAILED) {
+			const int error = errno;
+			release();
+			throw std::system_error(error, std::generic_category(), "io_uring mmap");
+		}
+		return mapped;
+	}
+
+	void release() {
+		if (m_sqes) {
+			munmap(m_sqes, m_sqe_bytes);
+			m_sqes = nullptr;
+		}
+		if (m_cq != MAP_FAILED && m_cq != m_sq) {
+			munmap(m_cq, m_cq_bytes);
+		}
+		if (m_sq != MAP_FAILED) {
+			munmap(m_sq, m_sq_bytes);
+		}
+		m_sq = m_cq = MAP_FAILED;
+		if (m_fd >= 0) {
+			close(m_fd);
+			m_fd = -1;
+		}
+	}
+};
+
+class UringEngine : public aio::Engine {
+  public:
+	UringEngine() {
+		auto ring = std::make_unique<Ring>(Config::AIO_QUEUE_DEPTH);
+		if (!ring->supports(IORING_OP_READ) || !ring->supports(IORING_OP_WRITE)) {
+			throw std::runtime_error("io_uring lacks read and write");
+		}
+		m_free.push_back(std::move(ring));
+	}
+
+	void submit(std::span<aio::Request> requests) override {
+		if (requests.empty())
+			return;
+		// Each concurrent batch gets its own ring, so batches never wait on each other
+		std::unique_ptr<Ring> ring{};
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_free.empty()) {
+				ring = std::move(m_free.back());
+				m_free.pop_back();
+			}
+		}
+		if (!ring) {
+			ring = std::make_unique<Ring>(Config::AIO_QUEUE_DEPTH);
+		}
+		// A ring that failed mid batch is dropped rather than reused
+		ring->run(requests);
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_free.push_back(std::move(ring));
+	}
+
+	aio::Backend backend() const override { return aio::Backend::Uring; }
+
+  private:
+	std::mutex m_mutex;
+	std::vector<std::unique_ptr<Ring>> m_free;
+};
+
+void transfer(aio::Request &request) {
+	size_t done{0};
+	while (done < request.length) {
+		const size_t length = std::min(request.length - done, MAX_TRANSFER_BYTES);
+		const auto offset = static_cast<off_t>(request.offset + done);
+		ssize_t count = request.write ? pwrite(request.fd, request.data + done, length, offset)
+									  : pread(request.fd, request.data + done, length, offset);
+		if (count < 0) {
+			if (errno == EINTR)
+				continue;
+			request.result = -errno;
+			return;
+		}
+		if (count == 0)
+			break;
+		done += static_cast<size_t>(count);
+	}
+	request.result = static_cast<ssize_t>(done);
+}
+
+class ThreadEngine : public aio::Engine {
+  public:
+	void submit(std::span<aio::Request> requests) override {
+		TSDB_TRACE_SPAN("aio.thread_batch");
+		if (requests.size() == 1) {
+			transfer(requests[0]);
+			return;
+		}
+		std::vector<std::future<void>> futures{};
+		futures.reserve(requests.size());
+		for (auto &request : requests) {
+			futures.push_back(m_pool.enqueue([&request]() { transfer(request); }));
+		}
+		for (auto &future : futures) {
+			future.get();
+		}
+	}
+
+	aio::Backend backend() const override { return aio::Backend::Threads; }
+
+  private:
+	dp::thread_pool<> m_pool{Config::AIO_THREADS};
+};
+} // namespace
+
+std::unique_ptr<aio::Engine> aio::make_engine(Backend preferred) {
+	if (preferred == Backend::Uring) {
+		try {
+			return std::make_unique<UringEngine>();
+		} catch (const std::exception &) {
+			// Not permitted or not supported here; preads on threads work everywhere
+		}
+	}
+	return std::make_unique<ThreadEngine>();
+}
+
+aio::Engine &aio::default_engine() {
+	static const std::unique_ptr<Engine> engine = [] {
+		const char *forced = std::getenv("TSDB_AIO");
+		const bool threads = forced && std::string_view(forced) == "threads";
+		return make_engine(threads ? Backend::Threads : Backend::Uring);
+	}();
+	return *engine;
+}
+
+aio::Buffer aio::BufferPool::acquire(size_t size) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto best = m_free.end();
+		for (auto it = m_free.begin(); it != m_free.end(); ++it) {
+			if (it->capacity >= size && (best == m_free.end() || it->capacity < best->capacity)) {
+				best = it;
+			}
+		}
+		if (best != m_free.end()) {
+			Buffer buffer = std::move(*best);
+			m_free.erase(best);
+			buffer.size = size;
+			return buffer;
+		}
+	}
+	// At least one byte, so even an empty transfer has a valid address
+	const size_t capacity = std::max<size_t>(size, 1);
+	return Buffer{std::make_unique_for_overwrite<char[]>(capacity), size, capacity};
+}
+
+void aio::BufferPool::release(Buffer &&buffer) {
+	if (!buffer.data || buffer.capacity > m_max_buffer_bytes)
+		return;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_free.size() < m_max_buffers) {
+		m_free.push_back(std::move(buffer));
+	}
+}
+
+aio::BufferPool &aio::default_buffer_pool() {
+	static BufferPool pool(Config::AIO_POOL_BUFFERS, Config::AIO_POOL_BUFFER_BYTES);
+	return pool;
+}
@@ -0,0 +1,208 @@
+#include "bulk.h"
+#include "chunk.h"
+#include "codec.h"
+#include "column.h"
+#include "datapoint.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+// Encodes and writes one block of columns, then empties them
+void write_block(std::ostream &out, std::vector<Timestamp> &timestamps,
+				 std::vector<std::vector<double>> &columns, bool compress, std::vector<char> &payload,
+				 bulk::TransferStats &stats) {
+	if (timestamps.empty())
+		return;
+	TSDB_TRACE_SPAN("bulk.write_block");
+	payload.clear();
+	if (compress) {
+		codec::encode_timestamps(timestamps.data(), timestamps.size(), payload);
+		for (const auto &values : columns) {
+			codec::encode_values(values.data(), values.size(), payload);
+		}
+	} else {
+		const char *ts_bytes = reinterpret_cast<const char *>(timestamps.data());
+		payload.insert(payload.end(), ts_bytes, ts_bytes + timestamps.size() * sizeof(Timestamp));
+		for (const auto &values : columns) {
+			const char *value_bytes = reinterpret_cast<const char *>(values.data());
+			payload.insert(payload.end(), value_bytes, value_bytes + values.size() * sizeof(double));
+		}
+	}
+
+	bulk::BlockHeader header{static_cast<uint32_t>(timestamps.size()),
+							 static_cast<uint32_t>(payload.size())};
+	out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+
+	stats.points += timestamps.size();
+	stats.blocks++;
+	stats.bytes += sizeof(header) + payload.size();
+	timestamps.clear();
+	for (auto &values : columns) {
+		values.clear();
+	}
+}
+
+void read_exact(std::istream &in, char *data, size_t size) {
+	if (!in.read(data, static_cast<std::streamsize>(size))) {
+		throw std::runtime_error("Truncated export file");
+	}
+}
+} // namespace
+
+bulk::TransferStats bulk::export_table(DataBase &db, const std::string &table_name,
+									   const TimeRange &range, std::ostream &out,
+									   const ExportOptions &options) {
+	TSDB_TRACE_SPAN("bulk.export");
+	if (!db.has_table(table_name)) {
+		throw std::runtime_error("Table not found: " + table_name);
+	}
+	const auto &config = db.get_table(table_name)->get_config();
+	TransferStats stats{};
+	const size_t block_points = std::max<size_t>(options.block_points, 1);
+
+	FileHeader header{};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.flags = options.compress ? FLAG_COMPRESSED : 0;
+	header.start_ts = range.start_ts;
+	header.end_ts = range.end_ts;
+	ColumnsHeader layout{static_cast<uint32_t>(config.value_columns),
+						 static_cast<uint8_t>(config.value_type), {0, 0, 0}};
+	out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char *>(&layout), sizeof(layout));
+	stats.bytes += sizeof(header) + sizeof(layout);
+
+	std::vector<Timestamp> timestamps{};
+	std::vector<std::vector<double>> columns(config.value_columns);
+	std::vector<char> payload{};
+	timestamps.reserve(block_points);
+	for (auto &values : columns) {
+		values.reserve(block_points);
+	}
+
+	db.scan(table_name, range, [&](const ChunkSnapshot &chunk) {
+		auto [first, last] = chunk.get_index_range(range);
+		for (size_t i{first}; i < last; i++) {
+			if (!chunk.has_row(i))
+				continue;
+			timestamps.push_back(chunk.timestamp_at(i));
+			for (size_t c{0}; c < columns.size(); c++) {
+				columns[c].push_back(chunk.value_at(i, c));
+			}
+			if (timestamps.size() == block_points) {
+				write_block(out, timestamps, columns, options.compress, payload, stats);
+			}
+		}
+	});
+	write_block(out, timestamps, columns, options.compress, payload, stats);
+
+	BlockHeader end{0, 0};
+	out.write(reinterpret_cast<const char *>(&end), sizeof(end));
+	stats.bytes += sizeof(end);
+	out.flush();
+	if (!out) {
+		throw std::runtime_error("Failed to write export");
+	}
+	return stats;
+}
+
+bulk::TransferStats bulk::import_table(DataBase &db, const std::string &table_name,
+									   std::istream &in) {
+	TSDB_TRACE_SPAN("bulk.import");
+	if (!db.has_table(table_name)) {
+		throw std::runtime_error("Table not found: " + table_name);
+	}
+	TransferStats stats{};
+
+	FileHeader header{};
+	read_exact(in, reinterpret_cast<char *>(&header), sizeof(header));
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+		throw std::runtime_error("Not a tsdb export file");
+	}
+	if (header.version == 0 || header.version > VERSION) {
+		throw std::runtime_error("Unsupported export version " + std::to_string(header.version));
+	}
+	const bool compressed = header.flags & FLAG_COMPRESSED;
+	stats.bytes += sizeof(header);
+
+	ColumnsHeader layout{1, static_cast<uint8_t>(ValueType::Float64), {0, 0, 0}};
+	if (header.version >= 2) {
+		read_exact(in, reinterpret_cast<char *>(&layout), sizeof(layout));
+		stats.bytes += sizeof(layout);
+	}
+	// Checked before any block, so a corrupt column count cannot size the buffers either
+	const auto &config = db.get_table(table_name)->get_config();
+	const auto value_type = static_cast<ValueType>(layout.value_type);
+	if (layout.columns != config.value_columns || value_type != config.value_type) {
+		throw std::runtime_error("Export holds " + std::to_string(layout.columns) + " " +
+								 value_type_name(value_type) + " columns, table " + table_name +
+								 " has " + std::to_string(config.value_columns) + " " +
+								 value_type_name(config.value_type));
+	}
+
+	std::vector<char> payload{};
+	std::vector<Timestamp> timestamps{};
+	std::vector<std::vector<double>> columns(layout.columns);
+	std::vector<DataPoint> points{};
+	while (true) {
+		BlockHeader block{};
+		read_exact(in, reinterpret_cast<char *>(&block), sizeof(block));
+		stats.bytes += sizeof(block);
+		if (block.points == 0)
+			break;
+
+		// An encoded timestamp takes 1 to 10 bytes and a value 1 to 9, raw ones exactly 8, so a
+		// corrupt count cannot make the buffers balloon
+		const uint64_t count = block.points;
+		const uint64_t width = layout.columns;
+		const uint64_t min_bytes = compressed ? count * (1 + width) : count * 8 * (1 + width);
+		const uint64_t max_bytes = compressed ? count * (10 + 9 * width) : count * 8 * (1 + width);
+		if (block.payload_bytes < min_bytes || block.payload_bytes > max_bytes) {
+			throw std::runtime_error("Corrupt export block");
+		}
+		payload.resize(block.payload_bytes);
+		read_exact(in, payload.data(), payload.size());
+		stats.bytes += payload.size();
+
+		timestamps.resize(block.points);
+		if (compressed) {
+			size_t used = codec::decode_timestamps(payload.data(), payload.size(), block.points,
+												   timestamps.data());
+			for (auto &values : columns) {
+				values.resize(block.points);
+				used += codec::decode_values(payload.data() + used, payload.size() - used,
+											 block.points, values.data());
+			}
+			if (used != payload.size()) {
+				throw std::runtime_error("Corrupt export block");
+			}
+		} else {
+			size_t offset = block.points * sizeof(Timestamp);
+			std::memcpy(timestamps.data(), payload.data(), offset);
+			for (auto &values : columns) {
+				values.resize(block.points);
+				std::memcpy(values.data(), payload.data() + offset, block.points * sizeof(double));
+				offset += block.points * sizeof(double);
+			}
+		}
+
+		if (columns.size() == 1) {
+			points.resize(block.points);
+			for (size_t i{0}; i < block.points; i++) {
+				points[i] = DataPoint{timestamps[i], columns[0][i]};
+			}
+			db.insert(table_name, points);
+		} else {
+			db.insert_rows(table_name, timestamps, columns);
+		}
+		stats.points += block.points;
+		stats.blocks++;
+	}
+	return stats;
+}
@@ -1,161 +1,796 @@
+#include "aio.h"
 #include "chunk.h"
 #include "chunkfile.h"
+#include "config.h"
+#include "filter.h"
+#include "trace.h"
 
+#include <algorithm>
+#include <bit>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <memory>
+#include <mutex>
+#include <sstream>
 #include <stdexcept>
+#include <streambuf>
+#include <utility>
 #include <vector>
 
-std::vector<DataPoint> Chunk::get_data_in_range(const TimeRange &range) const {
-	// Could Optimise
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ChunkSnapshot Chunk::snapshot() const {
+	std::shared_ptr<ChunkRows> rows{};
+	{
+		std::lock_guard<std::mutex> lock(m_rows_mutex);
+		rows = m_rows;
+	}
+	size_t size = rows->rows.load(std::memory_order_acquire);
+	// Bounds are widened before rows are published, so they cover every pinned row
+	return ChunkSnapshot(m_range, std::move(rows), size, m_min_value.load(), m_max_value.load());
+}
+
+std::pair<size_t, size_t> ChunkSnapshot::get_index_range(const TimeRange &range) const {
+	if (empty()) {
+		return {0, 0};
+	}
+	if (const TimeDelta resolution = m_rows->resolution) {
+		// Row i sits at i * resolution, so the bounds are a division away
+		if (range.end_ts < m_range.start_ts || range.start_ts > m_range.end_ts) {
+			return {0, 0};
+		}
+		const TimeDelta from = std::max(range.start_ts, m_range.start_ts) - m_range.start_ts;
+		const TimeDelta to = std::min(range.end_ts, m_range.end_ts) - m_range.start_ts;
+		size_t first = std::min(size(), static_cast<size_t>((from + resolution - 1) / resolution));
+		size_t last = std::min(size(), static_cast<size_t>(to / resolution) + 1);
+		return {first, std::max(first, last)};
+	}
+	const auto begin = deltas();
+	const auto end = begin + size();
+	auto first = std::lower_bound(begin, end, range.start_ts - m_range.start_ts);
+	auto last = std::upper_bound(first, end, range.end_ts - m_range.start_ts);
+	return {static_cast<size_t>(first - begin), static_cast<size_t>(last - begin)};
+}
+
+size_t ChunkSnapshot::count() const {
+	if (empty() || !m_rows->present) {
+		return m_size;
+	}
+	// A writer may set bits past m_size in the last word, so they are masked off
+	size_t rows{0};
+	for (size_t w{0}; w < (m_size + 63) / 64; w++) {
+		uint64_t word = m_rows->present[w].load(std::memory_order_relaxed);
+		if (const size_t tail = m_size - w * 64; tail < 64) {
+			word &= (uint64_t{1} << tail) - 1;
+		}
+		rows += static_cast<size_t>(std::popcount(word));
+	}
+	return rows;
+}
+
+std::optional<DataPoint> ChunkSnapshot::first_point() const {
+	for (size_t i{0}; i < m_size; i++) {
+		if (has_row(i)) {
+			return DataPoint{timestamp_at(i), value_at(i)};
+		}
+	}
+	return std::nullopt;
+}
+
+std::optional<DataPoint> ChunkSnapshot::last_point() const {
+	for (size_t i{m_size}; i > 0; i--) {
+		if (has_row(i - 1)) {
+			return DataPoint{timestamp_at(i - 1), value_at(i - 1)};
+		}
+	}
+	return std::nullopt;
+}
+
+namespace {
+// Records the snapshot's first and last points in the metadata, whose defaults mean none
+void set_endpoints(ChunkMetadata &metadata, const ChunkSnapshot &snapshot) {
+	if (const auto first = snapshot.first_point()) {
+		metadata.first_ts = first->ts;
+		metadata.first_value = first->value;
+	}
+	if (const auto last = snapshot.last_point()) {
+		metadata.last_ts = last->ts;
+		metadata.last_value = last->value;
+	}
+}
+} // namespace
+
+ChunkMetadata Chunk::metadata() const {
+	ChunkMetadata metadata{m_id,		  m_range,		m_row_count, m_capacity, m_min_value,
+						   m_max_value, m_value_type, m_columns,	 m_resolution};
+	set_endpoints(metadata, snapshot());
+	return metadata;
+}
+
+namespace {
+// Appends rows [first, last) that satisfy the predicate, instantiated per storage type and
+// per layout: `row_ts` gives a row's timestamp and `has_row` whether it holds a point.
+// Rows are written through a pointer into storage sized up front and trimmed afterwards, so
+// the loop carries no capacity check and does not rely on push_back being inlined.
+template <typename T, typename RowTs, typename HasRow>
+void gather_rows(RowTs row_ts, HasRow has_row, const T *row_values, size_t first, size_t last,
+				 const ValuePredicate &predicate, std::vector<DataPoint> &results) {
+	const size_t base = results.size();
+	if (predicate.is_none()) {
+		results.resize(base + last - first);
+		DataPoint *out = results.data() + base;
+		for (size_t i{first}; i < last; i++) {
+			if (has_row(i)) {
+				*out++ = DataPoint{row_ts(i), ValueTraits<T>::load(row_values[i])};
+			}
+		}
+		results.resize(static_cast<size_t>(out - results.data()));
+		return;
+	}
+
+	if constexpr (std::is_same_v<T, double>) {
+		// Doubles go through the vectorised filter kernels
+		std::vector<uint32_t> selected(last - first);
+		size_t count = filter::select(row_values, static_cast<uint32_t>(first),
+									  static_cast<uint32_t>(last), predicate, selected.data());
+		results.resize(base + count);
+		DataPoint *out = results.data() + base;
+		for (size_t j{0}; j < count; j++) {
+			const auto i = selected[j];
+			if (has_row(i)) {
+				*out++ = DataPoint{row_ts(i), row_values[i]};
+			}
+		}
+		results.resize(static_cast<size_t>(out - results.data()));
+	} else {
+		results.resize(base + last - first);
+		DataPoint *out = results.data() + base;
+		for (size_t i{first}; i < last; i++) {
+			double value = ValueTraits<T>::load(row_values[i]);
+			if (has_row(i) && predicate.matches(value)) {
+				*out++ = DataPoint{row_ts(i), value};
+			}
+		}
+		results.resize(static_cast<size_t>(out - results.data()));
+	}
+}
+} // namespace
+
+std::vector<DataPoint> ChunkSnapshot::get_data_in_range(const TimeRange &range,
+														const ValuePredicate &predicate) const {
+	auto [first, last] = get_index_range(range);
+	return get_rows(first, last, predicate);
+}
+
+std::vector<DataPoint> ChunkSnapshot::get_rows(size_t first, size_t last,
+											   const ValuePredicate &predicate) const {
+	TSDB_TRACE_SPAN("chunk.filter");
 	std::vector<DataPoint> results{};
-	results.reserve(m_capacity);
-	for (size_t i{0}; i < size(); i++) {
-		const auto ts = m_range.start_ts + m_ts_deltas[i];
-		if (range.contains(ts))
-			results.push_back(DataPoint{ts, m_values[i]});
+	if (first >= last) {
+		return results;
 	}
+
+	const Timestamp start_ts = m_range.start_ts;
+	visit_value_type(value_type(), [&]<typename T>(std::type_identity<T>) {
+		if (const TimeDelta resolution = m_rows->resolution) {
+			// Held in locals: the row loop's stores into `results` could otherwise alias them
+			const std::atomic<uint64_t> *present = m_rows->present.get();
+			gather_rows(
+				[=](size_t i) { return start_ts + static_cast<TimeDelta>(i) * resolution; },
+				[=](size_t i) {
+					return !present ||
+						   (present[i / 64].load(std::memory_order_relaxed) >> (i % 64)) & 1;
+				},
+				column<T>(), first, last, predicate, results);
+		} else {
+			const Timestamp *ts_deltas = deltas();
+			gather_rows([=](size_t i) { return start_ts + ts_deltas[i]; },
+						[](size_t) { return true; }, column<T>(), first, last, predicate, results);
+		}
+	});
 	return results;
 }
 
+void ChunkSnapshot::get_latest_in_range(const TimeRange &range, const ValuePredicate &predicate,
+										size_t limit, std::vector<DataPoint> &out) const {
+	auto [first, last] = get_index_range(range);
+	for (size_t i{last}; i > first && out.size() < limit; i--) {
+		if (has_row(i - 1) && predicate.matches(value_at(i - 1))) {
+			out.push_back(DataPoint{timestamp_at(i - 1), value_at(i - 1)});
+		}
+	}
+}
+
 void Chunk::append(const DataPoint &point) {
-	if (is_full()) {
-		m_is_to_save = true;
+	if (m_columns == 1) {
+		append_row(point.ts, &point.value);
 		return;
 	}
+	std::vector<double> row(m_columns, std::numeric_limits<double>::quiet_NaN());
+	row[0] = point.value;
+	append_row(point.ts, row.data());
+}
+
+void Chunk::append_row(Timestamp ts, const double *values) {
+	std::lock_guard<std::mutex> lock(m_append_mutex);
+	// Only writers replace the buffer, and they hold the append lock
+	auto rows = m_rows;
+	const size_t size = rows->rows.load(std::memory_order_relaxed);
+	TimeDelta timedelta = DataPoint{ts, 0.0}.encode_time_delta(m_range.start_ts);
+	// A regular series keeps the point in the slot at or before its timestamp
+	const size_t slot = m_resolution > 0 ? static_cast<size_t>(timedelta / m_resolution) : 0;
+	if (m_resolution > 0 && (timedelta < 0 || slot >= rows->capacity)) {
+		return;
+	}
+	bool in_order = m_resolution > 0 || size == 0 || timedelta >= rows->deltas[size - 1];
+	bool added{true};
+
+	visit_value_type(m_value_type, [&]<typename T>(std::type_identity<T>) {
+		const T first = ValueTraits<T>::store(values[0]);
+		// Bounds and sketch describe the value as stored, which is what queries will read.
+		// NaNs never satisfy a range predicate so they are left out of the bounds.
+		const double value = ValueTraits<T>::load(first);
+		if (!std::isnan(value)) {
+			m_min_value = std::min(m_min_value.load(), value);
+			m_max_value = std::max(m_max_value.load(), value);
+		}
+		{
+			std::lock_guard<std::mutex> sketch_lock(m_sketch_mutex);
+			m_sketch.add(value);
+		}
 
-	TimeDelta timedelta = point.encode_time_delta(m_range.start_ts);
-	m_ts_deltas.push_back(timedelta);
-	m_values.push_back(point.value);
-	m_row_count++;
+		if (m_resolution > 0) {
+			const uint64_t bit = uint64_t{1} << (slot % 64);
+			if (slot >= size) {
+				// Past every snapshot's size, like an in-order append; the rows skipped stay absent
+				for (size_t c{0}; c < m_columns; c++) {
+					rows->template column<T>(c)[slot] = ValueTraits<T>::store(values[c]);
+				}
+				rows->present[slot / 64].fetch_or(bit, std::memory_order_relaxed);
+				rows->rows.store(slot + 1, std::memory_order_release);
+				return;
+			}
+
+			// Filling a gap or replacing a sample that snapshots can already see
+			auto copy =
+				std::make_shared<ChunkRows>(rows->capacity, m_value_type, m_columns, m_resolution);
+			for (size_t w{0}; w < (size + 63) / 64; w++) {
+				copy->present[w].store(rows->present[w].load(std::memory_order_relaxed),
+									   std::memory_order_relaxed);
+			}
+			added = !(copy->present[slot / 64].fetch_or(bit, std::memory_order_relaxed) & bit);
+			for (size_t c{0}; c < m_columns; c++) {
+				T *copy_values = copy->template column<T>(c);
+				std::copy_n(rows->template column<T>(c), size, copy_values);
+				copy_values[slot] = ValueTraits<T>::store(values[c]);
+			}
+			copy->rows.store(size, std::memory_order_relaxed);
+			{
+				std::lock_guard<std::mutex> rows_lock(m_rows_mutex);
+				m_rows = copy;
+			}
+			if (!added) {
+				// The replaced value is still in the bounds and sketch, so rebuild them from the
+				// rows. Snapshots pinned before the swap may then see the replaced value outside
+				// the bounds, as if taken after it.
+				double min_value = std::numeric_limits<double>::infinity();
+				double max_value = -std::numeric_limits<double>::infinity();
+				QuantileSketch sketch{};
+				const T *stored = copy->template column<T>(0);
+				for (size_t i{0}; i < size; i++) {
+					const uint64_t word = copy->present[i / 64].load(std::memory_order_relaxed);
+					if (!((word >> (i % 64)) & 1)) {
+						continue;
+					}
+					const double row_value = ValueTraits<T>::load(stored[i]);
+					if (!std::isnan(row_value)) {
+						min_value = std::min(min_value, row_value);
+						max_value = std::max(max_value, row_value);
+					}
+					sketch.add(row_value);
+				}
+				m_min_value = min_value;
+				m_max_value = max_value;
+				std::lock_guard<std::mutex> sketch_lock(m_sketch_mutex);
+				m_sketch = std::move(sketch);
+			}
+			return;
+		}
+
+		if (in_order && size < rows->capacity) {
+			// The slot is past every snapshot's size, so no reader can see it until published
+			rows->deltas[size] = timedelta;
+			for (size_t c{0}; c < m_columns; c++) {
+				rows->template column<T>(c)[size] = ValueTraits<T>::store(values[c]);
+			}
+			rows->rows.store(size + 1, std::memory_order_release);
+			return;
+		}
+
+		// Concurrent writers can deliver points slightly out of order, and a burst above the
+		// expected rate fills the buffer. Copy the rows with the point in place, growing
+		// geometrically when full, so snapshots of the old buffer stay intact.
+		const size_t capacity = size < rows->capacity
+									? rows->capacity
+									: std::max(size + 1, rows->capacity * Config::CHUNK_GROWTH_FACTOR);
+		auto grown = std::make_shared<ChunkRows>(capacity, m_value_type, m_columns);
+		m_capacity = capacity;
+		size_t index = static_cast<size_t>(
+			std::upper_bound(rows->deltas.get(), rows->deltas.get() + size, timedelta) -
+			rows->deltas.get());
+		std::copy_n(rows->deltas.get(), index, grown->deltas.get());
+		grown->deltas[index] = timedelta;
+		std::copy(rows->deltas.get() + index, rows->deltas.get() + size,
+				  grown->deltas.get() + index + 1);
+		for (size_t c{0}; c < m_columns; c++) {
+			const T *old_values = rows->template column<T>(c);
+			T *new_values = grown->template column<T>(c);
+			std::copy_n(old_values, index, new_values);
+			new_values[index] = ValueTraits<T>::store(values[c]);
+			std::copy(old_values + index, old_values + size, new_values + index + 1);
+		}
+		grown->rows.store(size + 1, std::memory_order_relaxed);
+		std::lock_guard<std::mutex> rows_lock(m_rows_mutex);
+		m_rows = std::move(grown);
+	});
+	if (added) {
+		m_row_count++;
+	}
 }
 
-void ChunkFile::save(const Chunk &chunk) const {
-	std::ofstream outf(m_chunk_path, std::ios::binary);
-	if (!outf.is_open()) {
-		throw std::runtime_error("Failed to open chunk file for saving: " + m_chunk_path);
+namespace {
+// Closes the descriptor when it goes out of scope
+class FileDescriptor {
+  public:
+	FileDescriptor() = default;
+	explicit FileDescriptor(int fd) : m_fd(fd) {}
+	FileDescriptor(FileDescriptor &&other) noexcept : m_fd(std::exchange(other.m_fd, -1)) {}
+	FileDescriptor &operator=(FileDescriptor &&other) noexcept {
+		std::swap(m_fd, other.m_fd);
+		return *this;
 	}
+	~FileDescriptor() {
+		if (m_fd >= 0) {
+			::close(m_fd);
+		}
+	}
+	int get() const { return m_fd; }
 
-	try {
-		write_metadata(outf, chunk);
-		write_deltas(outf, chunk.m_ts_deltas);
-		write_values(outf, chunk.m_values);
-	} catch (const std::exception &e) {
-		outf.close();
-		throw std::runtime_error("Error writing chunk data: " + std::string(e.what()));
+  private:
+	int m_fd{-1};
+};
+
+// A buffer from the shared pool, returned to it when released
+class PooledBuffer {
+  public:
+	PooledBuffer() = default;
+	explicit PooledBuffer(size_t size) : m_buffer(aio::default_buffer_pool().acquire(size)) {}
+	PooledBuffer(PooledBuffer &&) = default;
+	PooledBuffer &operator=(PooledBuffer &&other) noexcept {
+		std::swap(m_buffer, other.m_buffer);
+		return *this;
+	}
+	~PooledBuffer() {
+		if (m_buffer.data) {
+			aio::default_buffer_pool().release(std::move(m_buffer));
+		}
+	}
+	char *data() { return m_buffer.data.get(); }
+	size_t size() const { return m_buffer.size; }
+
+  private:
+	aio::Buffer m_buffer;
+};
+
+// Lets the sketch reader parse a buffer without copying it into a string
+class MemoryStreamBuffer : public std::streambuf {
+  public:
+	MemoryStreamBuffer(char *data, size_t size) { setg(data, data, data + size); }
+};
+
+// Chunk file readers over a whole file already in memory, as loaded by a batch
+class MemorySource {
+  public:
+	MemorySource(const char *data, size_t size) : m_data(data), m_size(size) {}
+	bool read(void *out, size_t bytes) {
+		if (bytes > m_size - m_position)
+			return false;
+		std::memcpy(out, m_data + m_position, bytes);
+		m_position += bytes;
+		return true;
+	}
+	bool skip(size_t bytes) {
+		if (bytes > m_size - m_position)
+			return false;
+		m_position += bytes;
+		return true;
 	}
+	size_t position() const { return m_position; }
 
-	outf.close();
+  private:
+	const char *m_data;
+	size_t m_size;
+	size_t m_position{0};
+};
+
+// ...and over an open file, which seeks past skipped columns instead of reading them
+class StreamSource {
+  public:
+	explicit StreamSource(std::istream &file) : m_file(file) {}
+	bool read(void *out, size_t bytes) {
+		m_file.read(static_cast<char *>(out), static_cast<std::streamsize>(bytes));
+		return !m_file.fail();
+	}
+	bool skip(size_t bytes) {
+		m_file.seekg(static_cast<std::streamoff>(bytes), std::ios::cur);
+		return !m_file.fail();
+	}
+	size_t position() { return static_cast<size_t>(m_file.tellg()); }
+
+  private:
+	std::istream &m_file;
+};
+
+void append_bytes(std::vector<char> &out, const void *data, size_t bytes) {
+	const auto *begin = static_cast<const char *>(data);
+	out.insert(out.end(), begin, begin + bytes);
+}
+
+std::string io_error(ssize_t result, size_t expected) {
+	return result < 0 ? std::strerror(static_cast<int>(-result))
+					  : "transferred " + std::to_string(result) + " of " + std::to_string(expected) +
+							" bytes";
+}
+} // namespace
+
+void ChunkFile::save(const Chunk &chunk) const { save_batch({{this, &chunk}}); }
+
+void ChunkFile::save_batch(const std::vector<std::pair<const ChunkFile *, const Chunk *>> &files) {
+	TSDB_TRACE_SPAN("chunk.save");
+	struct PendingSave {
+		std::vector<char> chunk_bytes;
+		std::string sketch_bytes;
+		FileDescriptor chunk_fd;
+		FileDescriptor sketch_fd;
+	};
+	std::vector<PendingSave> pending(files.size());
+
+	// Encode every chunk first, then write all of the files in one batch
+	for (size_t i{0}; i < files.size(); i++) {
+		const auto &[file, chunk] = files[i];
+		auto &save = pending[i];
+		// Saves a snapshot, so writers keep appending while the file is written
+		const auto snapshot = chunk->snapshot();
+		ChunkMetadata metadata{chunk->m_id,		   chunk->m_range,		  snapshot.count(),
+							   chunk->m_capacity,   snapshot.min_value(), snapshot.max_value(),
+							   chunk->m_value_type, chunk->m_columns,	  chunk->m_resolution};
+		set_endpoints(metadata, snapshot);
+		try {
+			write_metadata(save.chunk_bytes, metadata);
+			if (metadata.resolution > 0) {
+				write_presence(save.chunk_bytes, snapshot);
+			} else {
+				write_deltas(save.chunk_bytes, snapshot.deltas(), snapshot.size());
+			}
+			write_values(save.chunk_bytes, snapshot);
+		} catch (const std::exception &e) {
+			throw std::runtime_error("Error writing chunk data: " + std::string(e.what()));
+		}
+
+		// The sketch lives in its own file so quantile queries can read it without the columns
+		std::ostringstream sketch_stream;
+		chunk->sketch().write(sketch_stream);
+		save.sketch_bytes = std::move(sketch_stream).str();
+
+		// Write beside the files and rename over them so concurrent loads never see a partial
+		// chunk
+		constexpr int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+		save.chunk_fd = FileDescriptor(::open((file->m_chunk_path + ".tmp").c_str(), flags, 0644));
+		if (save.chunk_fd.get() < 0) {
+			throw std::runtime_error("Failed to open chunk file for saving: " + file->m_chunk_path);
+		}
+		save.sketch_fd = FileDescriptor(::open((file->m_sketch_path + ".tmp").c_str(), flags, 0644));
+		if (save.sketch_fd.get() < 0) {
+			throw std::runtime_error("Failed to open sketch file for saving: " + file->m_sketch_path);
+		}
+	}
+
+	std::vector<aio::Request> requests{};
+	requests.reserve(pending.size() * 2);
+	for (auto &save : pending) {
+		requests.push_back({save.chunk_fd.get(), 0, save.chunk_bytes.data(), save.chunk_bytes.size(), true});
+		requests.push_back({save.sketch_fd.get(), 0, save.sketch_bytes.data(), save.sketch_bytes.size(), true});
+	}
+	aio::default_engine().submit(requests);
+
+	for (size_t i{0}; i < requests.size(); i++) {
+		const auto &request = requests[i];
+		if (request.result != static_cast<ssize_t>(request.length)) {
+			const ChunkFile *file = files[i / 2].first;
+			throw std::runtime_error("Error writing chunk data: " +
+									 (i % 2 ? file->m_sketch_path : file->m_chunk_path) + ": " +
+									 io_error(request.result, request.length));
+		}
+	}
+	for (size_t i{0}; i < files.size(); i++) {
+		const ChunkFile *file = files[i].first;
+		pending[i] = PendingSave{};
+		std::filesystem::rename(file->m_sketch_path + ".tmp", file->m_sketch_path);
+		std::filesystem::rename(file->m_chunk_path + ".tmp", file->m_chunk_path);
+	}
+}
+
+QuantileSketch ChunkFile::load_sketch() const {
+	std::ifstream inf(m_sketch_path, std::ios::binary);
+	if (!inf.is_open()) {
+		throw std::runtime_error("Failed to open sketch file for loading: " + m_sketch_path);
+	}
+	return QuantileSketch::read(inf);
+}
+
+std::unique_ptr<Chunk> ChunkFile::load(size_t *bytes_read) const {
+	return std::move(load_batch({this}, bytes_read).front());
 }
 
-std::unique_ptr<Chunk> ChunkFile::load() const {
+std::vector<std::unique_ptr<Chunk>> ChunkFile::load_batch(const std::vector<const ChunkFile *> &files,
+														  size_t *bytes_read) {
+	TSDB_TRACE_SPAN("chunk.load");
+	struct PendingLoad {
+		FileDescriptor chunk_fd;
+		FileDescriptor sketch_fd;
+		PooledBuffer chunk_bytes;
+		PooledBuffer sketch_bytes;
+	};
+	std::vector<PendingLoad> pending(files.size());
+	std::vector<aio::Request> requests{};
+	requests.reserve(files.size() * 2);
+
+	// Whole files are read in one batch, then decoded from memory
+	const auto open_file = [](const std::string &path, const char *what, PooledBuffer &buffer) {
+		FileDescriptor fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+		struct stat info;
+		if (fd.get() < 0 || ::fstat(fd.get(), &info) != 0) {
+			throw std::runtime_error("Failed to open " + std::string(what) +
+									 " file for loading: " + path);
+		}
+		buffer = PooledBuffer(static_cast<size_t>(info.st_size));
+		return fd;
+	};
+	for (size_t i{0}; i < files.size(); i++) {
+		auto &load = pending[i];
+		load.chunk_fd = open_file(files[i]->m_chunk_path, "chunk", load.chunk_bytes);
+		load.sketch_fd = open_file(files[i]->m_sketch_path, "sketch", load.sketch_bytes);
+		requests.push_back({load.chunk_fd.get(), 0, load.chunk_bytes.data(), load.chunk_bytes.size()});
+		requests.push_back({load.sketch_fd.get(), 0, load.sketch_bytes.data(), load.sketch_bytes.size()});
+	}
+	aio::default_engine().submit(requests);
+
+	std::vector<std::unique_ptr<Chunk>> chunks{};
+	chunks.reserve(files.size());
+	size_t total_bytes{0};
+	for (size_t i{0}; i < files.size(); i++) {
+		auto &load = pending[i];
+		ChunkMetadata metadata;
+		std::shared_ptr<ChunkRows> rows;
+		try {
+			TSDB_TRACE_SPAN("chunk.decode");
+			for (const auto &request : {requests[2 * i], requests[2 * i + 1]}) {
+				if (request.result != static_cast<ssize_t>(request.length)) {
+					throw std::runtime_error(io_error(request.result, request.length));
+				}
+			}
+			MemorySource source(load.chunk_bytes.data(), load.chunk_bytes.size());
+			metadata = read_metadata(source);
+			rows = read_rows(source, metadata);
+			total_bytes += source.position();
+		} catch (const std::exception &e) {
+			throw std::runtime_error("Error reading chunk data: " + std::string(e.what()));
+		}
+
+		MemoryStreamBuffer sketch_buffer(load.sketch_bytes.data(), load.sketch_bytes.size());
+		std::istream sketch_stream(&sketch_buffer);
+		chunks.push_back(std::make_unique<Chunk>(metadata, std::move(rows),
+												 QuantileSketch::read(sketch_stream)));
+		// Hand the buffers back while the rest of the batch decodes
+		load = PendingLoad{};
+	}
+	if (bytes_read) {
+		*bytes_read = total_bytes;
+	}
+	return chunks;
+}
+
+ChunkSnapshot ChunkFile::load_columns(const std::vector<size_t> &columns, size_t *bytes_read) const {
+	TSDB_TRACE_SPAN("chunk.load_columns");
 	std::ifstream inf(m_chunk_path, std::ios::binary);
 	if (!inf.is_open()) {
 		throw std::runtime_error("Failed to open chunk file for loading: " + m_chunk_path);
 	}
 
-	ChunkMetadata metadata;
-	std::vector<Timestamp> deltas;
-	std::vector<double> values;
-
 	try {
-		metadata = read_metadata(inf);
-		deltas = read_deltas(inf);
-		values = read_values(inf);
+		StreamSource source(inf);
+		ChunkMetadata metadata = read_metadata(source);
+		for (size_t column : columns) {
+			if (column >= metadata.columns) {
+				throw std::out_of_range("Column " + std::to_string(column) + " not in chunk");
+			}
+		}
+		size_t bytes_skipped{0};
+		auto rows = read_rows(source, metadata, &columns, &bytes_skipped);
+		if (bytes_read) {
+			// Columns outside the projection were seeked over rather than read
+			*bytes_read = source.position() - bytes_skipped;
+		}
+		const size_t size = rows->rows.load(std::memory_order_relaxed);
+		return ChunkSnapshot(metadata.chunk_range, std::move(rows), size, metadata.min_value,
+							 metadata.max_value);
+	} catch (const std::out_of_range &) {
+		throw;
 	} catch (const std::exception &e) {
-		inf.close();
 		throw std::runtime_error("Error reading chunk data: " + std::string(e.what()));
 	}
+}
 
-	// Create and return a Chunk object
-	std::unique_ptr<Chunk> chunk =
-		std::make_unique<Chunk>(metadata, std::move(deltas), std::move(values));
-	return chunk;
+void ChunkFile::write_metadata(std::vector<char> &out, const ChunkMetadata &metadata) {
+	append_bytes(out, &CHUNK_FILE_MAGIC, sizeof(CHUNK_FILE_MAGIC));
+	append_bytes(out, &CHUNK_FILE_VERSION, sizeof(CHUNK_FILE_VERSION));
+	append_bytes(out, &metadata, sizeof(metadata));
 }
 
-void ChunkFile::write_metadata(std::ofstream &file, const Chunk &chunk) {
-	ChunkMetadata metadata{chunk.id(), chunk.get_range(), chunk.size(), chunk.capacity()};
-	file.write(reinterpret_cast<const char *>(&metadata), sizeof(metadata));
-	if (file.fail()) {
-		throw std::runtime_error("Failed to write chunk metadata");
+template <typename Source> ChunkMetadata ChunkFile::read_metadata(Source &source) {
+	uint32_t magic{0};
+	uint32_t version{0};
+	if (!source.read(&magic, sizeof(magic)) || !source.read(&version, sizeof(version))) {
+		throw std::runtime_error("Failed to read chunk file header");
+	}
+	// Files of another layout would otherwise decode as garbage
+	if (magic != CHUNK_FILE_MAGIC) {
+		throw std::runtime_error("Not a chunk file");
+	}
+	if (version != CHUNK_FILE_VERSION) {
+		throw std::runtime_error("Unsupported chunk file version " + std::to_string(version));
 	}
-}
 
-ChunkMetadata ChunkFile::read_metadata(std::ifstream &file) {
 	ChunkMetadata metadata;
 
-	file.read(reinterpret_cast<char *>(&metadata), sizeof(metadata));
-
-	if (file.fail()) {
+	if (!source.read(&metadata, sizeof(metadata))) {
 		throw std::runtime_error("Failed to read chunk metadata");
 	}
 
 	return metadata;
 }
 
-void ChunkFile::write_deltas(std::ofstream &file, const std::vector<Timestamp> &deltas) {
-	// Write the number of deltas
-	size_t num_deltas = deltas.size();
-	file.write(reinterpret_cast<const char *>(&num_deltas), sizeof(num_deltas));
-	if (file.fail()) {
-		throw std::runtime_error("Failed to write number of deltas");
-	}
+void ChunkFile::write_deltas(std::vector<char> &out, const Timestamp *deltas, size_t num_deltas) {
+	// Write the number of deltas, then the actual deltas
+	append_bytes(out, &num_deltas, sizeof(num_deltas));
+	append_bytes(out, deltas, num_deltas * sizeof(Timestamp));
+}
 
-	// Then write the actual delta
-	file.write(reinterpret_cast<const char *>(deltas.data()), num_deltas * sizeof(Timestamp));
-	if (file.fail()) {
-		throw std::runtime_error("Failed to write deltas");
+void ChunkFile::write_presence(std::vector<char> &out, const ChunkSnapshot &snapshot) {
+	// The number of rows, then one bit per row in 64 bit words
+	size_t num_rows = snapshot.size();
+	std::vector<uint64_t> words((num_rows + 63) / 64, 0);
+	for (size_t i{0}; i < num_rows; i++) {
+		if (snapshot.has_row(i)) {
+			words[i / 64] |= uint64_t{1} << (i % 64);
+		}
 	}
+	append_bytes(out, &num_rows, sizeof(num_rows));
+	append_bytes(out, words.data(), words.size() * sizeof(uint64_t));
 }
 
-std::vector<Timestamp> ChunkFile::read_deltas(std::ifstream &file) {
-	// Read the number of deltas first
-	size_t num_deltas;
-	file.read(reinterpret_cast<char *>(&num_deltas), sizeof(num_deltas));
-	if (file.fail()) {
-		throw std::runtime_error("Failed to read number of deltas");
-	}
+void ChunkFile::write_values(std::vector<char> &out, const ChunkSnapshot &snapshot) {
+	// Write the number of values
+	size_t num_values = snapshot.size();
+	append_bytes(out, &num_values, sizeof(num_values));
 
-	// Then read the delta values into a vector
-	std::vector<Timestamp> deltas(num_deltas);
-	file.read(reinterpret_cast<char *>(deltas.data()), num_deltas * sizeof(Timestamp));
-	if (file.fail()) {
-		throw std::runtime_error("Failed to read deltas");
+	// Then each column in its type's codec, prefixed with its encoded size so projections can
+	// seek past the columns they do not need
+	std::vector<char> encoded{};
+	for (size_t c{0}; c < snapshot.columns(); c++) {
+		encoded.clear();
+		visit_value_type(snapshot.value_type(), [&]<typename T>(std::type_identity<T>) {
+			ValueCodec<T>::encode(snapshot.column<T>(c), num_values, encoded);
+		});
+		size_t encoded_bytes = encoded.size();
+		append_bytes(out, &encoded_bytes, sizeof(encoded_bytes));
+		out.insert(out.end(), encoded.begin(), encoded.end());
 	}
-
-	return deltas;
 }
 
-void ChunkFile::write_values(std::ofstream &file, const std::vector<double> &values) {
-	// Write the number of deltas
-	size_t num_values = values.size();
-	file.write(reinterpret_cast<const char *>(&num_values), sizeof(num_values));
-	if (file.fail()) {
-		throw std::runtime_error("Failed to write number of values");
+template <typename Source>
+std::shared_ptr<ChunkRows> ChunkFile::read_rows(Source &source, const ChunkMetadata &metadata,
+												const std::vector<size_t> *projection,
+												size_t *bytes_skipped) {
+	// Read the number of deltas (or rows of a regular series) first
+	size_t num_deltas;
+	if (!source.read(&num_deltas, sizeof(num_deltas))) {
+		throw std::runtime_error("Failed to read number of deltas");
 	}
 
-	// Then write the actual delta
-	file.write(reinterpret_cast<const char *>(values.data()), num_values * sizeof(double));
-	if (file.fail()) {
-		throw std::runtime_error("Failed to write values");
+	// Then read the deltas and values straight into the row buffer. A regular series keeps a
+	// row for every slot so later samples land in place.
+	const size_t columns = projection ? projection->size() : metadata.columns;
+	std::shared_ptr<ChunkRows> rows{};
+	bool ok{false};
+	if (metadata.resolution > 0) {
+		if (num_deltas > metadata.capacity) {
+			throw std::runtime_error("Row count exceeds chunk capacity");
+		}
+		rows = std::make_shared<ChunkRows>(metadata.capacity, metadata.value_type, columns,
+										   metadata.resolution);
+		std::vector<uint64_t> words((num_deltas + 63) / 64);
+		ok = source.read(words.data(), words.size() * sizeof(uint64_t));
+		for (size_t w{0}; w < words.size(); w++) {
+			rows->present[w].store(words[w], std::memory_order_relaxed);
+		}
+	} else {
+		rows = std::make_shared<ChunkRows>(std::max<size_t>(num_deltas, 1), metadata.value_type,
+										   columns);
+		ok = source.read(rows->deltas.get(), num_deltas * sizeof(Timestamp));
+	}
+	if (!ok) {
+		throw std::runtime_error("Failed to read deltas");
 	}
-}
 
-std::vector<double> ChunkFile::read_values(std::ifstream &file) {
-	// Read the number of deltas first
 	size_t num_values;
-	file.read(reinterpret_cast<char *>(&num_values), sizeof(num_values));
-	if (file.fail()) {
-		throw std::runtime_error("Failed to read number of deltas");
+	if (!source.read(&num_values, sizeof(num_values)) || num_values != num_deltas) {
+		throw std::runtime_error("Failed to read number of values");
 	}
 
-	// Then read the delta values into a vector
-	std::vector<double> values(num_values);
-	file.read(reinterpret_cast<char *>(values.data()), num_values * sizeof(double));
-	if (file.fail()) {
-		throw std::runtime_error("Failed to read values");
+	// Stored column `c` goes to every slot of the projection that asks for it
+	std::vector<size_t> targets{};
+	std::vector<char> encoded{};
+	for (size_t c{0}; c < metadata.columns; c++) {
+		size_t encoded_bytes;
+		if (!source.read(&encoded_bytes, sizeof(encoded_bytes))) {
+			throw std::runtime_error("Failed to read values");
+		}
+		targets.clear();
+		for (size_t slot{0}; slot < columns; slot++) {
+			if ((projection ? (*projection)[slot] : slot) == c)
+				targets.push_back(slot);
+		}
+		if (targets.empty()) {
+			if (!source.skip(encoded_bytes)) {
+				throw std::runtime_error("Failed to read values");
+			}
+			if (bytes_skipped) {
+				*bytes_skipped += encoded_bytes;
+			}
+			continue;
+		}
+
+		visit_value_type(metadata.value_type, [&]<typename T>(std::type_identity<T>) {
+			T *column = rows->template column<T>(targets[0]);
+			if constexpr (ValueCodec<T>::raw) {
+				// Raw columns are read straight into the row buffer
+				if (encoded_bytes != num_values * sizeof(T)) {
+					throw std::runtime_error("Value column size mismatch");
+				}
+				ok = source.read(column, encoded_bytes);
+			} else {
+				encoded.resize(encoded_bytes);
+				ok = source.read(encoded.data(), encoded.size());
+				if (ok) {
+					ValueCodec<T>::decode(encoded.data(), encoded.size(), num_values, column);
+				}
+			}
+			for (size_t t{1}; ok && t < targets.size(); t++) {
+				std::copy_n(column, num_values, rows->template column<T>(targets[t]));
+			}
+		});
+		if (!ok) {
+			throw std::runtime_error("Failed to read values");
+		}
 	}
 
-	return values;
-}
\ No newline at end of file
+	rows->rows.store(num_deltas, std::memory_order_relaxed);
+	return rows;
+}
@@ -1,8 +1,12 @@
+#include "bulk.h"
 #include "cli.h"
+#include "trace.h"
 
 #include <exception>
+#include <fstream>
 #include <iostream>
 #include <string>
+#include <vector>
 
 void HelpCommand::execute(CLIState &context, const std::vector<std::string> &args) {
 	if (args.size() > 1) {
@@ -40,11 +44,13 @@ void CreateTableCommand::execute(CLIState &state, const std::vector<std::string>
 	}
 
 	std::string table_name = args[1];
+	ValueType value_type = args.size() > 2 ? parse_value_type(args[2]) : ValueType::Float64;
+	bool regular = args.size() > 3 && args[3] == "regular";
 
 	// TODO: Add option to pass in config through command line
 	Table::Config config(Config::CHUNK_INTERVAL_SECS, Config::CHUNK_CACHE_SIZE,
 						 Config::MAX_CHUNKS_TO_SAVE, Config::FLUSH_INTERVAL_SECS,
-						 Config::MIN_DATA_RESOLUTION_SECS);
+						 Config::MIN_DATA_RESOLUTION_SECS, value_type, 1, regular);
 
 	state.get_database().create_table(table_name, config);
 	std::cout << "Table '" << table_name << "' created successfully\n";
@@ -121,6 +127,57 @@ void InsertFromCSVCommand::execute(CLIState &state, const std::vector<std::strin
 	}
 }
 
+void ExportCommand::execute(CLIState &state, const std::vector<std::string> &args) {
+	if (args.size() < 5) {
+		std::cout << "Error: Required format: " << get_usage() << "\n";
+		return;
+	}
+
+	std::string table_name = args[1];
+	time_t start_ts = parse_timestamp(args[2]);
+	time_t end_ts = parse_timestamp(args[3]);
+	bulk::ExportOptions options{};
+	options.compress = args.size() > 5 && args[5] == "compress";
+
+	std::vector<char> buffer(Config::BULK_IO_BUFFER_BYTES);
+	std::ofstream out;
+	out.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+	out.open(args[4], std::ios::binary | std::ios::trunc);
+	if (!out.is_open()) {
+		throw std::runtime_error("Failed to open export file: " + args[4]);
+	}
+
+	auto &watch = state.get_stopwatch();
+	watch.start();
+	auto stats = bulk::export_table(state.get_database(), table_name, TimeRange{start_ts, end_ts},
+									out, options);
+	auto export_time = watch.elapsed<stopwatch::mus>();
+	std::cout << "Exported " << stats.points << " points (" << stats.bytes << " bytes) in "
+			  << static_cast<double>(export_time) / 1000 << " ms\n";
+}
+
+void ImportCommand::execute(CLIState &state, const std::vector<std::string> &args) {
+	if (args.size() < 3) {
+		std::cout << "Error: Required format: " << get_usage() << "\n";
+		return;
+	}
+
+	std::vector<char> buffer(Config::BULK_IO_BUFFER_BYTES);
+	std::ifstream in;
+	in.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+	in.open(args[2], std::ios::binary);
+	if (!in.is_open()) {
+		throw std::runtime_error("Failed to open import file: " + args[2]);
+	}
+
+	auto &watch = state.get_stopwatch();
+	watch.start();
+	auto stats = bulk::import_table(state.get_database(), args[1], in);
+	auto import_time = watch.elapsed<stopwatch::mus>();
+	std::cout << "Imported " << stats.points << " points (" << stats.bytes << " bytes) in "
+			  << static_cast<double>(import_time) / 1000 << " ms\n";
+}
+
 void QueryCommand::execute(CLIState &state, const std::vector<std::string> &args) {
 	if (args.size() < 4) {
 		std::cout << "Error: Required format: " << get_usage() << "\n";
@@ -166,6 +223,139 @@ void QueryCommand::execute(CLIState &state, const std::vector<std::string> &args
 	}
 }
 
+void LatestCommand::execute(CLIState &state, const std::vector<std::string> &args) {
+	if (args.size() < 2) {
+		std::cout << "Error: Required format: " << get_usage() << "\n";
+		return;
+	}
+
+	std::string table_name = args[1];
+	size_t count = args.size() > 2 ? std::stoull(args[2]) : 1;
+
+	try {
+		auto &watch = state.get_stopwatch();
+		watch.start();
+		auto results = state.get_database().query(table_name, Query::latest(count));
+		auto query_time = watch.elapsed<stopwatch::mus>();
+
+		std::cout << "Query executed in " << static_cast<double>(query_time) / 1000 << " ms\n";
+		std::cout << "Timestamp | Value\n";
+		std::cout << "---------------------\n";
+		for (const auto &point : results) {
+			std::cout << point.ts << " | " << point.value << "\n";
+		}
+	} catch (const std::exception &e) {
+		std::stringstream error_message;
+		error_message << "Failed to query data: " << e.what();
+		throw std::runtime_error(error_message.str());
+	}
+}
+
+void QuantileCommand::execute(CLIState &state, const std::vector<std::string> &args) {
+	if (args.size() < 5) {
+		std::cout << "Error: Required format: " << get_usage() << "\n";
+		return;
+	}
+
+	std::string table_name = args[1];
+	time_t start_ts = parse_timestamp(args[2]);
+	time_t end_ts = parse_timestamp(args[3]);
+	std::vector<double> qs{};
+	for (size_t i = 4; i < args.size(); ++i) {
+		qs.push_back(std::stod(args[i]));
+	}
+
+	try {
+		auto &watch = state.get_stopwatch();
+		watch.start();
+		auto results = state.get_database().quantiles(table_name, TimeRange{start_ts, end_ts}, qs);
+		auto query_time = watch.elapsed<stopwatch::mus>();
+
+		std::cout << "Query executed in " << static_cast<double>(query_time) / 1000 << " ms\n";
+		for (size_t i = 0; i < results.size(); ++i) {
+			std::cout << "q" << qs[i] << " = " << results[i] << "\n";
+		}
+	} catch (const std::exception &e) {
+		std::stringstream error_message;
+		error_message << "Failed to query quantiles: " << e.what();
+		throw std::runtime_error(error_message.str());
+	}
+}
+
+void ExplainCommand::execute(CLIState &state, const std::vector<std::string> &args) {
+	if (args.size() < 4) {
+		std::cout << "Error: Required format: " << get_usage() << "\n";
+		return;
+	}
+
+	std::string table_name = args[1];
+	time_t start_ts = parse_timestamp(args[2]);
+	time_t end_ts = parse_timestamp(args[3]);
+
+	try {
+		QueryStats stats{};
+		Query q = {TimeRange{start_ts, end_ts}};
+		state.get_database().query(table_name, q, &stats);
+
+		auto ms = [](uint64_t ns) { return static_cast<double>(ns) / 1000000; };
+		std::cout << "Chunks matched:  " << stats.chunks_matched << " (" << stats.chunks_skipped
+				  << " skipped)\n";
+		std::cout << "Cache:           " << stats.cache_hits << " hits, " << stats.cache_misses
+				  << " misses\n";
+		std::cout << "Bytes read:      " << stats.bytes_read << "\n";
+		std::cout << "Result cache:    " << stats.partials_reused << " chunks reused\n";
+		std::cout << "Rows:            " << stats.rows_scanned << " scanned, "
+				  << stats.rows_returned << " returned\n";
+		std::cout << "Index lookup:    " << ms(stats.lookup_ns) << " ms\n";
+		std::cout << "Chunk loads:     " << ms(stats.load_ns) << " ms\n";
+		std::cout << "Filter/gather:   " << ms(stats.filter_ns) << " ms\n";
+		std::cout << "Sort:            " << ms(stats.sort_ns) << " ms\n";
+		std::cout << "Total:           " << ms(stats.total_ns) << " ms\n";
+	} catch (const std::exception &e) {
+		std::stringstream error_message;
+		error_message << "Failed to query data: " << e.what();
+		throw std::runtime_error(error_message.str());
+	}
+}
+
+void MetricsCommand::execute(CLIState &state, const std::vector<std::string> &args) {
+	if (args.size() < 2) {
+		std::cout << "Error: Required format: " << get_usage() << "\n";
+		return;
+	}
+
+	const auto &metrics = state.get_database().get_table(args[1])->get_metrics();
+	auto print_latency = [](const std::string &name, const LatencyHistogram &histogram) {
+		auto ms = [](double ns) { return ns / 1000000; };
+		std::cout << name << histogram.count() << " calls, mean " << ms(histogram.mean_ns())
+				  << " ms, p50 < " << ms(histogram.percentile_ns(0.5)) << " ms, p99 < "
+				  << ms(histogram.percentile_ns(0.99)) << " ms\n";
+	};
+
+	std::cout << "Cache:   " << metrics.m_cache_hits << " hits, " << metrics.m_cache_misses
+			  << " misses\n";
+	print_latency("Queries: ", metrics.m_query_latency);
+	print_latency("Inserts: ", metrics.m_insert_latency);
+}
+
+void TraceDumpCommand::execute([[maybe_unused]] CLIState &state, const std::vector<std::string> &args) {
+	if (args.size() < 2) {
+		std::cout << "Error: Required format: " << get_usage() << "\n";
+		return;
+	}
+	if (!trace::enabled()) {
+		std::cout << "Tracing is not compiled in (configure with -DENABLE_TRACING=ON)\n";
+		return;
+	}
+
+	std::ofstream out(args[1]);
+	if (!out.is_open()) {
+		throw std::runtime_error("Failed to open trace file: " + args[1]);
+	}
+	trace::dump_chrome_json(out);
+	std::cout << "Trace written to " << args[1] << "\n";
+}
+
 CLI::CLI(DataBase &database) : db(database), state(db, watch) {
 	// Register help command after others are registered
 	auto helpCmd = std::make_shared<HelpCommand>(commands);
@@ -178,7 +368,14 @@ CLI::CLI(DataBase &database) : db(database), state(db, watch) {
 	register_cmd(std::make_shared<ListTablesCommand>());
 	register_cmd(std::make_shared<InsertCommand>());
 	register_cmd(std::make_shared<InsertFromCSVCommand>());
+	register_cmd(std::make_shared<ExportCommand>());
+	register_cmd(std::make_shared<ImportCommand>());
 	register_cmd(std::make_shared<QueryCommand>());
+	register_cmd(std::make_shared<LatestCommand>());
+	register_cmd(std::make_shared<QuantileCommand>());
+	register_cmd(std::make_shared<ExplainCommand>());
+	register_cmd(std::make_shared<MetricsCommand>());
+	register_cmd(std::make_shared<TraceDumpCommand>());
 }
 
 void CLI::run() {
@@ -0,0 +1,252 @@
+#include "client.h"
+#include "protocol.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+Client Client::tcp(const std::string &host, uint16_t port) {
+	addrinfo hints{};
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo *addresses = nullptr;
+	if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0) {
+		throw std::runtime_error("Failed to resolve " + host);
+	}
+
+	int fd = -1;
+	for (auto *address = addresses; address; address = address->ai_next) {
+		fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+		if (fd >= 0 && connect(fd, address->ai_addr, address->ai_addrlen) == 0)
+			break;
+		if (fd >= 0)
+			close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(addresses);
+	if (fd < 0) {
+		throw std::runtime_error("Failed to connect to " + host + ":" + std::to_string(port));
+	}
+
+	int no_delay = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+	return Client(fd);
+}
+
+Client Client::unix_socket(const std::string &path) {
+	sockaddr_un addr{};
+	if (path.size() >= sizeof(addr.sun_path)) {
+		throw std::runtime_error("Unix socket path too long: " + path);
+	}
+	addr.sun_family = AF_UNIX;
+	std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+		if (fd >= 0)
+			close(fd);
+		throw std::runtime_error("Failed to connect to " + path);
+	}
+	return Client(fd);
+}
+
+Client::~Client() {
+	if (m_fd >= 0)
+		close(m_fd);
+}
+
+Client::Client(Client &&other) noexcept
+	: m_fd(std::exchange(other.m_fd, -1)), m_next_request_id(other.m_next_request_id),
+	  m_out(std::move(other.m_out)) {}
+
+Client &Client::operator=(Client &&other) noexcept {
+	if (this != &other) {
+		if (m_fd >= 0)
+			close(m_fd);
+		m_fd = std::exchange(other.m_fd, -1);
+		m_next_request_id = other.m_next_request_id;
+		m_out = std::move(other.m_out);
+	}
+	return *this;
+}
+
+void Client::create_table(const std::string &name, const Table::Config &config) {
+	size_t frame_offset = begin_request(protocol::Opcode::CreateTable);
+	protocol::Writer writer(m_out);
+	writer.put_string(name);
+	writer.put_config(config);
+	protocol::end_frame(m_out, frame_offset);
+	round_trip();
+}
+
+std::vector<std::string> Client::table_names() {
+	size_t frame_offset = begin_request(protocol::Opcode::ListTables);
+	protocol::end_frame(m_out, frame_offset);
+	auto payload = round_trip();
+
+	protocol::Reader reader(payload.data(), payload.size());
+	std::vector<std::string> names(reader.get_count(sizeof(uint32_t)));
+	for (auto &name : names) {
+		name = reader.get_string();
+	}
+	return names;
+}
+
+void Client::insert(const std::string &table_name, const std::vector<DataPoint> &points) {
+	size_t frame_offset = begin_request(protocol::Opcode::Insert);
+	protocol::Writer writer(m_out);
+	writer.put_string(table_name);
+	writer.put_points(points);
+	protocol::end_frame(m_out, frame_offset);
+	round_trip();
+}
+
+std::vector<DataPoint> Client::query(const std::string &table_name, const Query &query) {
+	size_t frame_offset = begin_request(protocol::Opcode::Query);
+	protocol::Writer writer(m_out);
+	writer.put_string(table_name);
+	writer.put_query(query);
+	protocol::end_frame(m_out, frame_offset);
+	auto payload = round_trip();
+	return protocol::Reader(payload.data(), payload.size()).get_points();
+}
+
+std::vector<double> Client::quantiles(const std::string &table_name, const TimeRange &range,
+									  const std::vector<double> &qs) {
+	size_t frame_offset = begin_request(protocol::Opcode::Quantiles);
+	protocol::Writer writer(m_out);
+	writer.put_string(table_name);
+	writer.put_range(range);
+	writer.put(static_cast<uint32_t>(qs.size()));
+	for (double q : qs) {
+		writer.put(q);
+	}
+	protocol::end_frame(m_out, frame_offset);
+	auto payload = round_trip();
+
+	protocol::Reader reader(payload.data(), payload.size());
+	std::vector<double> results(reader.get_count(sizeof(double)));
+	for (auto &value : results) {
+		value = reader.get<double>();
+	}
+	return results;
+}
+
+std::vector<std::vector<DataPoint>> Client::query_pipelined(const std::vector<TableQuery> &queries) {
+	// Request ids map responses back to positions, independent of arrival order
+	std::unordered_map<uint32_t, size_t> positions{};
+	for (size_t i{0}; i < queries.size(); i++) {
+		positions.emplace(m_next_request_id, i);
+		size_t frame_offset = begin_request(protocol::Opcode::Query);
+		protocol::Writer writer(m_out);
+		writer.put_string(queries[i].table_name);
+		writer.put_query(queries[i].query);
+		protocol::end_frame(m_out, frame_offset);
+	}
+	send_all();
+
+	// Every response is read even after an error so the connection stays in sync
+	std::vector<std::vector<DataPoint>> results(queries.size());
+	std::vector<char> payload{};
+	std::string error{};
+	for (size_t received{0}; received < queries.size(); received++) {
+		auto header = receive(payload);
+		auto position = positions.find(header.request_id);
+		if (position == positions.end()) {
+			throw std::runtime_error("Unexpected response id " + std::to_string(header.request_id));
+		}
+		protocol::Reader reader(payload.data(), payload.size());
+		if (header.code != static_cast<uint8_t>(protocol::Status::Ok)) {
+			error = error.empty() ? reader.get_string() : error;
+			continue;
+		}
+		results[position->second] = reader.get_points();
+	}
+	if (!error.empty()) {
+		throw std::runtime_error(error);
+	}
+	return results;
+}
+
+size_t Client::begin_request(protocol::Opcode opcode) {
+	return protocol::begin_frame(m_out, m_next_request_id++, static_cast<uint8_t>(opcode));
+}
+
+void Client::send_all() {
+	size_t offset{0};
+	while (offset < m_out.size()) {
+		ssize_t sent = send(m_fd, m_out.data() + offset, m_out.size() - offset, MSG_NOSIGNAL);
+		if (sent < 0) {
+			if (errno == EINTR)
+				continue;
+			m_out.clear();
+			throw std::runtime_error(std::string("Send failed: ") + std::strerror(errno));
+		}
+		offset += static_cast<size_t>(sent);
+	}
+	m_out.clear();
+}
+
+void Client::read_exact(char *data, size_t size) {
+	while (size > 0) {
+		ssize_t received = recv(m_fd, data, size, 0);
+		if (received == 0) {
+			throw std::runtime_error("Connection closed by server");
+		}
+		if (received < 0) {
+			if (errno == EINTR)
+				continue;
+			throw std::runtime_error(std::string("Receive failed: ") + std::strerror(errno));
+		}
+		data += received;
+		size -= static_cast<size_t>(received);
+	}
+}
+
+void Client::skip(size_t size) {
+	std::vector<char> discarded(std::min<size_t>(size, 64 * 1024));
+	while (size > 0) {
+		size_t block = std::min(size, discarded.size());
+		read_exact(discarded.data(), block);
+		size -= block;
+	}
+}
+
+protocol::FrameHeader Client::receive(std::vector<char> &payload) {
+	protocol::FrameHeader header;
+	read_exact(reinterpret_cast<char *>(&header), sizeof(header));
+	if (header.length > protocol::MAX_PAYLOAD_BYTES) {
+		// Skip the frame so later responses stay in sync, and report it as a failed request
+		skip(header.length);
+		payload.clear();
+		protocol::Writer(payload).put_string("Response frame too large");
+		header.length = static_cast<uint32_t>(payload.size());
+		header.code = static_cast<uint8_t>(protocol::Status::Error);
+		return header;
+	}
+	payload.resize(header.length);
+	read_exact(payload.data(), payload.size());
+	return header;
+}
+
+std::vector<char> Client::round_trip() {
+	send_all();
+	std::vector<char> payload{};
+	auto header = receive(payload);
+	if (header.code != static_cast<uint8_t>(protocol::Status::Ok)) {
+		throw std::runtime_error(protocol::Reader(payload.data(), payload.size()).get_string());
+	}
+	return payload;
+}
@@ -0,0 +1,190 @@
+#include "codec.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+uint64_t zigzag(int64_t value) {
+	return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+	return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+void put_varint(uint64_t value, std::vector<char> &out) {
+	while (value >= 0x80) {
+		out.push_back(static_cast<char>(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back(static_cast<char>(value));
+}
+
+uint64_t get_varint(const char *data, size_t size, size_t &offset) {
+	uint64_t value{0};
+	for (unsigned shift{0}; shift < 64; shift += 7) {
+		if (offset >= size) {
+			throw std::runtime_error("Truncated varint column");
+		}
+		auto byte = static_cast<uint8_t>(data[offset++]);
+		value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return value;
+	}
+	throw std::runtime_error("Malformed varint column");
+}
+} // namespace
+
+void codec::encode_timestamps(const Timestamp *timestamps, size_t count, std::vector<char> &out) {
+	// Wrapping arithmetic keeps extreme timestamps lossless
+	uint64_t previous{0};
+	uint64_t previous_delta{0};
+	for (size_t i{0}; i < count; i++) {
+		auto ts = static_cast<uint64_t>(timestamps[i]);
+		uint64_t delta = ts - previous;
+		put_varint(zigzag(static_cast<int64_t>(delta - previous_delta)), out);
+		previous = ts;
+		previous_delta = delta;
+	}
+}
+
+void codec::encode_values(const double *values, size_t count, std::vector<char> &out) {
+	// Each XOR is a tag byte (trailing zero bytes in bits 0-2, significant bytes in bits 3-6;
+	// 0 for a repeat) followed by its significant bytes, low byte first
+	uint64_t previous{0};
+	for (size_t i{0}; i < count; i++) {
+		auto bits = std::bit_cast<uint64_t>(values[i]);
+		uint64_t x = bits ^ previous;
+		previous = bits;
+		if (x == 0) {
+			out.push_back(0);
+			continue;
+		}
+		int trailing_bytes = std::countr_zero(x) / 8;
+		int significant_bytes = 8 - std::countl_zero(x) / 8 - trailing_bytes;
+		out.push_back(static_cast<char>(trailing_bytes | (significant_bytes << 3)));
+		x >>= trailing_bytes * 8;
+		for (int b{0}; b < significant_bytes; b++) {
+			out.push_back(static_cast<char>(x >> (b * 8)));
+		}
+	}
+}
+
+size_t codec::decode_timestamps(const char *data, size_t size, size_t count, Timestamp *out) {
+	size_t offset{0};
+	uint64_t previous{0};
+	uint64_t previous_delta{0};
+	for (size_t i{0}; i < count; i++) {
+		uint64_t delta = previous_delta + static_cast<uint64_t>(unzigzag(get_varint(data, size, offset)));
+		previous += delta;
+		previous_delta = delta;
+		out[i] = static_cast<Timestamp>(previous);
+	}
+	return offset;
+}
+
+size_t codec::decode_values(const char *data, size_t size, size_t count, double *out) {
+	size_t offset{0};
+	uint64_t previous{0};
+	for (size_t i{0}; i < count; i++) {
+		if (offset >= size) {
+			throw std::runtime_error("Truncated value column");
+		}
+		auto tag = static_cast<uint8_t>(data[offset++]);
+		int trailing_bytes = tag & 0x7;
+		int significant_bytes = tag >> 3;
+		if (trailing_bytes + significant_bytes > 8 || size - offset < static_cast<size_t>(significant_bytes)) {
+			throw std::runtime_error("Malformed value column");
+		}
+		uint64_t x{0};
+		for (int b{0}; b < significant_bytes; b++) {
+			x |= static_cast<uint64_t>(static_cast<uint8_t>(data[offset++])) << (b * 8);
+		}
+		previous ^= x << (trailing_bytes * 8);
+		out[i] = std::bit_cast<double>(previous);
+	}
+	return offset;
+}
+
+void codec::encode_integers(const int64_t *values, size_t count, std::vector<char> &out) {
+	if (count == 0)
+		return;
+	// The first value as a varint, so a large base does not widen every delta
+	put_varint(zigzag(values[0]), out);
+	std::vector<uint64_t> deltas(count - 1);
+	uint64_t widest{0};
+	for (size_t i{1}; i < count; i++) {
+		uint64_t delta = static_cast<uint64_t>(values[i]) - static_cast<uint64_t>(values[i - 1]);
+		deltas[i - 1] = zigzag(static_cast<int64_t>(delta));
+		widest |= deltas[i - 1];
+	}
+
+	// One width byte, then every delta in `width` bits, least significant bit first
+	const int width = 64 - std::countl_zero(widest);
+	out.push_back(static_cast<char>(width));
+	const size_t start = out.size();
+	out.resize(start + (deltas.size() * static_cast<size_t>(width) + 7) / 8, 0);
+	auto *packed = reinterpret_cast<uint8_t *>(out.data() + start);
+	size_t bit{0};
+	for (uint64_t delta : deltas) {
+		for (int written{0}; written < width;) {
+			int take = std::min(width - written, 8 - static_cast<int>(bit % 8));
+			packed[bit / 8] |= static_cast<uint8_t>(((delta >> written) & ((1u << take) - 1)) << (bit % 8));
+			written += take;
+			bit += static_cast<size_t>(take);
+		}
+	}
+}
+
+size_t codec::decode_integers(const char *data, size_t size, size_t count, int64_t *out) {
+	if (count == 0)
+		return 0;
+	size_t offset{0};
+	uint64_t previous = static_cast<uint64_t>(unzigzag(get_varint(data, size, offset)));
+	out[0] = static_cast<int64_t>(previous);
+	if (offset >= size) {
+		throw std::runtime_error("Truncated integer column");
+	}
+	const int width = static_cast<uint8_t>(data[offset++]);
+	const size_t packed_bytes = ((count - 1) * static_cast<size_t>(width) + 7) / 8;
+	if (width > 64 || size - offset < packed_bytes) {
+		throw std::runtime_error("Malformed integer column");
+	}
+
+	const auto *packed = reinterpret_cast<const uint8_t *>(data + offset);
+	size_t bit{0};
+	for (size_t i{1}; i < count; i++) {
+		uint64_t delta{0};
+		for (int read{0}; read < width;) {
+			int take = std::min(width - read, 8 - static_cast<int>(bit % 8));
+			delta |= static_cast<uint64_t>((packed[bit / 8] >> (bit % 8)) & ((1u << take) - 1)) << read;
+			read += take;
+			bit += static_cast<size_t>(take);
+		}
+		previous += static_cast<uint64_t>(unzigzag(delta));
+		out[i] = static_cast<int64_t>(previous);
+	}
+	return offset + packed_bytes;
+}
+
+void codec::encode_bitmap(const bool *values, size_t count, std::vector<char> &out) {
+	const size_t start = out.size();
+	out.resize(start + (count + 7) / 8, 0);
+	for (size_t i{0}; i < count; i++) {
+		out[start + i / 8] |= static_cast<char>(values[i] ? 1 << (i % 8) : 0);
+	}
+}
+
+size_t codec::decode_bitmap(const char *data, size_t size, size_t count, bool *out) {
+	const size_t bytes = (count + 7) / 8;
+	if (size < bytes) {
+		throw std::runtime_error("Truncated bitmap column");
+	}
+	for (size_t i{0}; i < count; i++) {
+		out[i] = (data[i / 8] >> (i % 8)) & 1;
+	}
+	return bytes;
+}
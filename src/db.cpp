@@ -1,23 +1,40 @@
 #include "db.h"
 #include "datapoint.h"
+#include "join.h"
 #include "query.h"
 #include <filesystem>
+#include <functional>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 void DataBase::create_table(const std::string &name, Table::Config &options) {
 	std::string table_path = create_table_path(name);
+	std::unique_lock<std::shared_mutex> lock(m_tables_mutex);
+	// Replacing a table would free it under callers still holding it from find_table()
+	if (m_tables.count(name) != 0) {
+		throw std::runtime_error("Table already exists: " + name);
+	}
 	std::filesystem::create_directories(table_path);
 	m_tables[name] = std::make_unique<Table>(name, table_path, options);
 }
 
+Table *DataBase::find_table(const std::string &table_name) const {
+	std::shared_lock<std::shared_mutex> lock(m_tables_mutex);
+	auto table = m_tables.find(table_name);
+	return table != m_tables.end() ? table->second.get() : nullptr;
+}
+
 const std::vector<std::string> DataBase::get_table_names() const {
 	std::vector<std::string> names;
+	std::shared_lock<std::shared_mutex> lock(m_tables_mutex);
 	for (const auto &[name, table] : m_tables) {
 		names.push_back(name);
 	}
@@ -25,17 +42,93 @@ const std::vector<std::string> DataBase::get_table_names() const {
 }
 
 void DataBase::insert(const std::string &table_name, const std::vector<DataPoint> &points) {
-	if (auto table = m_tables.find(table_name); table != m_tables.end()) {
-		table->second->insert(points);
+	if (auto table = find_table(table_name)) {
+		table->insert(points);
+	} else {
+		throw std::runtime_error("Table not found");
+	}
+}
+
+void DataBase::insert_rows(const std::string &table_name, const std::vector<Timestamp> &timestamps,
+						   const std::vector<std::vector<double>> &columns) {
+	if (auto table = find_table(table_name)) {
+		table->insert_rows(timestamps, columns);
+	} else {
+		throw std::runtime_error("Table not found");
+	}
+}
+
+ColumnQueryResult DataBase::query_columns(const std::string &table_name, const Query &query,
+										  const std::vector<size_t> &columns, QueryStats *stats) {
+	if (auto table = find_table(table_name)) {
+		return table->query_columns(query, columns, stats);
+	}
+	throw std::runtime_error("Table not found");
+}
+
+std::vector<JoinedPoint> DataBase::join(const std::string &left_table,
+									   const std::string &right_table, const JoinQuery &query) {
+	auto left = find_table(left_table);
+	auto right = find_table(right_table);
+	if (!left || !right) {
+		throw std::runtime_error("Table not found");
+	}
+	return join::run(*left, *right, query);
+}
+
+void DataBase::scan(const std::string &table_name, const TimeRange &range,
+					const std::function<void(const ChunkSnapshot &)> &visit) {
+	if (auto table = find_table(table_name)) {
+		table->scan(range, visit);
 	} else {
 		throw std::runtime_error("Table not found");
 	}
 }
 
-std::vector<DataPoint> DataBase::query(const std::string &table_name, const Query &query) {
+std::vector<DataPoint> DataBase::query(const std::string &table_name, const Query &query,
+									   QueryStats *stats) {
 	std::vector<DataPoint> results{};
-	if (auto table = m_tables.find(table_name); table != m_tables.end()) {
-		results = table->second->query(query);
+	if (auto table = find_table(table_name)) {
+		results = table->query(query, stats);
+	} else {
+		std::cerr << "Table not found: " << table_name << '\n';
+	}
+	return results;
+}
+
+std::vector<std::vector<DataPoint>> DataBase::query_batch(const std::vector<TableQuery> &queries) {
+	std::vector<std::vector<DataPoint>> results(queries.size());
+
+	// Group by table so each table plans its queries together
+	std::unordered_map<Table *, std::vector<size_t>> indices_by_table{};
+	for (size_t i{0}; i < queries.size(); i++) {
+		if (auto table = find_table(queries[i].table_name)) {
+			indices_by_table[table].push_back(i);
+		} else {
+			std::cerr << "Table not found: " << queries[i].table_name << '\n';
+		}
+	}
+
+	for (const auto &[table, indices] : indices_by_table) {
+		std::vector<Query> table_queries{};
+		table_queries.reserve(indices.size());
+		for (size_t i : indices) {
+			table_queries.push_back(queries[i].query);
+		}
+
+		auto table_results = table->query_batch(table_queries);
+		for (size_t j{0}; j < indices.size(); j++) {
+			results[indices[j]] = std::move(table_results[j]);
+		}
+	}
+	return results;
+}
+
+std::vector<double> DataBase::quantiles(const std::string &table_name, const TimeRange &range,
+									   const std::vector<double> &qs) {
+	std::vector<double> results{};
+	if (auto table = find_table(table_name)) {
+		results = table->quantiles(range, qs);
 	} else {
 		std::cerr << "Table not found: " << table_name << '\n';
 	}
@@ -0,0 +1,290 @@
+#include "downsample.h"
+#include "chunk.h"
+#include "config.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Rows [first, last) of a chunk that fall inside the query range
+struct ChunkSpan
+{
+	const ChunkSnapshot *chunk;
+	size_t first;
+	size_t last;
+};
+
+template <typename Visit>
+void for_each_point(const ChunkSpan &span, const ValuePredicate &predicate, Visit visit) {
+	for (size_t i{span.first}; i < span.last; i++) {
+		if (!span.chunk->has_row(i))
+			continue;
+		double value = span.chunk->value_at(i);
+		if (predicate.matches(value)) {
+			visit(DataPoint{span.chunk->timestamp_at(i), value});
+		}
+	}
+}
+
+// Keeps the span's points while they still fit the target; past it, drops them for good
+void keep_points(std::optional<std::vector<DataPoint>> &points, const ChunkSpan &span,
+				 const ValuePredicate &predicate, size_t target_points) {
+	if (!points) {
+		return;
+	}
+	for_each_point(span, predicate, [&](const DataPoint &p) {
+		if (points && points->size() == target_points) {
+			points.reset();
+		}
+		if (points) {
+			points->push_back(p);
+		}
+	});
+}
+
+// Runs `partial` for every morsel of the span on the executor and returns the results in row
+// order, so a chunk far larger than the rest is shared among workers
+template <typename Partial>
+auto map_morsels(const ChunkSpan &span, WorkStealingExecutor &executor, Partial partial) {
+	std::vector<ChunkSpan> morsels{};
+	for (size_t first{span.first}; first < span.last; first += Config::SCAN_MORSEL_ROWS) {
+		morsels.push_back(ChunkSpan{span.chunk, first, std::min(span.last, first + Config::SCAN_MORSEL_ROWS)});
+	}
+	using Result = decltype(partial(span));
+	std::vector<Result> results(morsels.size());
+	executor.parallel_for(morsels.size(), [&](size_t i) { results[i] = partial(morsels[i]); });
+	return results;
+}
+
+void check_target(size_t target_points, size_t minimum) {
+	if (target_points < minimum || target_points > Config::DOWNSAMPLE_MAX_POINTS) {
+		throw std::invalid_argument("Downsampling needs a target of " + std::to_string(minimum) +
+									" to " + std::to_string(Config::DOWNSAMPLE_MAX_POINTS) +
+									" points");
+	}
+}
+
+} // namespace
+
+size_t downsample::Buckets::index_of(Timestamp ts) const {
+	if (ts < start) {
+		return 0;
+	}
+	auto index = static_cast<size_t>(static_cast<double>(ts - start) / width);
+	return std::min(index, count - 1);
+}
+
+downsample::MinMax::MinMax(const TimeRange &extent, const ValuePredicate &predicate,
+						   size_t target_points, WorkStealingExecutor &executor)
+	: m_predicate(predicate), m_target_points(target_points), m_executor(executor),
+	  m_buckets{extent.start_ts, 0, 0}, m_points(std::vector<DataPoint>{}) {
+	check_target(target_points, 2);
+	// Each bucket emits up to two points
+	m_buckets.count = target_points / 2;
+	m_buckets.width = static_cast<double>(extent.end_ts - extent.start_ts + 1) /
+					  static_cast<double>(m_buckets.count);
+	m_merged.resize(m_buckets.count);
+}
+
+void downsample::MinMax::add(const ChunkSnapshot &chunk, const TimeRange &range) {
+	TSDB_TRACE_SPAN("downsample.min_max");
+	auto [first, last] = chunk.get_index_range(range);
+	const ChunkSpan span{&chunk, first, last};
+	keep_points(m_points, span, m_predicate, m_target_points);
+
+	auto partials = map_morsels(span, m_executor, [&](const ChunkSpan &morsel) {
+		std::vector<Bucket> partial{};
+		for_each_point(morsel, m_predicate, [&](const DataPoint &p) {
+			size_t bucket = m_buckets.index_of(p.ts);
+			if (partial.empty() || partial.back().bucket != bucket) {
+				partial.push_back(Bucket{bucket, p, p});
+			} else {
+				if (p.value < partial.back().min.value)
+					partial.back().min = p;
+				if (p.value > partial.back().max.value)
+					partial.back().max = p;
+			}
+		});
+		return partial;
+	});
+
+	// Stitch buckets that span morsel and chunk boundaries
+	for (const auto &partial : partials) {
+		for (const auto &bucket : partial) {
+			auto &slot = m_merged[bucket.bucket];
+			if (!slot) {
+				slot = bucket;
+				continue;
+			}
+			if (bucket.min.value < slot->min.value)
+				slot->min = bucket.min;
+			if (bucket.max.value > slot->max.value)
+				slot->max = bucket.max;
+		}
+	}
+}
+
+std::vector<DataPoint> downsample::MinMax::finish() {
+	if (m_points) {
+		return std::move(*m_points);
+	}
+	std::vector<DataPoint> results{};
+	results.reserve(m_target_points);
+	for (const auto &slot : m_merged) {
+		if (!slot)
+			continue;
+		const auto &[_, min, max] = *slot;
+		if (min.ts == max.ts) {
+			results.push_back(min);
+		} else if (min.ts < max.ts) {
+			results.push_back(min);
+			results.push_back(max);
+		} else {
+			results.push_back(max);
+			results.push_back(min);
+		}
+	}
+	return results;
+}
+
+downsample::Lttb::Lttb(const TimeRange &extent, const ValuePredicate &predicate,
+					   size_t target_points, WorkStealingExecutor &executor)
+	: m_predicate(predicate), m_target_points(target_points), m_executor(executor),
+	  m_buckets{extent.start_ts + 1, 0, 0}, m_points(std::vector<DataPoint>{}) {
+	check_target(target_points, 3);
+	// The first and last points are always kept; the rest fall into target - 2 buckets
+	m_buckets.count = target_points - 2;
+	m_buckets.width = static_cast<double>(extent.end_ts - extent.start_ts - 1) /
+					  static_cast<double>(m_buckets.count);
+	m_buckets.width = std::max(m_buckets.width, 1.0);
+	m_sums.assign(m_buckets.count, Sum{0, 0, 0, 0});
+}
+
+void downsample::Lttb::add(const ChunkSnapshot &chunk, const TimeRange &range) {
+	TSDB_TRACE_SPAN("downsample.lttb");
+	auto [first, last] = chunk.get_index_range(range);
+	const ChunkSpan span{&chunk, first, last};
+	keep_points(m_points, span, m_predicate, m_target_points);
+
+	for (size_t i{first}; i < last && !m_first; i++) {
+		if (chunk.has_row(i) && m_predicate.matches(chunk.value_at(i))) {
+			m_first = DataPoint{chunk.timestamp_at(i), chunk.value_at(i)};
+		}
+	}
+	for (size_t i{last}; i > first; i--) {
+		if (chunk.has_row(i - 1) && m_predicate.matches(chunk.value_at(i - 1))) {
+			m_last = DataPoint{chunk.timestamp_at(i - 1), chunk.value_at(i - 1)};
+			break;
+		}
+	}
+
+	// Pass 1: bucket sums of every point. The first and last are only known at the end, so
+	// they are taken back out in prepare_selection().
+	auto partials = map_morsels(span, m_executor, [&](const ChunkSpan &morsel) {
+		std::vector<Sum> partial{};
+		for_each_point(morsel, m_predicate, [&](const DataPoint &p) {
+			size_t bucket = m_buckets.index_of(p.ts);
+			if (partial.empty() || partial.back().bucket != bucket) {
+				partial.push_back(Sum{bucket, 0, 0, 0});
+			}
+			partial.back().ts_sum += static_cast<double>(p.ts);
+			partial.back().value_sum += p.value;
+			partial.back().count++;
+		});
+		return partial;
+	});
+	for (const auto &partial : partials) {
+		for (const auto &bucket : partial) {
+			auto &slot = m_sums[bucket.bucket];
+			slot.ts_sum += bucket.ts_sum;
+			slot.value_sum += bucket.value_sum;
+			slot.count += bucket.count;
+		}
+	}
+}
+
+bool downsample::Lttb::selection_needed() const {
+	return !m_points && m_first && m_first->ts != m_last->ts;
+}
+
+void downsample::Lttb::prepare_selection() {
+	for (const auto &end : {*m_first, *m_last}) {
+		auto &slot = m_sums[m_buckets.index_of(end.ts)];
+		slot.ts_sum -= static_cast<double>(end.ts);
+		slot.value_sum -= end.value;
+		slot.count--;
+	}
+
+	// Average of the next non-empty bucket after each bucket (the last point past the end)
+	m_next_average.resize(m_buckets.count);
+	std::pair<double, double> average{static_cast<double>(m_last->ts), m_last->value};
+	for (size_t b{m_buckets.count}; b > 0; b--) {
+		m_next_average[b - 1] = average;
+		const auto &slot = m_sums[b - 1];
+		if (slot.count > 0) {
+			average = {slot.ts_sum / static_cast<double>(slot.count),
+					   slot.value_sum / static_cast<double>(slot.count)};
+		}
+	}
+	m_results.reserve(m_target_points);
+	m_results.push_back(*m_first);
+	m_anchor = *m_first;
+}
+
+void downsample::Lttb::select(const ChunkSnapshot &chunk, const TimeRange &range) {
+	if (m_next_average.empty()) {
+		prepare_selection();
+	}
+	auto [first, last] = chunk.get_index_range(range);
+	// Pass 2 (sequential): per bucket, keep the point forming the largest triangle with the
+	// previously kept point and the next bucket's average
+	for_each_point(ChunkSpan{&chunk, first, last}, m_predicate, [&](const DataPoint &p) {
+		if (!is_interior(p))
+			return;
+		size_t bucket = m_buckets.index_of(p.ts);
+		if (bucket != m_current) {
+			if (m_current != std::numeric_limits<size_t>::max()) {
+				m_results.push_back(m_best);
+				m_anchor = m_best;
+			}
+			m_current = bucket;
+			m_best = p;
+			m_best_area = -1;
+		}
+		const auto &[next_ts, next_value] = m_next_average[bucket];
+		const double ax = static_cast<double>(m_anchor.ts);
+		double area = std::abs((ax - next_ts) * (p.value - m_anchor.value) -
+							   (ax - static_cast<double>(p.ts)) * (next_value - m_anchor.value));
+		if (area > m_best_area) {
+			m_best = p;
+			m_best_area = area;
+		}
+	});
+}
+
+std::vector<DataPoint> downsample::Lttb::finish() {
+	if (m_points) {
+		return std::move(*m_points);
+	}
+	if (!m_first || m_first->ts == m_last->ts) {
+		return m_first ? std::vector<DataPoint>{*m_first} : std::vector<DataPoint>{};
+	}
+	if (m_next_average.empty()) {
+		prepare_selection();
+	}
+	if (m_current != std::numeric_limits<size_t>::max()) {
+		m_results.push_back(m_best);
+	}
+	m_results.push_back(*m_last);
+	return std::move(m_results);
+}
@@ -0,0 +1,97 @@
+#include "executor.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <utility>
+
+namespace {
+// The executor and deque of the worker running on this thread, if any
+thread_local WorkStealingExecutor *current_executor{nullptr};
+thread_local size_t current_worker{0};
+} // namespace
+
+WorkStealingExecutor::WorkStealingExecutor(size_t threads) {
+	threads = std::max<size_t>(threads, 1);
+	m_workers.reserve(threads);
+	for (size_t i{0}; i < threads; i++) {
+		m_workers.push_back(std::make_unique<Worker>());
+	}
+	m_threads.reserve(threads);
+	for (size_t i{0}; i < threads; i++) {
+		m_threads.emplace_back([this, i]() { run_worker(i); });
+	}
+}
+
+WorkStealingExecutor::~WorkStealingExecutor() {
+	{
+		std::lock_guard<std::mutex> lock(m_sleep_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+	// Workers finish every queued task before exiting
+	m_threads.clear();
+}
+
+void WorkStealingExecutor::submit(std::function<void()> task) {
+	const size_t index = current_executor == this
+							 ? current_worker
+							 : m_next_worker.fetch_add(1, std::memory_order_relaxed) % m_workers.size();
+	{
+		std::lock_guard<std::mutex> lock(m_workers[index]->mutex);
+		m_workers[index]->tasks.push_back(std::move(task));
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_sleep_mutex);
+		m_queued.fetch_add(1, std::memory_order_relaxed);
+	}
+	m_wake.notify_one();
+}
+
+bool WorkStealingExecutor::run_one() {
+	std::function<void()> task{};
+	const bool is_worker = current_executor == this;
+	const size_t self = is_worker ? current_worker
+								  : m_next_worker.load(std::memory_order_relaxed) % m_workers.size();
+	if (is_worker) {
+		// Own work newest first, while its data is still in cache
+		Worker &own = *m_workers[self];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+		}
+	}
+	// Others' work oldest first, which tends to be the largest remaining piece
+	for (size_t offset{is_worker ? size_t{1} : size_t{0}}; !task && offset < m_workers.size();
+		 offset++) {
+		Worker &victim = *m_workers[(self + offset) % m_workers.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+		}
+	}
+	if (!task) {
+		return false;
+	}
+	m_queued.fetch_sub(1, std::memory_order_relaxed);
+	task();
+	return true;
+}
+
+void WorkStealingExecutor::run_worker(size_t index) {
+	current_executor = this;
+	current_worker = index;
+	while (true) {
+		if (run_one())
+			continue;
+		std::unique_lock<std::mutex> lock(m_sleep_mutex);
+		m_wake.wait(lock, [this]() {
+			return m_stopping || m_queued.load(std::memory_order_relaxed) > 0;
+		});
+		if (m_stopping && m_queued.load(std::memory_order_relaxed) == 0)
+			return;
+	}
+}
@@ -0,0 +1,133 @@
+#include "fill.h"
+#include "chunk.h"
+#include "config.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+// The first grid point at or after `ts`; the remainder is floored so negative times round up too
+Timestamp grid_after(Timestamp ts, TimeDelta step) {
+	const Timestamp remainder = (ts % step + step) % step;
+	return remainder == 0 ? ts : ts + (step - remainder);
+}
+
+const std::string TOO_MANY_POINTS =
+	"Gap filled query exceeds " + std::to_string(Config::FILL_MAX_POINTS) + " points";
+} // namespace
+
+fill::Grid::Grid(const TimeRange &range, const ValuePredicate &predicate, FillStrategy strategy,
+				 TimeDelta step, const std::optional<DataPoint> &before)
+	: m_range(range), m_predicate(predicate), m_strategy(strategy), m_step(step),
+	  m_previous(before) {
+	if (step <= 0 || step > TIMESTAMP_MAX) {
+		throw std::invalid_argument("Gap filling needs a step in (0, TIMESTAMP_MAX]");
+	}
+	// Open ends of the range are clipped to the data, so an unbounded query stays finite
+	if (range.start_ts != TIMESTAMP_MIN) {
+		m_grid = grid_after(range.start_ts, step);
+	}
+	if (m_grid && range.end_ts != TIMESTAMP_MAX && *m_grid <= range.end_ts) {
+		const auto points = static_cast<size_t>((range.end_ts - *m_grid) / step) + 1;
+		if (points > Config::FILL_MAX_POINTS) {
+			throw std::invalid_argument(TOO_MANY_POINTS);
+		}
+		m_results.reserve(points);
+	}
+}
+
+double fill::Grid::value_at(Timestamp ts, const std::optional<DataPoint> &next) const {
+	// A grid point holds the last point of the step ending at it, else the filled value
+	if (m_previous && m_previous->ts > ts - m_step) {
+		return m_previous->value;
+	}
+	if (m_strategy == FillStrategy::Previous && m_previous) {
+		return m_previous->value;
+	}
+	if (m_strategy == FillStrategy::Linear && m_previous && next) {
+		const double fraction = static_cast<double>(ts - m_previous->ts) /
+								static_cast<double>(next->ts - m_previous->ts);
+		return m_previous->value + (next->value - m_previous->value) * fraction;
+	}
+	return std::numeric_limits<double>::quiet_NaN();
+}
+
+void fill::Grid::emit_before(const std::optional<DataPoint> &next, Timestamp end_ts) {
+	if (!m_grid) {
+		return;
+	}
+	Timestamp &grid = *m_grid;
+	while (grid <= end_ts && (!next || grid < next->ts)) {
+		// Only an open range gets here without its size checked up front
+		if (m_results.size() == Config::FILL_MAX_POINTS) {
+			throw std::invalid_argument(TOO_MANY_POINTS);
+		}
+		m_results.push_back(DataPoint{grid, value_at(grid, next)});
+		// Past TIMESTAMP_MAX the grid parks just beyond it instead of stepping on towards overflow
+		grid = grid <= TIMESTAMP_MAX - m_step ? grid + m_step : TIMESTAMP_MAX + 1;
+	}
+}
+
+void fill::Grid::add(const ChunkSnapshot &chunk) {
+	TSDB_TRACE_SPAN("fill.chunk");
+	auto [first, last] = chunk.get_index_range(m_range);
+
+	// Rows just before the range bridge the gap at its start
+	for (size_t i{first}; i > 0; i--) {
+		if (chunk.has_row(i - 1) && m_predicate.matches(chunk.value_at(i - 1))) {
+			if (!m_previous || chunk.timestamp_at(i - 1) > m_previous->ts) {
+				m_previous = DataPoint{chunk.timestamp_at(i - 1), chunk.value_at(i - 1)};
+			}
+			break;
+		}
+	}
+
+	// The data's extent, whatever the values, clips open ends of the range
+	for (size_t i{first}; i < last; i++) {
+		if (chunk.has_row(i)) {
+			m_grid = m_grid ? m_grid : grid_after(chunk.timestamp_at(i), m_step);
+			break;
+		}
+	}
+	for (size_t i{last}; i > first; i--) {
+		if (chunk.has_row(i - 1)) {
+			m_last_ts = chunk.timestamp_at(i - 1);
+			break;
+		}
+	}
+
+	// One pass in time order, reading the chunk in morsels
+	for (size_t begin{first}; begin < last; begin += Config::SCAN_MORSEL_ROWS) {
+		const size_t end = std::min(last, begin + Config::SCAN_MORSEL_ROWS);
+		for (const auto &point : chunk.get_rows(begin, end, m_predicate)) {
+			emit_before(point, m_range.end_ts);
+			m_previous = point;
+		}
+	}
+
+	// Rows just after the range bridge the gap at its end
+	if (m_strategy == FillStrategy::Linear && !m_after) {
+		for (size_t i{last}; i < chunk.size(); i++) {
+			if (chunk.has_row(i) && m_predicate.matches(chunk.value_at(i))) {
+				m_after = DataPoint{chunk.timestamp_at(i), chunk.value_at(i)};
+				break;
+			}
+		}
+	}
+}
+
+std::vector<DataPoint> fill::Grid::finish(const std::optional<DataPoint> &after) {
+	const bool open_end = m_range.end_ts == TIMESTAMP_MAX;
+	if (open_end && !m_last_ts) {
+		return {};
+	}
+	// The rest of the grid lies before the first point after the range
+	emit_before(m_after ? m_after : after, open_end ? *m_last_ts : m_range.end_ts);
+	return std::move(m_results);
+}
@@ -0,0 +1,129 @@
+#include "filter.h"
+
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Branch-free compress: every index is written, but the output cursor only advances on a
+// match, so the compare vectorises and there is no data-dependent branch to mispredict.
+template <typename Compare>
+size_t select_scalar(
+	const double* values,
+	uint32_t begin,
+	uint32_t end,
+	Compare compare,
+	uint32_t* out
+) {
+	size_t n{0};
+	for (uint32_t i{begin}; i < end; i++) {
+		out[n] = i;
+		n += compare(values[i]) ? 1 : 0;
+	}
+	return n;
+}
+
+#if defined(__AVX2__)
+// Lane offsets of the set bits of each 4-bit compare mask, packed to the front
+alignas(16) constexpr uint32_t COMPRESS_LANES[16][4] = {
+	{0, 0, 0, 0}, {0, 0, 0, 0}, {1, 0, 0, 0}, {0, 1, 0, 0}, {2, 0, 0, 0}, {0, 2, 0, 0},
+	{1, 2, 0, 0}, {0, 1, 2, 0}, {3, 0, 0, 0}, {0, 3, 0, 0}, {1, 3, 0, 0}, {0, 1, 3, 0},
+	{2, 3, 0, 0}, {0, 2, 3, 0}, {1, 2, 3, 0}, {0, 1, 2, 3},
+};
+
+template <typename Compare, typename VectorCompare>
+size_t select_avx2(
+	const double* values,
+	uint32_t begin,
+	uint32_t end,
+	Compare compare,
+	VectorCompare vector_compare,
+	uint32_t* out
+) {
+	size_t n{0};
+	uint32_t i{begin};
+	for (; i + 4 <= end; i += 4) {
+		const int mask = _mm256_movemask_pd(vector_compare(_mm256_loadu_pd(values + i)));
+		const __m128i lanes =
+			_mm_load_si128(reinterpret_cast<const __m128i *>(COMPRESS_LANES[mask]));
+		// Always stores four lanes; only the first popcount(mask) are kept
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + n),
+						 _mm_add_epi32(lanes, _mm_set1_epi32(static_cast<int>(i))));
+		n += std::popcount(static_cast<unsigned>(mask));
+	}
+	return n + select_scalar(values, i, end, compare, out + n);
+}
+#endif
+
+template <typename Compare, typename VectorCompare>
+size_t dispatch(
+	const double* values,
+	uint32_t begin,
+	uint32_t end,
+	Compare compare,
+	[[maybe_unused]] VectorCompare vector_compare,
+	uint32_t* out
+) {
+#if defined(__AVX2__)
+	return select_avx2(values, begin, end, compare, vector_compare, out);
+#else
+	return select_scalar(values, begin, end, compare, out);
+#endif
+}
+
+} // namespace
+
+#if defined(__AVX2__)
+#define TSDB_VECTOR_COMPARE(expr) [&](__m256d x) { return expr; }
+#else
+#define TSDB_VECTOR_COMPARE(expr) nullptr
+#endif
+
+size_t filter::select(
+	const double* values,
+	uint32_t begin,
+	uint32_t end,
+	const ValuePredicate& predicate,
+	uint32_t* out
+) {
+	if (begin >= end) {
+		return 0;
+	}
+
+	[[maybe_unused]] const double lower = predicate.m_lower;
+	[[maybe_unused]] const double upper = predicate.m_upper;
+#if defined(__AVX2__)
+	[[maybe_unused]] const __m256d lower_v = _mm256_set1_pd(lower);
+	[[maybe_unused]] const __m256d upper_v = _mm256_set1_pd(upper);
+#endif
+
+	switch (predicate.m_op) {
+	case ValuePredicate::Op::Greater:
+		return dispatch(values, begin, end, [&](double v) { return v > lower; },
+						TSDB_VECTOR_COMPARE(_mm256_cmp_pd(x, lower_v, _CMP_GT_OQ)), out);
+	case ValuePredicate::Op::Less:
+		return dispatch(values, begin, end, [&](double v) { return v < upper; },
+						TSDB_VECTOR_COMPARE(_mm256_cmp_pd(x, upper_v, _CMP_LT_OQ)), out);
+	case ValuePredicate::Op::Between:
+		return dispatch(values, begin, end, [&](double v) { return v >= lower && v <= upper; },
+						TSDB_VECTOR_COMPARE(_mm256_and_pd(_mm256_cmp_pd(x, lower_v, _CMP_GE_OQ),
+														  _mm256_cmp_pd(x, upper_v, _CMP_LE_OQ))),
+						out);
+	case ValuePredicate::Op::NotNaN:
+		return dispatch(values, begin, end, [](double v) { return !std::isnan(v); },
+						TSDB_VECTOR_COMPARE(_mm256_cmp_pd(x, x, _CMP_ORD_Q)), out);
+	default:
+		for (uint32_t i{begin}; i < end; i++) {
+			out[i - begin] = i;
+		}
+		return end - begin;
+	}
+}
+
+#undef TSDB_VECTOR_COMPARE
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include <sys/types.h>
+
+// Batched file I/O for chunk loads and saves. A batch is submitted at once and waited on as a
+// whole, so a query's cache misses are in flight together rather than one per pool worker.
+// io_uring is used when the kernel allows it, otherwise preads and pwrites run on threads.
+namespace aio
+{
+enum class Backend
+{
+	Uring,
+	Threads
+};
+
+// One read or write of `length` bytes at `offset`. Short transfers are continued until the
+// whole range is done, end of file is reached or an error occurs.
+struct Request
+{
+	int fd;
+	uint64_t offset;
+	char* data;
+	size_t length;
+	bool write{ false };
+	ssize_t result{ 0 }; // Bytes transferred, or -errno
+};
+
+class Engine
+{
+  public:
+	virtual ~Engine() = default;
+	// Runs every request and returns once all have completed. Safe to call from many threads.
+	virtual void submit(std::span<Request> requests) = 0;
+	virtual Backend backend() const = 0;
+};
+
+// Falls back to threads when io_uring is unavailable (old kernel, seccomp, missing opcodes)
+std::unique_ptr<Engine> make_engine(Backend preferred = Backend::Uring);
+// Shared by every table. TSDB_AIO=threads in the environment forces the thread backend.
+Engine& default_engine();
+
+// Uninitialised bytes for one transfer; `capacity` may exceed `size` when reused
+struct Buffer
+{
+	std::unique_ptr<char[]> data;
+	size_t size{ 0 };
+	size_t capacity{ 0 };
+};
+
+// Reuses I/O buffers between loads so cold scans do not allocate a buffer per chunk
+class BufferPool
+{
+  public:
+	BufferPool(size_t max_buffers, size_t max_buffer_bytes)
+		: m_max_buffers(max_buffers)
+		, m_max_buffer_bytes(max_buffer_bytes)
+	{
+	}
+	// The smallest free buffer that fits, or a new one
+	Buffer acquire(size_t size);
+	void release(Buffer&& buffer);
+
+  private:
+	const size_t m_max_buffers;
+	const size_t m_max_buffer_bytes; // Larger buffers are freed rather than kept
+	std::mutex m_mutex;
+	std::vector<Buffer> m_free;
+};
+
+BufferPool& default_buffer_pool();
+} // namespace aio
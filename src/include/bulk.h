@@ -0,0 +1,73 @@
+#pragma once
+
+#include "config.h"
+#include "db.h"
+#include "utils.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+
+// Columnar bulk transfer format for backups and migrations. A file is a header and the table's
+// column layout followed by blocks, each holding up to `block_points` timestamps and then the
+// values of every value column in turn, either raw doubles or encoded with the column codecs in
+// codec.h, and ends with an empty block. Numbers are in host byte order.
+namespace bulk
+{
+struct FileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t flags;
+	Timestamp start_ts; // Range the export was taken over
+	Timestamp end_ts;
+};
+static_assert(sizeof(FileHeader) == 32);
+
+// Follows the FileHeader from version 2; version 1 files hold one float64 column
+struct ColumnsHeader
+{
+	uint32_t columns;
+	uint8_t value_type; // ValueType of the exported table; values are written as doubles
+	uint8_t reserved[3];
+};
+static_assert(sizeof(ColumnsHeader) == 8);
+
+struct BlockHeader
+{
+	uint32_t points; // 0 ends the file
+	uint32_t payload_bytes;
+};
+
+constexpr char MAGIC[8] = { 'T', 'S', 'D', 'B', 'B', 'L', 'K', '1' };
+constexpr uint32_t VERSION{ 2 };
+constexpr uint32_t FLAG_COMPRESSED{ 1 };
+
+struct ExportOptions
+{
+	bool compress{ false };
+	size_t block_points{ Config::BULK_BLOCK_POINTS };
+};
+
+struct TransferStats
+{
+	uint64_t points{ 0 };
+	uint64_t blocks{ 0 };
+	uint64_t bytes{ 0 }; // File bytes written or read
+};
+
+// Streams the points of `table_name` within the range to `out`, one chunk in memory at a time
+TransferStats export_table(
+	DataBase& db,
+	const std::string& table_name,
+	const TimeRange& range,
+	std::ostream& out,
+	const ExportOptions& options = ExportOptions()
+);
+// Inserts every point of an export into an existing table, one block at a time. The table must
+// have the export's value columns and type. Throws on a malformed or truncated file; blocks
+// before the error stay inserted.
+TransferStats import_table(DataBase& db, const std::string& table_name, std::istream& in);
+} // namespace bulk
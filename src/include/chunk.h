@@ -3,66 +3,314 @@
 #include "datapoint.h"
 #include "utils.h"
 #include "chunkfilemetadata.h"
+#include "column.h"
+#include "predicate.h"
+#include "sketch.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
 #include <vector>
 #include <stdexcept>
 
+// Row storage shared between a chunk and its snapshots. Rows below `rows` never change: a
+// writer only fills the slot at `rows` before publishing it, and replaces the whole buffer
+// (copy on write) to insert anywhere else. A buffer is freed with its last snapshot.
+// Values are held in the table's storage type, so a bool column takes one byte per row. Wide
+// tables keep `columns` value columns against the one timestamp column, each `capacity` long.
+// A regular series (resolution > 0) stores no timestamps: row i is the sample at
+// i * resolution into the chunk, and `present` marks the rows that hold one.
+struct ChunkRows
+{
+	explicit ChunkRows(
+		size_t capacity,
+		ValueType value_type = ValueType::Float64,
+		size_t columns = 1,
+		TimeDelta resolution = 0
+	)
+		: deltas(resolution ? std::unique_ptr<Timestamp[]>() : std::make_unique_for_overwrite<Timestamp[]>(capacity))
+		, present(resolution ? std::make_unique<std::atomic<uint64_t>[]>((capacity + 63) / 64) : nullptr)
+		// Absent rows of a regular series are written to disk, so they start zeroed
+		, values(
+			  resolution ? std::make_unique<std::byte[]>(capacity * value_size(value_type) * columns)
+						 : std::make_unique_for_overwrite<std::byte[]>(capacity * value_size(value_type) * columns)
+		  )
+		, capacity(capacity)
+		, value_type(value_type)
+		, columns(columns)
+		, resolution(resolution)
+	{
+	}
+
+	template <typename T>
+	T* column(size_t index = 0)
+	{
+		return reinterpret_cast<T*>(values.get()) + index * capacity;
+	}
+	template <typename T>
+	const T* column(size_t index = 0) const
+	{
+		return reinterpret_cast<const T*>(values.get()) + index * capacity;
+	}
+	double value_at(size_t row, size_t column_index = 0) const
+	{
+		return visit_value_type(value_type, [&]<typename T>(std::type_identity<T>) {
+			return ValueTraits<T>::load(column<T>(column_index)[row]);
+		});
+	}
+	TimeDelta delta_at(size_t row) const
+	{
+		return resolution ? static_cast<TimeDelta>(row) * resolution : deltas[row];
+	}
+	bool has_row(size_t row) const
+	{
+		return !present || (present[row / 64].load(std::memory_order_relaxed) >> (row % 64)) & 1;
+	}
+
+	std::unique_ptr<Timestamp[]> deltas; // Null for a regular series
+	// Set bits are only ever added past `rows` before it is published, or in a fresh copy
+	std::unique_ptr<std::atomic<uint64_t>[]> present;
+	std::unique_ptr<std::byte[]> values;
+	const size_t capacity;
+	const ValueType value_type;
+	const size_t columns;
+	const TimeDelta resolution;
+	// Unique per buffer. Rows below `rows` never change once published, so a generation and a
+	// row count identify exactly what a snapshot sees.
+	const uint64_t generation{ next_generation() };
+	std::atomic<size_t> rows{ 0 };
+
+  private:
+	static uint64_t next_generation()
+	{
+		static std::atomic<uint64_t> counter{ 0 };
+		return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+	}
+};
+
+// Immutable view of a chunk's rows as of when it was taken. Reading it takes no locks and is
+// unaffected by later appends.
+class ChunkSnapshot
+{
+  public:
+	ChunkSnapshot() = default;
+	ChunkSnapshot(
+		const TimeRange& range,
+		std::shared_ptr<const ChunkRows> rows,
+		size_t size,
+		double min_value,
+		double max_value
+	)
+		: m_range(range)
+		, m_rows(std::move(rows))
+		, m_size(size)
+		, m_min_value(min_value)
+		, m_max_value(max_value)
+	{
+	}
+
+	std::vector<DataPoint> get_data_in_range(
+		const TimeRange& range,
+		const ValuePredicate& predicate = ValuePredicate()
+	) const;
+	// The matching points among rows [first, last), a slice of what get_index_range returns
+	std::vector<DataPoint> get_rows(size_t first, size_t last, const ValuePredicate& predicate) const;
+	// Appends up to `limit` total points to `out`, reading the range backwards from its end
+	void get_latest_in_range(
+		const TimeRange& range,
+		const ValuePredicate& predicate,
+		size_t limit,
+		std::vector<DataPoint>& out
+	) const;
+	// Row indices [first, last) whose timestamps fall inside the range (rows are time ordered).
+	// A regular series finds them by arithmetic; skip rows without has_row().
+	std::pair<size_t, size_t> get_index_range(const TimeRange& range) const;
+	bool may_match(const ValuePredicate& predicate) const
+	{
+		return predicate.may_match(m_min_value, m_max_value);
+	}
+
+	Timestamp timestamp_at(size_t index) const { return m_range.start_ts + m_rows->delta_at(index); }
+	// False for the rows of a regular series that have no sample
+	bool has_row(size_t index) const { return m_rows->has_row(index); }
+	double value_at(size_t index, size_t column_index = 0) const
+	{
+		return m_rows->value_at(index, column_index);
+	}
+	// Null for a regular series, whose timestamps are implied by the row index
+	const Timestamp* deltas() const { return m_rows ? m_rows->deltas.get() : nullptr; }
+	// Raw values in the storage type; T must match value_type()
+	template <typename T>
+	const T* column(size_t index = 0) const
+	{
+		return m_rows ? m_rows->column<T>(index) : nullptr;
+	}
+	ValueType value_type() const { return m_rows ? m_rows->value_type : ValueType::Float64; }
+	size_t columns() const { return m_rows ? m_rows->columns : 1; }
+	TimeDelta resolution() const { return m_rows ? m_rows->resolution : 0; }
+	// Identifies the buffer; with size() it identifies the snapshot's contents (see ChunkRows)
+	uint64_t generation() const { return m_rows ? m_rows->generation : 0; }
+
+	const TimeRange& get_range() const { return m_range; }
+	// Rows, including the absent rows of a regular series
+	size_t size() const { return m_size; }
+	// Rows that hold a point
+	size_t count() const;
+	// The earliest and latest rows that hold a point
+	std::optional<DataPoint> first_point() const;
+	std::optional<DataPoint> last_point() const;
+	bool empty() const { return m_size == 0; }
+	double min_value() const { return m_min_value; }
+	double max_value() const { return m_max_value; }
+
+  private:
+	TimeRange m_range{};
+	std::shared_ptr<const ChunkRows> m_rows{};
+	size_t m_size{ 0 };
+	double m_min_value{ std::numeric_limits<double>::infinity() };
+	double m_max_value{ -std::numeric_limits<double>::infinity() };
+};
+
 class Chunk
 {
   public:
-	Chunk(TimeRange range, ChunkId id, size_t capacity)
+	Chunk(
+		TimeRange range,
+		ChunkId id,
+		size_t capacity,
+		ValueType value_type = ValueType::Float64,
+		size_t columns = 1,
+		TimeDelta resolution = 0
+	)
 		: m_range(range)
 		, m_id(id)
-		, m_capacity(capacity)
+		// A regular series needs a row for every slot of the range
+		, m_capacity(
+			  resolution > 0
+				  ? std::max(capacity, static_cast<size_t>((range.duration() + resolution - 1) / resolution))
+				  : capacity
+		  )
+		, m_value_type(value_type)
+		, m_columns(columns)
+		, m_resolution(std::max<TimeDelta>(resolution, 0))
 		, m_row_count(0)
 		, m_is_to_save(false)
-
+		, m_min_value(std::numeric_limits<double>::infinity())
+		, m_max_value(-std::numeric_limits<double>::infinity())
 	{
 		if (capacity == 0)
 		{
 			throw std::invalid_argument("Initial capacity must be greater than zero.");
 		}
+		if (columns == 0)
+		{
+			throw std::invalid_argument("A chunk needs at least one value column.");
+		}
 
-		m_ts_deltas.reserve(capacity);
-		m_values.reserve(capacity);
+		m_rows = std::make_shared<ChunkRows>(m_capacity, value_type, columns, m_resolution);
 	}
-	Chunk(
-		const ChunkMetadata& metadata,
-		std::vector<Timestamp>&& deltas,
-		std::vector<double>&& values
-	)
+	Chunk(const ChunkMetadata& metadata, std::shared_ptr<ChunkRows>&& rows, QuantileSketch&& sketch)
 		: m_range(metadata.chunk_range)
 		, m_id(metadata.chunk_id)
 		, m_capacity(metadata.capacity)
+		, m_value_type(metadata.value_type)
+		, m_columns(metadata.columns)
+		, m_resolution(metadata.resolution)
 		, m_row_count(metadata.row_count)
 		, m_is_to_save(false)
-		, m_ts_deltas(std::move(deltas))
-		, m_values(std::move(values))
+		, m_min_value(metadata.min_value)
+		, m_max_value(metadata.max_value)
+		, m_rows(std::move(rows))
+		, m_sketch(std::move(sketch))
 	{
 	}
 
-	std::vector<DataPoint> get_data_in_range(const TimeRange& range) const;
+	// Pins the rows visible now; never waits on writers
+	ChunkSnapshot snapshot() const;
+
+	std::vector<DataPoint> get_data_in_range(
+		const TimeRange& range,
+		const ValuePredicate& predicate = ValuePredicate()
+	) const
+	{
+		return snapshot().get_data_in_range(range, predicate);
+	}
+	void get_latest_in_range(
+		const TimeRange& range,
+		const ValuePredicate& predicate,
+		size_t limit,
+		std::vector<DataPoint>& out
+	) const
+	{
+		snapshot().get_latest_in_range(range, predicate, limit, out);
+	}
+	std::pair<size_t, size_t> get_index_range(const TimeRange& range) const
+	{
+		return snapshot().get_index_range(range);
+	}
+	// Safe to call from many writers; late points are inserted in time order, and a full row
+	// buffer grows rather than dropping the point. The value is
+	// converted to the chunk's storage type. In a wide chunk it fills the first column and the
+	// others are NaN. A regular series moves the point down onto its resolution grid, and a
+	// second point in the same slot replaces the first.
 	void append(const DataPoint& point);
+	// Appends one row of a wide chunk; `values` holds one value per column
+	void append_row(Timestamp ts, const double* values);
+
+	bool may_match(const ValuePredicate& predicate) const
+	{
+		return predicate.may_match(m_min_value.load(), m_max_value.load());
+	}
+	// Distribution of every value in the chunk, maintained on append
+	QuantileSketch sketch() const
+	{
+		std::lock_guard<std::mutex> lock(m_sketch_mutex);
+		return m_sketch;
+	}
+	ChunkMetadata metadata() const;
 
 	ChunkId id() const { return m_id; }
 	const TimeRange& get_range() const { return m_range; }
 	bool is_to_save() const { return m_is_to_save; }
 	void set_to_save(bool is_to_save) { m_is_to_save = is_to_save; }
 	size_t size() const { return m_row_count; }
+	// Rows reserved; grows as the chunk fills
 	size_t capacity() const { return m_capacity; }
-	bool is_full() const { return m_ts_deltas.size() >= m_capacity; }
+	ValueType value_type() const { return m_value_type; }
+	size_t columns() const { return m_columns; }
+	TimeDelta resolution() const { return m_resolution; }
+	// Whether the next point grows the row buffer. A regular series has a row for every slot.
+	bool is_full() const { return m_resolution == 0 && m_row_count >= m_capacity; }
 	void mark_to_save() { m_is_to_save = true; }
 	void unmark_to_save() { m_is_to_save = false; }
 
   private:
 	const TimeRange m_range;
 	const ChunkId m_id;
-	const size_t m_capacity;
-	size_t m_row_count;
-	bool m_is_to_save;
+	std::atomic<size_t> m_capacity; // Only changed by writers holding m_append_mutex
+	const ValueType m_value_type;
+	const size_t m_columns;
+	const TimeDelta m_resolution; // 0 unless a regular series
+	std::atomic<size_t> m_row_count; // Points held
+	std::atomic<bool> m_is_to_save;
+	// Bounds (and the sketch) cover the first column only. They only widen, and are updated
+	// before the rows they cover are published
+	std::atomic<double> m_min_value;
+	std::atomic<double> m_max_value;
 
-	std::vector<Timestamp> m_ts_deltas;
-	std::vector<double> m_values;
+	// Replaced only by writers holding m_append_mutex. m_rows_mutex guards just the pointer
+	// copy, never a scan or an append.
+	std::shared_ptr<ChunkRows> m_rows;
+	mutable std::mutex m_rows_mutex;
+	// Serialises writers; readers never take it
+	std::mutex m_append_mutex;
+	QuantileSketch m_sketch;
+	mutable std::mutex m_sketch_mutex;
 	friend class ChunkFile;
 };
-
@@ -3,44 +3,72 @@
 #include "utils.h"
 
 #include "chunkfilemetadata.h"
+#include "sketch.h"
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 class Chunk;
+class ChunkSnapshot;
+struct ChunkRows;
 
 class ChunkFile
 {
   public:
-	ChunkFile(
-		const std::string& base_path,
-		ChunkId chunk_id,
-		TimeRange chunk_range,
-		size_t row_count,
-		size_t capacity
-	)
-		: m_chunk_path(generate_filepath(base_path, chunk_id))
-		, m_metadata(ChunkMetadata{ chunk_id, chunk_range, row_count, capacity })
+	ChunkFile(const std::string& base_path, const ChunkMetadata& metadata)
+		: m_chunk_path(generate_filepath(base_path, metadata.chunk_id))
+		, m_sketch_path(generate_sketch_filepath(base_path, metadata.chunk_id))
+		, m_metadata(metadata)
 	{
 	}
 	void save(const Chunk& chunk) const;
-	std::unique_ptr<Chunk> load() const;
+	// Writes every chunk and its sketch with one batch of asynchronous writes (see aio.h)
+	static void save_batch(const std::vector<std::pair<const ChunkFile*, const Chunk*>>& files);
+	// Reports the number of bytes read through `bytes_read` when given
+	std::unique_ptr<Chunk> load(size_t* bytes_read = nullptr) const;
+	// Reads the files with one batch of asynchronous reads, then decodes them in order.
+	// `bytes_read` receives the total over all chunk files.
+	static std::vector<std::unique_ptr<Chunk>> load_batch(
+		const std::vector<const ChunkFile*>& files,
+		size_t* bytes_read = nullptr
+	);
+	// Reads only the given value columns, in the given order, into an uncached snapshot. Its
+	// bounds are the chunk's, which describe stored column 0.
+	ChunkSnapshot load_columns(const std::vector<size_t>& columns, size_t* bytes_read = nullptr) const;
+	QuantileSketch load_sketch() const;
 	const ChunkMetadata& get_metadata() const { return m_metadata; }
 
   private:
 	std::string m_chunk_path;
+	std::string m_sketch_path;
 	const ChunkMetadata m_metadata;
 
 	static std::string generate_filepath(const std::string& base_dir, const int64_t chunk_id)
 	{
 		return base_dir + "/chunk_" + std::to_string(chunk_id) + ".bin";
 	}
+	static std::string generate_sketch_filepath(const std::string& base_dir, const int64_t chunk_id)
+	{
+		return base_dir + "/chunk_" + std::to_string(chunk_id) + ".sketch";
+	}
 
-	static void write_metadata(std::ofstream& file, const Chunk& chunk);
-	static ChunkMetadata read_metadata(std::ifstream& file);
-	static void write_deltas(std::ofstream& file, const std::vector<Timestamp>& deltas);
-	static std::vector<Timestamp> read_deltas(std::ifstream& file);
-	static void write_values(std::ofstream& file, const std::vector<double>& values);
-
-	static std::vector<double> read_values(std::ifstream& file);
+	// Writers append to an in-memory file image. Readers take a source of the file's bytes,
+	// either a loaded buffer or an open stream (see chunk.cpp).
+	static void write_metadata(std::vector<char>& out, const ChunkMetadata& metadata);
+	template <typename Source>
+	static ChunkMetadata read_metadata(Source& source);
+	static void write_deltas(std::vector<char>& out, const Timestamp* deltas, size_t num_deltas);
+	// Written in place of the deltas for a regular series
+	static void write_presence(std::vector<char>& out, const ChunkSnapshot& snapshot);
+	// Values are written with their storage type's codec (see column.h)
+	static void write_values(std::vector<char>& out, const ChunkSnapshot& snapshot);
+	// Reads every stored column, or with `projection` only those columns in that order
+	template <typename Source>
+	static std::shared_ptr<ChunkRows> read_rows(
+		Source& source,
+		const ChunkMetadata& metadata,
+		const std::vector<size_t>* projection = nullptr,
+		size_t* bytes_skipped = nullptr
+	);
 };
@@ -1,7 +1,14 @@
 #pragma once
 
+#include "column.h"
 #include "utils.h"
 #include <cstddef>
+#include <cstdint>
+
+// Chunk files start with the magic and format version, then the metadata below as raw bytes.
+// The version changes with the metadata layout or the data that follows it.
+constexpr uint32_t CHUNK_FILE_MAGIC{ 0x4b484354 }; // "TCHK"
+constexpr uint32_t CHUNK_FILE_VERSION{ 1 };
 
 struct ChunkMetadata
 {
@@ -9,4 +16,19 @@ struct ChunkMetadata
 	TimeRange chunk_range;
 	size_t row_count;
 	size_t capacity;
+	// Value bounds of the first column excluding NaNs (min > max when the chunk holds no comparable values),
+	// used to skip chunks that cannot satisfy a value predicate without loading them
+	double min_value;
+	double max_value;
+	ValueType value_type;
+	size_t columns; // Value columns stored per row
+	// Sample interval of a regular series, which stores a presence bitmap instead of
+	// timestamps; 0 for chunks that store them
+	TimeDelta resolution;
+	// First and last point of the first column (first_ts > last_ts when the chunk holds none),
+	// so gap filling can bridge to a neighbouring chunk without loading it
+	Timestamp first_ts{ TIMESTAMP_MAX };
+	double first_value{ 0 };
+	Timestamp last_ts{ TIMESTAMP_MIN };
+	double last_value{ 0 };
 };
@@ -78,7 +78,10 @@ class CreateTableCommand : public Command
   public:
 	std::string get_name() const override { return "create_table"; }
 	std::string get_description() const override { return "Create a new table"; }
-	std::string get_usage() const override { return "create_table <name>"; }
+	std::string get_usage() const override
+	{
+		return "create_table <name> [float64|float32|int64|bool] [regular]";
+	}
 
 	void execute(CLIState& state, const std::vector<std::string>& args) override;
 };
@@ -116,6 +119,34 @@ class InsertFromCSVCommand : public Command
 	void execute(CLIState& state, const std::vector<std::string>& args) override;
 };
 
+// Export Command
+class ExportCommand : public Command
+{
+  public:
+	std::string get_name() const override { return "export"; }
+	std::string get_description() const override
+	{
+		return "Write a time range of a table to a binary bulk file";
+	}
+	std::string get_usage() const override
+	{
+		return "export <table> <start_ts> <end_ts> <filename> [compress]";
+	}
+
+	void execute(CLIState& state, const std::vector<std::string>& args) override;
+};
+
+// Import Command
+class ImportCommand : public Command
+{
+  public:
+	std::string get_name() const override { return "import"; }
+	std::string get_description() const override { return "Load a binary bulk file into a table"; }
+	std::string get_usage() const override { return "import <table> <filename>"; }
+
+	void execute(CLIState& state, const std::vector<std::string>& args) override;
+};
+
 // Query Command
 class QueryCommand : public Command
 {
@@ -127,6 +158,73 @@ class QueryCommand : public Command
 	void execute(CLIState& state, const std::vector<std::string>& args) override;
 };
 
+// Latest Command
+class LatestCommand : public Command
+{
+  public:
+	std::string get_name() const override { return "latest"; }
+	std::string get_description() const override { return "Show the most recent data points"; }
+	std::string get_usage() const override { return "latest <table> [count]"; }
+
+	void execute(CLIState& state, const std::vector<std::string>& args) override;
+};
+
+// Quantile Command
+class QuantileCommand : public Command
+{
+  public:
+	std::string get_name() const override { return "quantile"; }
+	std::string get_description() const override
+	{
+		return "Approximate value quantiles within a time range";
+	}
+	std::string get_usage() const override { return "quantile <table> <start_ts> <end_ts> <q>..."; }
+
+	void execute(CLIState& state, const std::vector<std::string>& args) override;
+};
+
+// Explain Command
+class ExplainCommand : public Command
+{
+  public:
+	std::string get_name() const override { return "explain"; }
+	std::string get_description() const override
+	{
+		return "Run a query and show where its time went";
+	}
+	std::string get_usage() const override { return "explain <table> <start_ts> <end_ts>"; }
+
+	void execute(CLIState& state, const std::vector<std::string>& args) override;
+};
+
+// Metrics Command
+class MetricsCommand : public Command
+{
+  public:
+	std::string get_name() const override { return "metrics"; }
+	std::string get_description() const override
+	{
+		return "Show cumulative cache and latency metrics of a table";
+	}
+	std::string get_usage() const override { return "metrics <table>"; }
+
+	void execute(CLIState& state, const std::vector<std::string>& args) override;
+};
+
+// Trace Dump Command
+class TraceDumpCommand : public Command
+{
+  public:
+	std::string get_name() const override { return "trace_dump"; }
+	std::string get_description() const override
+	{
+		return "Write recorded trace spans as Chrome trace_event JSON";
+	}
+	std::string get_usage() const override { return "trace_dump <filename>.json"; }
+
+	void execute(CLIState& state, const std::vector<std::string>& args) override;
+};
+
 // CLI
 class CLI
 {
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "datapoint.h"
+#include "db.h"
+#include "protocol.h"
+#include "query.h"
+#include "table.h"
+#include "utils.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Blocking client for Server. Throws std::runtime_error on I/O failure or when the server
+// reports an error for a request.
+class Client
+{
+  public:
+	static Client tcp(const std::string& host, uint16_t port);
+	static Client unix_socket(const std::string& path);
+
+	~Client();
+	Client(Client&& other) noexcept;
+	Client& operator=(Client&& other) noexcept;
+	Client(const Client&) = delete;
+	Client& operator=(const Client&) = delete;
+
+	void create_table(const std::string& name, const Table::Config& config);
+	std::vector<std::string> table_names();
+	void insert(const std::string& table_name, const std::vector<DataPoint>& points);
+	std::vector<DataPoint> query(const std::string& table_name, const Query& query);
+	std::vector<double> quantiles(
+		const std::string& table_name,
+		const TimeRange& range,
+		const std::vector<double>& qs
+	);
+	// Sends every query before reading any response; results align with `queries`
+	std::vector<std::vector<DataPoint>> query_pipelined(const std::vector<TableQuery>& queries);
+
+  private:
+	explicit Client(int fd)
+		: m_fd(fd)
+		, m_next_request_id(0)
+	{
+	}
+
+	int m_fd;
+	uint32_t m_next_request_id;
+	std::vector<char> m_out;
+
+	// Starts a request frame in m_out and returns its frame offset
+	size_t begin_request(protocol::Opcode opcode);
+	void send_all();
+	// Reads one response frame, whatever its status
+	protocol::FrameHeader receive(std::vector<char>& payload);
+	// Sends the pending request and returns its response payload
+	std::vector<char> round_trip();
+	void read_exact(char* data, size_t size);
+	// Reads and drops `size` bytes
+	void skip(size_t size);
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "utils.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Lossless column codecs. Timestamps are stored as zigzag varint delta-of-deltas, so a regular
+// series costs about one byte per point. Values are XORed with their predecessor and only the
+// bytes that differ are kept: a repeat costs one byte, small integers a few, and noisy values
+// at most nine. Integer columns are a base value plus zigzag deltas bit-packed at the widest
+// delta's width, and boolean columns a bitmap.
+namespace codec
+{
+// Appends the encoding of `count` items to `out`
+void encode_timestamps(const Timestamp* timestamps, size_t count, std::vector<char>& out);
+void encode_values(const double* values, size_t count, std::vector<char>& out);
+
+// Decode `count` items into `out` and return the bytes consumed; throw on truncated input
+size_t decode_timestamps(const char* data, size_t size, size_t count, Timestamp* out);
+size_t decode_values(const char* data, size_t size, size_t count, double* out);
+
+void encode_integers(const int64_t* values, size_t count, std::vector<char>& out);
+size_t decode_integers(const char* data, size_t size, size_t count, int64_t* out);
+void encode_bitmap(const bool* values, size_t count, std::vector<char>& out);
+size_t decode_bitmap(const char* data, size_t size, size_t count, bool* out);
+} // namespace codec
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "codec.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Storage type of a table's values. Queries always see doubles; the narrower types hold
+// integer counters, flags and single precision sensor data in less memory and on disk.
+enum class ValueType : uint8_t
+{
+	Float64,
+	Float32,
+	Int64,
+	Bool
+};
+
+// Conversion between the query-facing double and a column's storage type. store() is lossy
+// for values the type cannot represent: Int64 rounds and saturates (NaN becomes 0), Bool
+// keeps whether the value is non-zero.
+template <typename T>
+struct ValueTraits;
+
+template <>
+struct ValueTraits<double>
+{
+	static constexpr ValueType type = ValueType::Float64;
+	static double store(double value) { return value; }
+	static double load(double value) { return value; }
+};
+
+template <>
+struct ValueTraits<float>
+{
+	static constexpr ValueType type = ValueType::Float32;
+	static float store(double value)
+	{
+		// Out of range doubles become infinities rather than undefined conversions
+		if (std::abs(value) > std::numeric_limits<float>::max() && std::isfinite(value))
+			return value > 0 ? std::numeric_limits<float>::infinity() : -std::numeric_limits<float>::infinity();
+		return static_cast<float>(value);
+	}
+	static double load(float value) { return value; }
+};
+
+template <>
+struct ValueTraits<int64_t>
+{
+	static constexpr ValueType type = ValueType::Int64;
+	static int64_t store(double value)
+	{
+		if (std::isnan(value))
+			return 0;
+		// 2^63 is the first double past the int64 range
+		if (value >= 9223372036854775808.0)
+			return std::numeric_limits<int64_t>::max();
+		if (value < -9223372036854775808.0)
+			return std::numeric_limits<int64_t>::min();
+		return static_cast<int64_t>(std::llround(value));
+	}
+	static double load(int64_t value) { return static_cast<double>(value); }
+};
+
+template <>
+struct ValueTraits<bool>
+{
+	static constexpr ValueType type = ValueType::Bool;
+	static bool store(double value) { return value != 0.0 && !std::isnan(value); }
+	static double load(bool value) { return value ? 1.0 : 0.0; }
+};
+
+// Column codec, chosen at compile time from the storage type. Floating point columns are
+// stored raw so chunk loads stay a single read.
+template <typename T>
+struct ValueCodec
+{
+	static constexpr bool raw = true;
+	static void encode(const T* values, size_t count, std::vector<char>& out)
+	{
+		const char* bytes = reinterpret_cast<const char*>(values);
+		out.insert(out.end(), bytes, bytes + count * sizeof(T));
+	}
+	static size_t decode(const char* data, size_t size, size_t count, T* out)
+	{
+		if (size < count * sizeof(T))
+		{
+			throw std::runtime_error("Truncated value column");
+		}
+		std::memcpy(out, data, count * sizeof(T));
+		return count * sizeof(T);
+	}
+};
+
+template <>
+struct ValueCodec<int64_t>
+{
+	static constexpr bool raw = false;
+	static void encode(const int64_t* values, size_t count, std::vector<char>& out)
+	{
+		codec::encode_integers(values, count, out);
+	}
+	static size_t decode(const char* data, size_t size, size_t count, int64_t* out)
+	{
+		return codec::decode_integers(data, size, count, out);
+	}
+};
+
+template <>
+struct ValueCodec<bool>
+{
+	static constexpr bool raw = false;
+	static void encode(const bool* values, size_t count, std::vector<char>& out)
+	{
+		codec::encode_bitmap(values, count, out);
+	}
+	static size_t decode(const char* data, size_t size, size_t count, bool* out)
+	{
+		return codec::decode_bitmap(data, size, count, out);
+	}
+};
+
+// Calls `visit` with std::type_identity of the storage type for `type`, so generic code is
+// instantiated once per type and dispatched once per column rather than per value
+template <typename Visitor>
+decltype(auto) visit_value_type(ValueType type, Visitor&& visit)
+{
+	switch (type)
+	{
+	case ValueType::Float32:
+		return visit(std::type_identity<float>{});
+	case ValueType::Int64:
+		return visit(std::type_identity<int64_t>{});
+	case ValueType::Bool:
+		return visit(std::type_identity<bool>{});
+	default:
+		return visit(std::type_identity<double>{});
+	}
+}
+
+inline size_t value_size(ValueType type)
+{
+	return visit_value_type(type, []<typename T>(std::type_identity<T>) { return sizeof(T); });
+}
+
+inline const char* value_type_name(ValueType type)
+{
+	switch (type)
+	{
+	case ValueType::Float32:
+		return "float32";
+	case ValueType::Int64:
+		return "int64";
+	case ValueType::Bool:
+		return "bool";
+	default:
+		return "float64";
+	}
+}
+
+inline ValueType parse_value_type(const std::string& name)
+{
+	for (auto type : { ValueType::Float64, ValueType::Float32, ValueType::Int64, ValueType::Bool })
+	{
+		if (name == value_type_name(type))
+			return type;
+	}
+	throw std::invalid_argument("Unknown value type: " + name);
+}
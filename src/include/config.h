@@ -10,4 +10,32 @@ constexpr size_t MAX_CHUNKS_TO_SAVE{ 2 };
 constexpr TimeDelta FLUSH_INTERVAL_SECS{ 60 };
 constexpr TimeDelta CHUNK_INTERVAL_SECS{ 3600 };
 constexpr TimeDelta MIN_DATA_RESOLUTION_SECS{ 300 };
+constexpr size_t CHUNK_MIN_CAPACITY{ 64 };		  // Smallest row buffer of a chunk sized from the ingest rate
+constexpr double CHUNK_CAPACITY_HEADROOM{ 1.25 }; // Rows reserved over the expected count
+constexpr size_t CHUNK_GROWTH_FACTOR{ 2 };		  // Row buffer growth when a chunk fills
+constexpr int CHUNK_WIDTH_MAX_SHIFT{ 4 }; // Adaptive chunks span chunk_size_secs times 2^-4 to 2^4
+constexpr size_t QUERY_THREADS{ 6 }; // Chunk loader threads per table
+constexpr size_t QUERY_LOAD_BATCH_CHUNKS{ 4 }; // Cache misses read per batch by a query
+constexpr size_t SCAN_MORSEL_ROWS{ 1 << 14 };  // Rows per parallel scan task of a large chunk
+constexpr size_t CURSOR_PREFETCH_CHUNKS{ 8 };  // Chunks a streaming cursor loads ahead of its reader
+constexpr size_t FILL_MAX_POINTS{ 1 << 22 };   // Largest grid a gap-filled query may return
+constexpr size_t DOWNSAMPLE_MAX_POINTS{ 1 << 22 }; // Largest target of a downsampled query
+constexpr size_t RESULT_CACHE_POINTS{ 1 << 20 }; // Matches kept per table for repeated queries
+constexpr size_t RESULT_CACHE_SEEN_KEYS{ 1 << 12 }; // Recent query shapes remembered before caching
+constexpr double SKETCH_RELATIVE_ACCURACY{ 0.01 }; // Quantile error bound of chunk sketches
+constexpr size_t SKETCH_MAX_BINS{ 2048 };	 // Bins per sign of a sketch; the lowest collapse beyond it
+constexpr size_t TRACE_BUFFER_EVENTS{ 1 << 16 };	// Trace spans kept per thread
+constexpr size_t REVERSE_SCAN_PAGE_SIZE{ 16 }; // Chunk files copied out of the index per lock
+constexpr size_t SERVER_WORKER_THREADS{ 8 };
+constexpr size_t SERVER_MAX_PIPELINE{ 128 }; // Requests in flight per connection before reads pause
+constexpr size_t INGEST_BATCH_POINTS{ 100000 };	   // Points per insert in streaming ingest
+constexpr size_t INGEST_BLOCK_BYTES{ 1 << 20 };	   // Read and parse granularity of streaming ingest
+constexpr double INGEST_MAX_BATCH_DELAY_SECS{ 1.0 };
+constexpr double INGEST_REPORT_SECS{ 5.0 };
+constexpr size_t BULK_BLOCK_POINTS{ 1 << 16 };	   // Points per block of a bulk export
+constexpr size_t BULK_IO_BUFFER_BYTES{ 1 << 20 }; // Stream buffer for export/import files
+constexpr unsigned AIO_QUEUE_DEPTH{ 64 };		   // Transfers in flight per io_uring batch
+constexpr size_t AIO_THREADS{ 16 };				   // Workers of the pread/pwrite fallback
+constexpr size_t AIO_POOL_BUFFERS{ 32 };		   // I/O buffers kept for reuse
+constexpr size_t AIO_POOL_BUFFER_BYTES{ 16 << 20 }; // Larger buffers are not kept
 } // namespace Config
\ No newline at end of file
@@ -1,6 +1,8 @@
 #pragma once
 #include <filesystem>
+#include <functional>
 #include <memory>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -9,6 +11,13 @@
 #include "query.h"
 #include "table.h"
 
+// A query against a named table, for batched execution
+struct TableQuery
+{
+	std::string table_name;
+	Query query;
+};
+
 class DataBase
 {
   public:
@@ -18,12 +27,53 @@ class DataBase
 	{
 		std::filesystem::create_directories(filepath);
 	}
+	// Throws std::runtime_error when a table of that name exists
 	void create_table(const std::string& name, Table::Config&);
 	const std::vector<std::string> get_table_names() const;
-	const Table* get_table(const std::string& table_name) const { return m_tables.at(table_name).get(); }
+	bool has_table(const std::string& table_name) const { return find_table(table_name) != nullptr; }
+	const Table* get_table(const std::string& table_name) const
+	{
+		std::shared_lock<std::shared_mutex> lock(m_tables_mutex);
+		return m_tables.at(table_name).get();
+	}
 
-	std::vector<DataPoint> query(const std::string& table_name, const Query& query);
+	std::vector<DataPoint> query(
+		const std::string& table_name,
+		const Query& query,
+		QueryStats* stats = nullptr
+	);
+	// Results align with `queries`; chunks shared by queries on a table are loaded once
+	std::vector<std::vector<DataPoint>> query_batch(const std::vector<TableQuery>& queries);
+	// Joins two tables' points in time order (see JoinQuery)
+	std::vector<JoinedPoint> join(
+		const std::string& left_table,
+		const std::string& right_table,
+		const JoinQuery& query
+	);
+	std::vector<double> quantiles(
+		const std::string& table_name,
+		const TimeRange& range,
+		const std::vector<double>& qs
+	);
 	void insert(const std::string& table_name, const std::vector<DataPoint>& points);
+	// Wide table access (see Table::insert_rows and Table::query_columns)
+	void insert_rows(
+		const std::string& table_name,
+		const std::vector<Timestamp>& timestamps,
+		const std::vector<std::vector<double>>& columns
+	);
+	ColumnQueryResult query_columns(
+		const std::string& table_name,
+		const Query& query,
+		const std::vector<size_t>& columns,
+		QueryStats* stats = nullptr
+	);
+	// Visits the table's chunks overlapping the range in time order (see Table::scan)
+	void scan(
+		const std::string& table_name,
+		const TimeRange& range,
+		const std::function<void(const ChunkSnapshot&)>& visit
+	);
 	void insert_from_csv(const std::string &table_name, const std::string& file_path);
 	std::vector<DataPoint> load_data_from_csv(const std::string& filename);
 	
@@ -31,6 +81,10 @@ class DataBase
 	std::string m_name;
 	std::string m_dbpath;
 	std::unordered_map<std::string, std::unique_ptr<Table>> m_tables;
+	// Guards the map itself; each Table synchronises its own reads and writes
+	mutable std::shared_mutex m_tables_mutex;
+
+	Table* find_table(const std::string& table_name) const;
 	
 	std::string create_table_path(const std::string& table_name)
 	{
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "datapoint.h"
+#include "executor.h"
+#include "predicate.h"
+#include "utils.h"
+
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+class ChunkSnapshot;
+
+namespace downsample
+{
+// Equal width time buckets over [start, start + width * count)
+struct Buckets
+{
+	Timestamp start;
+	double width;
+	size_t count;
+
+	size_t index_of(Timestamp ts) const;
+};
+
+// Both downsamplers are fed the chunks in time order, one at a time, and keep state bounded
+// by the target size. Buckets are laid over `extent`, which must contain every point fed.
+// Bucket partials of a chunk are computed in parallel over morsels of SCAN_MORSEL_ROWS rows
+// and stitched where a bucket spans a morsel boundary. Until the target is exceeded the points
+// themselves are kept, so a range holding fewer points comes back unchanged.
+
+// Up to two points, the minimum and maximum, per bucket of target_points / 2
+class MinMax
+{
+  public:
+	// Throws std::invalid_argument when target_points < 2
+	MinMax(
+		const TimeRange& extent,
+		const ValuePredicate& predicate,
+		size_t target_points,
+		WorkStealingExecutor& executor
+	);
+
+	void add(const ChunkSnapshot& chunk, const TimeRange& range);
+	std::vector<DataPoint> finish();
+
+  private:
+	struct Bucket
+	{
+		size_t bucket;
+		DataPoint min;
+		DataPoint max;
+	};
+
+	const ValuePredicate m_predicate;
+	const size_t m_target_points;
+	WorkStealingExecutor& m_executor;
+	Buckets m_buckets;
+	std::vector<std::optional<Bucket>> m_merged;
+	std::optional<std::vector<DataPoint>> m_points;
+};
+
+// Largest triangle three buckets: keeps the first and last points and, from each of
+// target_points - 2 buckets, the point forming the largest triangle with the previously kept
+// point and the next bucket's average. Takes two passes over the chunks: add() for the bucket
+// averages, then select() when selection_needed().
+class Lttb
+{
+  public:
+	// Throws std::invalid_argument when target_points < 3
+	Lttb(
+		const TimeRange& extent,
+		const ValuePredicate& predicate,
+		size_t target_points,
+		WorkStealingExecutor& executor
+	);
+
+	void add(const ChunkSnapshot& chunk, const TimeRange& range);
+	bool selection_needed() const;
+	void select(const ChunkSnapshot& chunk, const TimeRange& range);
+	std::vector<DataPoint> finish();
+
+  private:
+	struct Sum
+	{
+		size_t bucket;
+		double ts_sum;
+		double value_sum;
+		size_t count;
+	};
+
+	bool is_interior(const DataPoint& point) const { return point.ts > m_first->ts && point.ts < m_last->ts; }
+	// Turns the bucket sums into the average of the next non-empty bucket after each bucket
+	void prepare_selection();
+
+	const ValuePredicate m_predicate;
+	const size_t m_target_points;
+	WorkStealingExecutor& m_executor;
+	Buckets m_buckets;
+	std::vector<Sum> m_sums;
+	std::optional<DataPoint> m_first{};
+	std::optional<DataPoint> m_last{};
+	std::optional<std::vector<DataPoint>> m_points;
+
+	// Selection state
+	std::vector<std::pair<double, double>> m_next_average{};
+	std::vector<DataPoint> m_results{};
+	DataPoint m_anchor{};
+	size_t m_current{ std::numeric_limits<size_t>::max() };
+	DataPoint m_best{};
+	double m_best_area{ -1 };
+};
+} // namespace downsample
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Thread pool with a task deque per worker. A worker runs its own newest task first and, when
+// out of work, steals the oldest task of another, so a long scan on one worker never holds up
+// the short ones queued behind it.
+class WorkStealingExecutor
+{
+  public:
+	explicit WorkStealingExecutor(size_t threads);
+	~WorkStealingExecutor();
+
+	WorkStealingExecutor(const WorkStealingExecutor&) = delete;
+	WorkStealingExecutor& operator=(const WorkStealingExecutor&) = delete;
+
+	size_t size() const { return m_workers.size(); }
+
+	// Tasks submitted from a worker go on its own deque, others are spread over the workers
+	void submit(std::function<void()> task);
+
+	template <typename F>
+	auto enqueue(F task) -> std::future<std::invoke_result_t<F>>
+	{
+		using Result = std::invoke_result_t<F>;
+		auto packaged = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+		auto future = packaged->get_future();
+		submit([packaged]() { (*packaged)(); });
+		return future;
+	}
+
+	// Runs body(i) for every i in [0, count) and returns once all are done. The calling thread
+	// runs queued tasks while it waits, so this may be called from inside a task. Rethrows the
+	// first exception thrown by a body.
+	template <typename F>
+	void parallel_for(size_t count, F body);
+
+  private:
+	struct Worker
+	{
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+	};
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	std::vector<std::jthread> m_threads;
+	std::atomic<size_t> m_next_worker{ 0 };
+	// Queued tasks; raised under m_sleep_mutex so a worker going to sleep never misses one
+	std::atomic<size_t> m_queued{ 0 };
+	std::mutex m_sleep_mutex;
+	std::condition_variable m_wake;
+	bool m_stopping{ false };
+
+	void run_worker(size_t index);
+	// Pops a task of this thread's own deque, else steals one. Returns false if none was found.
+	bool run_one();
+};
+
+template <typename F>
+void WorkStealingExecutor::parallel_for(size_t count, F body)
+{
+	if (count == 0)
+		return;
+	if (count == 1) {
+		body(size_t{ 0 });
+		return;
+	}
+
+	// Shared with the tasks, which may still be notifying after the caller returns
+	struct Group
+	{
+		std::atomic<size_t> remaining;
+		std::mutex error_mutex;
+		std::exception_ptr error;
+	};
+	auto group = std::make_shared<Group>();
+	group->remaining = count;
+	// The last index runs on the calling thread straight away
+	for (size_t i{ 0 }; i + 1 < count; i++) {
+		submit([group, &body, i]() {
+			try {
+				body(i);
+			} catch (...) {
+				std::lock_guard<std::mutex> lock(group->error_mutex);
+				group->error = group->error ? group->error : std::current_exception();
+			}
+			if (group->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				group->remaining.notify_all();
+		});
+	}
+	try {
+		body(count - 1);
+	} catch (...) {
+		std::lock_guard<std::mutex> lock(group->error_mutex);
+		group->error = group->error ? group->error : std::current_exception();
+	}
+	group->remaining.fetch_sub(1, std::memory_order_acq_rel);
+
+	// Help with queued work rather than sleeping while this group's tasks are waiting
+	for (size_t left = group->remaining.load(std::memory_order_acquire); left > 0;
+		 left = group->remaining.load(std::memory_order_acquire)) {
+		if (!run_one())
+			group->remaining.wait(left, std::memory_order_acquire);
+	}
+	if (group->error)
+		std::rethrow_exception(group->error);
+}
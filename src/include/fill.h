@@ -0,0 +1,55 @@
+#pragma once
+
+#include "datapoint.h"
+#include "predicate.h"
+#include "query.h"
+#include "utils.h"
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+class ChunkSnapshot;
+
+namespace fill
+{
+// Gap-filled grid over chunks fed in time order. Grid points are settled as the points after
+// them arrive, so only the chunk being read needs to be held.
+class Grid
+{
+  public:
+	// `before` is the nearest matching point before the range, from outside the chunks fed.
+	// Throws std::invalid_argument unless 0 < step <= TIMESTAMP_MAX, or when the range holds
+	// more than FILL_MAX_POINTS grid points.
+	Grid(
+		const TimeRange& range,
+		const ValuePredicate& predicate,
+		FillStrategy strategy,
+		TimeDelta step,
+		const std::optional<DataPoint>& before
+	);
+
+	// Feeds the chunk's points in the range, and its matching points either side of it
+	void add(const ChunkSnapshot& chunk);
+	// Whether the chunks fed held a matching point after the range
+	bool has_after() const { return m_after.has_value(); }
+	// The grid, with `after` standing in for the first point after the range when the chunks
+	// fed held none
+	std::vector<DataPoint> finish(const std::optional<DataPoint>& after = std::nullopt);
+
+  private:
+	// Emits the grid points before `next`, as no later point can land in their step
+	void emit_before(const std::optional<DataPoint>& next, Timestamp end_ts);
+	double value_at(Timestamp ts, const std::optional<DataPoint>& next) const;
+
+	const TimeRange m_range;
+	const ValuePredicate m_predicate;
+	const FillStrategy m_strategy;
+	const TimeDelta m_step;
+	std::optional<Timestamp> m_grid{}; // Next grid point; set at the first point of an open range
+	std::optional<Timestamp> m_last_ts{}; // Newest point in the range, which ends an open range
+	std::optional<DataPoint> m_previous;
+	std::optional<DataPoint> m_after{};
+	std::vector<DataPoint> m_results{};
+};
+} // namespace fill
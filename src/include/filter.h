@@ -0,0 +1,19 @@
+#pragma once
+
+#include "predicate.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace filter
+{
+// Writes the indices in [begin, end) whose value satisfies the predicate to `out`
+// (which must hold at least end - begin entries) and returns how many were written.
+size_t select(
+	const double* values,
+	uint32_t begin,
+	uint32_t end,
+	const ValuePredicate& predicate,
+	uint32_t* out
+);
+} // namespace filter
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "config.h"
+#include "datapoint.h"
+#include "db.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+struct IngestOptions
+{
+	size_t batch_points{ Config::INGEST_BATCH_POINTS };
+	size_t block_bytes{ Config::INGEST_BLOCK_BYTES };
+	// A partial batch is inserted once input has been idle this long; 0 waits for a full batch
+	double max_batch_delay_secs{ Config::INGEST_MAX_BATCH_DELAY_SECS };
+	double report_interval_secs{ Config::INGEST_REPORT_SECS }; // 0 disables progress reports
+};
+
+struct IngestStats
+{
+	uint64_t bytes{ 0 };
+	uint64_t points{ 0 };
+	uint64_t rejected{ 0 }; // Lines that were not "<timestamp> <value>", including headers
+	uint64_t batches{ 0 };
+	double seconds{ 0 };
+};
+
+// Parses one "<timestamp> <value>" line; the separator is a comma, spaces or tabs, so CSV rows
+// and the line protocol share a parser. Returns false for malformed lines.
+bool parse_point_line(std::string_view line, DataPoint& point);
+
+// Reads `fd` (a pipe, FIFO or file) to end of input, inserting points into `table_name` in
+// batches. Input is read in fixed blocks and parsed in place, so memory stays bounded by one
+// block plus one batch however long the stream runs. Lines longer than a block are rejected.
+// Progress goes to `progress` every report interval when it is not null.
+IngestStats ingest_stream(
+	DataBase& db,
+	const std::string& table_name,
+	int fd,
+	const IngestOptions& options = IngestOptions(),
+	std::ostream* progress = nullptr
+);
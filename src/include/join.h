@@ -0,0 +1,16 @@
+#pragma once
+
+#include "query.h"
+
+#include <vector>
+
+class Table;
+
+namespace join
+{
+// Merges the two tables' points in one linear pass as their chunks arrive in time order.
+// Both tables start loading their chunks before the merge begins, so the loads overlap, and
+// neither side's points are materialised beyond the morsel being merged. Throws
+// std::invalid_argument for a bucket join without a positive width.
+std::vector<JoinedPoint> run(Table& left, Table& right, const JoinQuery& query);
+} // namespace join
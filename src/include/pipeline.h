@@ -0,0 +1,208 @@
+#pragma once
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+// Coroutine building blocks for query execution. A query runs as a chain of stages that
+// suspend while chunks load and resume on the thread that finished the load, so a waiting
+// query holds no thread and the table's pool is shared by every query in flight.
+namespace pipeline
+{
+// A lazily started coroutine producing a T. Awaiting it starts it; the awaiter resumes on
+// whichever thread completes it.
+template <typename T>
+class Task
+{
+  public:
+	struct promise_type
+	{
+		std::optional<T> value;
+		std::exception_ptr error;
+		std::coroutine_handle<> continuation;
+
+		Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		auto final_suspend() noexcept
+		{
+			struct Resume
+			{
+				bool await_ready() noexcept { return false; }
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+				{
+					auto continuation = handle.promise().continuation;
+					return continuation ? continuation : std::noop_coroutine();
+				}
+				void await_resume() noexcept {}
+			};
+			return Resume{};
+		}
+		void return_value(T result) { value.emplace(std::move(result)); }
+		void unhandled_exception() { error = std::current_exception(); }
+	};
+
+	Task(Task&& other) noexcept
+		: m_handle(std::exchange(other.m_handle, {}))
+	{
+	}
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+	~Task()
+	{
+		if (m_handle)
+			m_handle.destroy();
+	}
+
+	auto operator co_await() && noexcept
+	{
+		struct Awaiter
+		{
+			std::coroutine_handle<promise_type> handle;
+			bool await_ready() noexcept { return false; }
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+			{
+				handle.promise().continuation = awaiting;
+				return handle;
+			}
+			T await_resume()
+			{
+				if (handle.promise().error)
+					std::rethrow_exception(handle.promise().error);
+				return std::move(*handle.promise().value);
+			}
+		};
+		return Awaiter{ m_handle };
+	}
+
+  private:
+	explicit Task(std::coroutine_handle<promise_type> handle)
+		: m_handle(handle)
+	{
+	}
+	std::coroutine_handle<promise_type> m_handle;
+};
+
+// Items handed from producers on any thread to one consuming coroutine. `co_await next()`
+// completes at once when an item is queued, otherwise the consumer suspends and the next
+// push resumes it on the pushing thread.
+template <typename T>
+class Channel
+{
+  public:
+	void push(T item)
+	{
+		std::coroutine_handle<> waiter{};
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_items.push_back(std::move(item));
+			std::swap(waiter, m_waiter);
+		}
+		if (waiter)
+			waiter.resume();
+	}
+
+	auto next()
+	{
+		struct Awaiter
+		{
+			Channel& channel;
+			bool await_ready() noexcept { return false; }
+			bool await_suspend(std::coroutine_handle<> handle)
+			{
+				std::lock_guard<std::mutex> lock(channel.m_mutex);
+				if (!channel.m_items.empty())
+					return false;
+				channel.m_waiter = handle;
+				return true;
+			}
+			T await_resume()
+			{
+				std::lock_guard<std::mutex> lock(channel.m_mutex);
+				T item = std::move(channel.m_items.front());
+				channel.m_items.pop_front();
+				return item;
+			}
+		};
+		return Awaiter{ *this };
+	}
+
+  private:
+	std::mutex m_mutex;
+	std::deque<T> m_items;
+	std::coroutine_handle<> m_waiter;
+};
+
+namespace detail
+{
+// Signals a waiting thread when the coroutine it wraps completes
+struct Blocker
+{
+	struct promise_type
+	{
+		std::mutex* mutex;
+		std::condition_variable* done;
+		bool* finished;
+
+		Blocker get_return_object() { return Blocker{ std::coroutine_handle<promise_type>::from_promise(*this) }; }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		auto final_suspend() noexcept
+		{
+			struct Signal
+			{
+				bool await_ready() noexcept { return false; }
+				void await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+				{
+					// Notified under the lock, so the waiter cannot return before this is done
+					auto& promise = handle.promise();
+					std::lock_guard<std::mutex> lock(*promise.mutex);
+					*promise.finished = true;
+					promise.done->notify_one();
+				}
+				void await_resume() noexcept {}
+			};
+			return Signal{};
+		}
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+
+	std::coroutine_handle<promise_type> handle;
+	~Blocker() { handle.destroy(); }
+};
+} // namespace detail
+
+// Runs the task on the calling thread until it first suspends, then blocks until it completes
+template <typename T>
+T sync_wait(Task<T> task)
+{
+	std::optional<T> result{};
+	std::exception_ptr error{};
+	auto run = [&]() -> detail::Blocker {
+		try {
+			result.emplace(co_await std::move(task));
+		} catch (...) {
+			error = std::current_exception();
+		}
+	};
+
+	std::mutex mutex;
+	std::condition_variable done;
+	bool finished{ false };
+	detail::Blocker blocker = run();
+	blocker.handle.promise().mutex = &mutex;
+	blocker.handle.promise().done = &done;
+	blocker.handle.promise().finished = &finished;
+	blocker.handle.resume();
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [&] { return finished; });
+	}
+	if (error)
+		std::rethrow_exception(error);
+	return std::move(*result);
+}
+} // namespace pipeline
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cmath>
+
+// Filter applied to point values during a chunk scan
+struct ValuePredicate
+{
+	enum class Op
+	{
+		None,
+		Greater,
+		Less,
+		Between, // Inclusive on both bounds
+		NotNaN
+	};
+
+	ValuePredicate(Op op = Op::None, double lower = 0.0, double upper = 0.0)
+		: m_op(op)
+		, m_lower(lower)
+		, m_upper(upper)
+	{
+	}
+
+	static ValuePredicate greater(double value) { return ValuePredicate(Op::Greater, value); }
+	static ValuePredicate less(double value) { return ValuePredicate(Op::Less, value, value); }
+	static ValuePredicate between(double lower, double upper)
+	{
+		return ValuePredicate(Op::Between, lower, upper);
+	}
+	static ValuePredicate not_nan() { return ValuePredicate(Op::NotNaN); }
+
+	bool is_none() const { return m_op == Op::None; }
+
+	bool matches(double value) const
+	{
+		switch (m_op)
+		{
+		case Op::Greater:
+			return value > m_lower;
+		case Op::Less:
+			return value < m_upper;
+		case Op::Between:
+			return value >= m_lower && value <= m_upper;
+		case Op::NotNaN:
+			return !std::isnan(value);
+		default:
+			return true;
+		}
+	}
+
+	// Whether any value in a chunk with the given (NaN-excluding) bounds can match.
+	// A chunk holding only NaNs has min > max.
+	bool may_match(double min_value, double max_value) const
+	{
+		switch (m_op)
+		{
+		case Op::Greater:
+			return max_value > m_lower;
+		case Op::Less:
+			return min_value < m_upper;
+		case Op::Between:
+			return max_value >= m_lower && min_value <= m_upper;
+		case Op::NotNaN:
+			return min_value <= max_value;
+		default:
+			return true;
+		}
+	}
+
+	Op m_op;
+	double m_lower;
+	double m_upper;
+};
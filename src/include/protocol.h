@@ -0,0 +1,114 @@
+#pragma once
+
+#include "datapoint.h"
+#include "query.h"
+#include "table.h"
+#include "utils.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Binary framing shared by the server and client. A frame is a fixed header followed by
+// `length` payload bytes. Numbers are in host byte order: the protocol is for processes on
+// one host, over loopback TCP or a Unix socket.
+namespace protocol
+{
+enum class Opcode : uint8_t
+{
+	CreateTable = 1,
+	ListTables,
+	Insert,
+	Query,
+	Quantiles
+};
+
+enum class Status : uint8_t
+{
+	Ok = 0,
+	Error // Payload is the error message
+};
+
+struct FrameHeader
+{
+	uint32_t length;	 // Payload bytes after the header
+	uint32_t request_id; // Echoed by the response so pipelined requests can be matched
+	uint8_t code;		 // Opcode in requests, Status in responses
+	uint8_t reserved[3];
+};
+static_assert(sizeof(FrameHeader) == 12);
+
+constexpr uint32_t MAX_PAYLOAD_BYTES{ 64u << 20 };
+// Most points a response payload holds after its count
+constexpr size_t MAX_RESPONSE_POINTS{ (MAX_PAYLOAD_BYTES - sizeof(uint32_t)) / sizeof(DataPoint) };
+
+// Appends a frame to `out`; fields written through a Writer on `out` form its payload until
+// end_frame() patches the length in
+size_t begin_frame(std::vector<char>& out, uint32_t request_id, uint8_t code);
+void end_frame(std::vector<char>& out, size_t frame_offset);
+
+class Writer
+{
+  public:
+	explicit Writer(std::vector<char>& out)
+		: m_out(out)
+	{
+	}
+
+	template <typename T>
+	void put(const T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		const char* bytes = reinterpret_cast<const char*>(&value);
+		m_out.insert(m_out.end(), bytes, bytes + sizeof(T));
+	}
+	void put_string(const std::string& value);
+	void put_points(const std::vector<DataPoint>& points);
+	void put_range(const TimeRange& range);
+	void put_query(const Query& query);
+	void put_config(const Table::Config& config);
+
+  private:
+	std::vector<char>& m_out;
+};
+
+// Reads payload fields in the order they were written; throws on a truncated payload
+class Reader
+{
+  public:
+	Reader(const char* data, size_t size)
+		: m_data(data)
+		, m_size(size)
+		, m_offset(0)
+	{
+	}
+
+	template <typename T>
+	T get()
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		T value;
+		std::memcpy(&value, take(sizeof(T)), sizeof(T));
+		return value;
+	}
+	// A count of elements of `element_bytes` each that must follow, so a bad count is rejected
+	// before anything is allocated for it
+	uint32_t get_count(size_t element_bytes);
+	std::string get_string();
+	std::vector<DataPoint> get_points();
+	TimeRange get_range();
+	Query get_query();
+	Table::Config get_config();
+
+  private:
+	const char* m_data;
+	size_t m_size;
+	size_t m_offset;
+
+	const char* take(size_t bytes);
+};
+} // namespace protocol
@@ -1,19 +1,187 @@
 #pragma once
 
+#include "predicate.h"
 #include "utils.h"
 #include <cstddef>
+#include <vector>
 
 
+enum class DownsampleMethod
+{
+	None,
+	MinMax, // Minimum and maximum point of each time bucket
+	LTTB	// Largest-Triangle-Three-Buckets
+};
+
+enum class WindowFunction
+{
+	None,
+	MovingSum,
+	MovingAvg,
+	MovingMin,
+	MovingMax,
+	Rate,		// Per-second increase of a counter over the window, a drop counting as a reset
+	Derivative, // Per-second change since the previous point
+	CumulativeSum
+};
+
+// A function evaluated at every point over the points before it. Moving functions and rate
+// span the last `points` points or, when `secs` is set, the points less than `secs` seconds
+// older than the current one; rate defaults to the previous point.
+struct WindowSpec
+{
+	WindowFunction function{ WindowFunction::None };
+	size_t points{ 0 };
+	TimeDelta secs{ 0 };
+	TimeDelta step{ 0 }; // When set, only the last result of each step-aligned bucket is kept
+};
+
+// How a gap-filled query values a grid step that holds no point
+enum class FillStrategy
+{
+	None,	  // Not a gap-filled query
+	Null,	  // NaN
+	Previous, // The last value before the step
+	Linear	  // Interpolated between the points either side
+};
+
 struct Query
 {
-	Query(TimeRange range = TimeRange(), bool sorted = false, size_t limit = 0)
+	Query(
+		TimeRange range = TimeRange(),
+		bool sorted = false,
+		size_t limit = 0,
+		ValuePredicate predicate = ValuePredicate()
+	)
 		: m_time_range(range)
 		, m_sorted(sorted)
 		, m_limit(limit)
+		, m_predicate(predicate)
+		, m_newest_first(false)
+		, m_downsample(DownsampleMethod::None)
+		, m_target_points(0)
+		, m_window()
+		, m_fill(FillStrategy::None)
+		, m_fill_step(0)
+	{
+	}
+
+	// Last `count` points in the range, newest first. Served by walking chunks backwards
+	// from the head chunk and stopping once enough points are found.
+	static Query latest(
+		size_t count = 1,
+		TimeRange range = TimeRange(),
+		ValuePredicate predicate = ValuePredicate()
+	)
+	{
+		Query q(range, true, count, predicate);
+		q.m_newest_first = true;
+		return q;
+	}
+
+	// At most `target_points` points, in time order, that preserve the visual shape of the
+	// series in the range. Downsampling happens inside the engine over the chunk columns.
+	static Query downsampled(
+		TimeRange range,
+		size_t target_points,
+		DownsampleMethod method = DownsampleMethod::LTTB,
+		ValuePredicate predicate = ValuePredicate()
+	)
+	{
+		Query q(range, true, 0, predicate);
+		q.m_downsample = method;
+		q.m_target_points = target_points;
+		return q;
+	}
+
+	// One result per point in the range, in time order, computed in a single pass over the
+	// chunk columns with window state carried across chunks. Not downsampled; use a step to
+	// thin out long ranges.
+	static Query windowed(TimeRange range, WindowSpec window, ValuePredicate predicate = ValuePredicate())
 	{
+		Query q(range, true, 0, predicate);
+		q.m_window = window;
+		return q;
+	}
+
+	// One point per multiple of `step` in the range (the table's min_resolution_secs when 0),
+	// holding the last point of the step ending there or, in a gap, the filled value. An open
+	// range end is clipped to the data. Gaps at the range edges are bridged from the
+	// neighbouring chunks' first and last values, without loading those chunks.
+	static Query filled(
+		TimeRange range,
+		FillStrategy strategy,
+		TimeDelta step = 0,
+		ValuePredicate predicate = ValuePredicate()
+	)
+	{
+		Query q(range, true, 0, predicate);
+		q.m_fill = strategy;
+		q.m_fill_step = step;
+		return q;
 	}
 
 	TimeRange m_time_range;
 	bool m_sorted;
 	size_t m_limit;
+	ValuePredicate m_predicate;
+	bool m_newest_first;
+	DownsampleMethod m_downsample;
+	size_t m_target_points;
+	WindowSpec m_window;
+	FillStrategy m_fill;
+	TimeDelta m_fill_step;
+};
+
+enum class JoinMethod
+{
+	AsOf,  // Each left point with the last right value at or before it
+	Bucket // Per time bucket, the mean of each side, for buckets holding points of both
+};
+
+// A join of two tables' points over a range, merged in time order
+struct JoinQuery
+{
+	// Right values older than `tolerance` seconds are not matched (0 = any age). Right points
+	// up to `tolerance` before the range start are considered, none earlier.
+	static JoinQuery as_of(TimeRange range, TimeDelta tolerance = 0)
+	{
+		JoinQuery q{};
+		q.m_time_range = range;
+		q.m_method = JoinMethod::AsOf;
+		q.m_tolerance = tolerance;
+		return q;
+	}
+
+	// Buckets are `width` seconds wide and aligned to multiples of it
+	static JoinQuery buckets(TimeRange range, TimeDelta width)
+	{
+		JoinQuery q{};
+		q.m_time_range = range;
+		q.m_method = JoinMethod::Bucket;
+		q.m_bucket_secs = width;
+		return q;
+	}
+
+	TimeRange m_time_range{};
+	JoinMethod m_method{ JoinMethod::AsOf };
+	TimeDelta m_tolerance{ 0 };
+	TimeDelta m_bucket_secs{ 0 };
+	ValuePredicate m_left_predicate{};
+	ValuePredicate m_right_predicate{};
+};
+
+// A row of a join: the left point's timestamp, or the bucket start, and a value per side
+struct JoinedPoint
+{
+	Timestamp ts;
+	double left;
+	double right;
+};
+
+// Rows of a wide table query: one timestamp per row and one vector per projected column
+struct ColumnQueryResult
+{
+	std::vector<Timestamp> timestamps;
+	std::vector<std::vector<double>> columns;
 };
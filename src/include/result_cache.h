@@ -0,0 +1,87 @@
+#pragma once
+
+#include "datapoint.h"
+#include "predicate.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// Per-chunk matches of recent range queries. Repeating a query, or sliding its end forward,
+// rescans only the rows a chunk gained since its entry was stored, so refreshing a dashboard
+// costs about as much as the data that arrived in between.
+class ResultCache
+{
+  public:
+	// A chunk under one query shape. `start_ts` is the query start clipped to the chunk, so
+	// every query covering a chunk's start shares its entry.
+	struct Key
+	{
+		ChunkId chunk_id;
+		Timestamp start_ts;
+		ValuePredicate::Op op;
+		double lower;
+		double upper;
+
+		Key(ChunkId chunk_id, Timestamp start_ts, const ValuePredicate& predicate)
+			: chunk_id(chunk_id)
+			, start_ts(start_ts)
+			, op(predicate.m_op)
+			, lower(predicate.m_lower)
+			, upper(predicate.m_upper)
+		{
+		}
+		bool operator==(const Key&) const = default;
+	};
+
+	struct Partial
+	{
+		uint64_t generation; // Of the snapshot scanned (see ChunkRows)
+		size_t size;		 // Its row count
+		Timestamp end_ts;	 // Query end clipped to the chunk
+		size_t last;		 // End of the index range scanned
+		std::shared_ptr<const std::vector<DataPoint>> matches;
+	};
+
+	ResultCache(size_t max_points, size_t seen_keys)
+		: m_max_points(max_points)
+		, m_seen(std::max<size_t>(seen_keys, 1), 0)
+	{
+	}
+
+	std::optional<Partial> find(const Key& key);
+	// Replaces any entry for the key, evicting the least recently used beyond max_points. A key
+	// is only kept from its second sighting on, so one-off queries neither allocate nor evict.
+	void store(const Key& key, Partial partial);
+
+  private:
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const
+		{
+			size_t hash = std::hash<ChunkId>{}(key.chunk_id);
+			for (size_t part : { std::hash<Timestamp>{}(key.start_ts), static_cast<size_t>(key.op),
+								 std::hash<double>{}(key.lower), std::hash<double>{}(key.upper) }) {
+				hash ^= part + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+			}
+			return hash;
+		}
+	};
+
+	const size_t m_max_points;
+	std::mutex m_mutex;
+	size_t m_points{ 0 };
+	std::list<Key> m_usage_list; // Most recently used first
+	std::unordered_map<Key, std::pair<Partial, std::list<Key>::iterator>, KeyHash> m_entries;
+	// Hashes of keys stored while absent, one per slot; a later store that finds its hash here
+	// is a second sighting
+	std::vector<size_t> m_seen;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "config.h"
+#include "db.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread_pool/thread_pool.h>
+#include <unordered_map>
+#include <vector>
+
+// Serves a DataBase over the binary protocol in protocol.h on TCP and Unix sockets.
+// One thread runs an epoll loop that reads and frames requests; each request runs on the
+// worker pool. Clients may pipeline: responses go back in request order per connection,
+// and all responses ready in one loop iteration are written with a single send.
+class Server
+{
+  public:
+	Server(DataBase& db, size_t worker_threads = Config::SERVER_WORKER_THREADS);
+	~Server();
+	Server(const Server&) = delete;
+	Server& operator=(const Server&) = delete;
+
+	// Returns the bound port, which is chosen by the OS when `port` is 0
+	uint16_t listen_tcp(uint16_t port, const std::string& address = "127.0.0.1");
+	void listen_unix(const std::string& path);
+
+	// Blocks until stop() is called
+	void run();
+	// Safe to call from any thread or a signal handler
+	void stop();
+
+  private:
+	struct Connection
+	{
+		int fd;
+		std::vector<char> in{};
+		std::vector<char> out{};
+		size_t out_offset{ 0 };
+		uint64_t next_seq{ 0 };		 // Sequence number of the next request read
+		uint64_t next_send_seq{ 0 }; // Sequence number of the next response to send
+		size_t in_flight{ 0 };
+		// Responses finished out of order, waiting for earlier ones
+		std::map<uint64_t, std::vector<char>> ready{};
+		uint32_t events{ 0 };
+	};
+
+	struct Completion
+	{
+		uint64_t connection_id;
+		uint64_t seq;
+		std::vector<char> frame;
+	};
+
+	DataBase& m_db;
+	int m_epoll_fd;
+	int m_wake_fd;
+	std::atomic<bool> m_stopping;
+	std::vector<int> m_listen_fds;
+	std::vector<std::string> m_unix_paths;
+	uint64_t m_next_connection_id;
+	std::unordered_map<uint64_t, Connection> m_connections;
+
+	std::mutex m_completions_mutex;
+	std::vector<Completion> m_completions;
+	dp::thread_pool<> m_pool;
+
+	void add_listener(int fd);
+	void accept_connections(int listen_fd);
+	void read_from(uint64_t connection_id, Connection& connection);
+	void dispatch_requests(uint64_t connection_id, Connection& connection);
+	void drain_completions();
+	// Returns false if the connection failed
+	bool flush(Connection& connection);
+	void update_interest(uint64_t connection_id, Connection& connection);
+	void close_connection(uint64_t connection_id);
+
+	// Runs one request on a worker and returns its response frame
+	std::vector<char> handle(uint32_t request_id, uint8_t opcode, const char* payload, size_t size);
+};
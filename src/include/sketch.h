@@ -0,0 +1,52 @@
+#pragma once
+
+#include "config.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+// Mergeable quantile sketch with a relative error guarantee (DDSketch). Values are counted
+// in logarithmically sized bins, so merging two sketches is adding their bin counts.
+class QuantileSketch
+{
+  public:
+	explicit QuantileSketch(double relative_accuracy = Config::SKETCH_RELATIVE_ACCURACY);
+
+	// NaN and infinite values are not counted
+	void add(double value);
+	void merge(const QuantileSketch& other);
+	// Value at quantile q in [0, 1], NaN when the sketch is empty
+	double quantile(double q) const;
+
+	uint64_t count() const { return m_count; }
+	bool empty() const { return m_count == 0; }
+
+	void write(std::ostream& file) const;
+	static QuantileSketch read(std::istream& file);
+
+  private:
+	// Dense run of at most SKETCH_MAX_BINS bin counts starting at bin index m_offset
+	struct Store
+	{
+		int32_t m_offset{ 0 };
+		std::vector<uint64_t> m_counts{};
+
+		void add(int32_t index, uint64_t count = 1);
+		void merge(const Store& other);
+		// Folds the bins below `lowest` into it
+		void collapse_below(int32_t lowest);
+	};
+
+	double m_relative_accuracy;
+	double m_gamma;
+	double m_log_gamma;
+	uint64_t m_count;
+	uint64_t m_zero_count;
+	Store m_positive;
+	Store m_negative;
+
+	int32_t index_of(double magnitude) const;
+	double value_of(int32_t index) const;
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Execution statistics of a single query (EXPLAIN ANALYZE). Times are in nanoseconds.
+struct QueryStats
+{
+	size_t chunks_matched{ 0 }; // Chunk files returned by the index lookup
+	size_t chunks_skipped{ 0 }; // Ruled out by value bounds without loading
+	size_t cache_hits{ 0 };
+	size_t cache_misses{ 0 };
+	size_t bytes_read{ 0 };
+	size_t partials_reused{ 0 }; // Chunks answered, at least in part, from the result cache
+	size_t rows_scanned{ 0 };
+	size_t rows_returned{ 0 };
+
+	uint64_t lookup_ns{ 0 };
+	uint64_t load_ns{ 0 };
+	uint64_t filter_ns{ 0 };
+	uint64_t sort_ns{ 0 };
+	uint64_t total_ns{ 0 };
+};
+
+// Monotonic timer for attributing time to query phases
+class PhaseTimer
+{
+  public:
+	PhaseTimer()
+		: m_last(std::chrono::steady_clock::now())
+	{
+	}
+
+	// Nanoseconds since construction or the previous lap
+	uint64_t lap()
+	{
+		auto now = std::chrono::steady_clock::now();
+		auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_last).count();
+		m_last = now;
+		return static_cast<uint64_t>(elapsed);
+	}
+
+  private:
+	std::chrono::steady_clock::time_point m_last;
+};
+
+// Cumulative latency distribution with power-of-two nanosecond buckets. Recording is a
+// couple of relaxed atomic increments, so any number of threads can record concurrently.
+class LatencyHistogram
+{
+  public:
+	static constexpr size_t NUM_BUCKETS = 64;
+
+	void record(uint64_t latency_ns)
+	{
+		m_buckets[bucket_of(latency_ns)].fetch_add(1, std::memory_order_relaxed);
+		m_count.fetch_add(1, std::memory_order_relaxed);
+		m_total_ns.fetch_add(latency_ns, std::memory_order_relaxed);
+	}
+
+	uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+	double mean_ns() const
+	{
+		uint64_t n = count();
+		return n == 0 ? 0.0 : static_cast<double>(m_total_ns.load(std::memory_order_relaxed)) / n;
+	}
+
+	// Upper bound of the bucket holding quantile q in [0, 1]
+	uint64_t percentile_ns(double q) const
+	{
+		uint64_t n = count();
+		if (n == 0)
+		{
+			return 0;
+		}
+		auto rank = static_cast<uint64_t>(q * static_cast<double>(n - 1));
+		uint64_t seen{ 0 };
+		for (size_t i{ 0 }; i < NUM_BUCKETS; i++)
+		{
+			seen += m_buckets[i].load(std::memory_order_relaxed);
+			if (seen > rank)
+			{
+				return upper_bound_of(i);
+			}
+		}
+		return upper_bound_of(NUM_BUCKETS - 1);
+	}
+
+  private:
+	std::array<std::atomic<uint64_t>, NUM_BUCKETS> m_buckets{};
+	std::atomic<uint64_t> m_count{ 0 };
+	std::atomic<uint64_t> m_total_ns{ 0 };
+
+	// Bucket i holds latencies in [2^(i-1), 2^i)
+	static size_t bucket_of(uint64_t latency_ns)
+	{
+		return std::min<size_t>(std::bit_width(latency_ns), NUM_BUCKETS - 1);
+	}
+	static uint64_t upper_bound_of(size_t bucket)
+	{
+		return bucket >= 63 ? UINT64_MAX : (uint64_t{ 1 } << bucket);
+	}
+};
@@ -1,19 +1,35 @@
 #pragma once
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
 #include <list>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "column.h"
+#include "config.h"
+#include "executor.h"
+#include "pipeline.h"
+#include "predicate.h"
+#include "result_cache.h"
+#include "stats.h"
 #include "tree.h"
 
 class ChunkFile;
+struct ChunkMetadata;
 class Query;
 class DataPoint;
 class Chunk;
+class ChunkSnapshot;
+struct ColumnQueryResult;
 
 class Table
 {
@@ -21,12 +37,16 @@ class Table
 
 	struct Metrics
 	{
-		double m_cache_misses;
-		double m_cache_hits;
+		std::atomic<uint64_t> m_cache_misses;
+		std::atomic<uint64_t> m_cache_hits;
+		// Cumulative latencies of query() and insert() calls
+		LatencyHistogram m_query_latency;
+		LatencyHistogram m_insert_latency;
 	
 		const double get_cache_miss_percentage() const 
 		{
-			return (m_cache_misses / (m_cache_hits + m_cache_misses)) * 100;
+			const double misses = static_cast<double>(m_cache_misses);
+			return (misses / (static_cast<double>(m_cache_hits) + misses)) * 100;
 		}
 	};
 	class Config
@@ -37,14 +57,29 @@ class Table
 		const size_t max_chunks_to_save;
 		const TimeDelta flush_interval_secs;
 		const TimeDelta min_resolution_secs;
+		// Rows first reserved per chunk, until the ingest rate is known
 		const size_t chunk_capacity;
+		// How values are stored; queries still return doubles (see column.h)
+		const ValueType value_type;
+		// Value columns per timestamp. Point queries, bounds and sketches use the first column.
+		const size_t value_columns;
+		// Samples sit on the min_resolution_secs grid, so chunks store a presence bitmap instead
+		// of timestamps. Points off the grid move down onto it; a repeated slot keeps the last.
+		const bool regular_series;
+		// When set, new chunks span a power of two multiple or fraction of chunk_size_secs
+		// chosen from the observed ingest rate so they hold about this many bytes
+		const size_t target_chunk_bytes;
 
 		Config(
 			TimeDelta chunk_interval_secs,
 			size_t cache_size_chunks,
 			size_t max_save_chunks,
 			TimeDelta flush_interval_secs,
-			TimeDelta min_resolution_secs
+			TimeDelta min_resolution_secs,
+			ValueType value_type = ValueType::Float64,
+			size_t value_columns = 1,
+			bool regular_series = false,
+			size_t target_chunk_bytes = 0
 		)
 			: chunk_size_secs(chunk_interval_secs)
 			, chunk_cache_size(cache_size_chunks)
@@ -52,6 +87,10 @@ class Table
 			, flush_interval_secs(flush_interval_secs) // TODO: Not implemented (background thread)
 			, min_resolution_secs(min_resolution_secs)
 			, chunk_capacity(static_cast<size_t>(chunk_interval_secs / min_resolution_secs))
+			, value_type(value_type)
+			, value_columns(value_columns)
+			, regular_series(regular_series)
+			, target_chunk_bytes(target_chunk_bytes)
 		{
 		}
 	};
@@ -61,15 +100,54 @@ class Table
 		, m_data_path(data_path)
 		, m_row_count(0)
 		, m_config(config)
+		, m_latest_point_ts(TIMESTAMP_MIN - 1)
 		, m_metrics()
-		, m_chunk_tree(ChunkTree(data_path, config.chunk_size_secs))
+		, m_chunk_tree(data_path, config.chunk_size_secs)
+		, m_query_pool(::Config::QUERY_THREADS)
 	{
 	}
 
 	size_t rows() const { return m_row_count; }
+	const Config& get_config() const { return m_config; }
 
-	std::vector<DataPoint> query(const Query& q);
+	// Per-query execution statistics are written to `stats` when given
+	std::vector<DataPoint> query(const Query& q, QueryStats* stats = nullptr);
+	// Runs many queries as one plan: chunks shared between queries are loaded once
+	std::vector<std::vector<DataPoint>> query_batch(const std::vector<Query>& queries);
+	// Approximate quantiles (each in [0, 1]) of the values in the range. Chunks fully inside
+	// the range contribute their stored sketch; only the edge chunks are scanned.
+	std::vector<double> quantiles(const TimeRange& range, const std::vector<double>& qs);
+	// Visits the chunks overlapping the range in time order, loading one at a time and leaving
+	// the cache alone, so a bulk export does not evict the working set
+	void scan(const TimeRange& range, const std::function<void(const ChunkSnapshot&)>& visit);
+	// Returns a cursor handing out the chunks overlapping the range in time order, skipping
+	// those whose bounds rule out the predicate. Loads run on the query pool a few chunks ahead
+	// of the reader and bypass the cache, so a long range is never held or cached whole.
+	// Cursors opened on several tables load in parallel.
+	class ChunkCursor;
+	std::unique_ptr<ChunkCursor> open_chunks(
+		const TimeRange& range,
+		QueryStats& stats,
+		const ValuePredicate& predicate = ValuePredicate()
+	);
+	// The nearest point before or after `ts` from chunk metadata alone, for gap filling and
+	// as-of joins. Only the last or first point of the nearest other non-empty chunk is
+	// considered, so none is found when it fails the predicate.
+	std::optional<DataPoint> point_before(Timestamp ts, const ValuePredicate& predicate) const;
+	std::optional<DataPoint> point_after(Timestamp ts, const ValuePredicate& predicate) const;
+	// Safe to call from many threads at once, alongside queries
 	void insert(const std::vector<DataPoint>& dps);
+	// Inserts rows of a wide table: `columns` holds one vector per value column, each as long
+	// as `timestamps`. Throws std::invalid_argument when the shapes do not match the table.
+	void insert_rows(const std::vector<Timestamp>& timestamps, const std::vector<std::vector<double>>& columns);
+	// The range's rows in time order with only the given value columns. Chunks on disk read
+	// just those columns. The predicate tests the first projected column; sorting, newest
+	// first and downsampling options are ignored.
+	ColumnQueryResult query_columns(
+		const Query& q,
+		const std::vector<size_t>& columns,
+		QueryStats* stats = nullptr
+	);
 
 	void finalise_all();
 	void flush_chunks();
@@ -79,44 +157,151 @@ class Table
   private:
 	std::string m_name;
 	std::string m_data_path;
-	size_t m_row_count;
+	std::atomic<size_t> m_row_count;
 	Config m_config;
-	Timestamp m_latest_point_ts;
+	std::atomic<Timestamp> m_latest_point_ts;
+	// Lock order: m_flush_mutex, then the tree's lock, then a chunk's lock. m_cache_mutex is
+	// never held while taking another lock.
 	std::mutex m_flush_mutex;
 	std::mutex m_cache_mutex;
 	Metrics m_metrics;
 
 	// Insertion
-	void insert_single(const DataPoint& dp);
+	void insert_single(const DataPoint& dp, std::shared_ptr<Chunk>& current);
+	// Points `current` at the chunk for `ts`, finalising the one it leaves
+	void advance_to(Timestamp ts, std::shared_ptr<Chunk>& current);
+	std::shared_ptr<Chunk> get_or_create_chunk(const TimeRange& partition);
 
 	// Querying
 	ChunkTree m_chunk_tree;
+	std::vector<DataPoint> run_query(const Query& q, QueryStats& stats);
+	std::vector<DataPoint> query_latest(const Query& q, QueryStats* stats = nullptr);
+	WorkStealingExecutor m_query_pool;
+	// The in-memory copy of the chunk if there is one, otherwise loaded from disk
+	std::shared_ptr<Chunk> load_chunk(const ChunkFile& chunk_file, size_t* bytes_read = nullptr);
+	std::vector<std::shared_ptr<Chunk>> fetch_chunks(
+		const std::vector<std::shared_ptr<ChunkFile>>& chunk_files,
+		QueryStats* stats = nullptr
+	);
+	// Query pipeline: chunks stream from the lookup into a filter stage as they load, so hits
+	// and finished loads are filtered while the rest are still being read
+	struct StreamedChunk
+	{
+		size_t slot; // Position in the lookup's chunk list
+		std::shared_ptr<Chunk> chunk;
+		size_t bytes_read;
+		std::exception_ptr error;
+	};
+	struct ChunkStream
+	{
+		pipeline::Channel<StreamedChunk> channel;
+		// Set once no more chunks are needed; loads not yet started are skipped
+		std::atomic<bool> cancelled{ false };
+	};
+	// Delivers every file's chunk exactly once: cached chunks at once, misses in batches of
+	// QUERY_LOAD_BATCH_CHUNKS loaded on the query pool
+	std::shared_ptr<ChunkStream> stream_chunks(
+		const std::vector<std::shared_ptr<ChunkFile>>& chunk_files,
+		QueryStats& stats
+	);
+	// Delivers the chunks of files [begin, end) into the stream, tagged with their index. Loads
+	// are only cached with `cache_loads`.
+	void feed_chunks(
+		const std::shared_ptr<ChunkStream>& stream,
+		const std::vector<std::shared_ptr<ChunkFile>>& chunk_files,
+		size_t begin,
+		size_t end,
+		QueryStats& stats,
+		bool cache_loads
+	);
+	pipeline::Task<std::vector<DataPoint>> filter_chunks(
+		const Query& q,
+		std::vector<std::shared_ptr<ChunkFile>> chunk_files,
+		QueryStats& stats
+	);
+	// The chunk's matches for the query, reusing and extending its result cache entry
+	std::shared_ptr<const std::vector<DataPoint>> scan_chunk(
+		const ChunkSnapshot& chunk,
+		const ChunkMetadata& metadata,
+		const Query& q,
+		QueryStats& stats
+	);
+	// Visits the query's chunks in time order through a cursor, holding one at a time
+	void stream_query_chunks(
+		const Query& q,
+		QueryStats& stats,
+		const std::function<void(const ChunkSnapshot&)>& visit
+	);
+	// The span from the first to the last point in the range, from chunk metadata alone;
+	// nullopt when the range holds none
+	std::optional<TimeRange> data_extent(const TimeRange& range) const;
 	std::vector<DataPoint> gather_data_from_chunks(
-		const std::vector<std::shared_ptr<Chunk>>& chunks,
+		const std::vector<ChunkSnapshot>& chunks,
 		const TimeRange& query_range,
+		const ValuePredicate& predicate,
 		bool sorted,
-		size_t limit
+		size_t limit,
+		QueryStats* stats = nullptr
 	) const;
 
 	// Utils
-	Timestamp get_partition_key(Timestamp timestamp);
+	// The range of the chunk holding `timestamp`, choosing one for a new partition. Chunks are
+	// cached and indexed under their end timestamp, the partition key.
+	TimeRange get_partition(Timestamp timestamp);
+	Timestamp get_partition_key(Timestamp timestamp) { return get_partition(timestamp).end_ts; }
 	ChunkId generate_chunk_id();
 
 	// Creation
-	std::shared_ptr<Chunk> create_chunk(Timestamp partition_key);
+	std::shared_ptr<Chunk> create_chunk(const TimeRange& partition);
+	// Rows per second seen in recently completed partitions (0 until known), which sizes new
+	// chunks and, with target_chunk_bytes, their width
+	std::atomic<double> m_rows_per_sec{ 0.0 };
+	void observe_rate(const TimeRange& partition);
+	TimeDelta adaptive_chunk_width() const;
+	// End to start of every partition of an adaptive width table, so a timestamp maps to the
+	// one chunk that holds it
+	std::mutex m_partition_mutex;
+	std::map<Timestamp, Timestamp> m_partitions;
 
 	// Caching
 	std::unordered_map<Timestamp, std::pair<std::shared_ptr<Chunk>, std::list<Timestamp>::iterator>>
 		m_chunk_cache;
 	std::list<Timestamp> m_chunk_cache_usage_list;
+	// Every chunk still referenced anywhere (cache, pending saves, writers), so a partition is
+	// never held as two diverging copies. Guarded by m_cache_mutex.
+	std::unordered_map<Timestamp, std::weak_ptr<Chunk>> m_live_chunks;
 	std::shared_ptr<Chunk> get_chunk_from_cache(Timestamp partition_key);
-	void put_chunk_in_cache(Timestamp partition_key, std::shared_ptr<Chunk> chunk);
-	void evict_from_cache(Timestamp partition_key);
+	// Returns the chunk now cached for the partition, which is the live copy if one exists
+	std::shared_ptr<Chunk> put_chunk_in_cache(Timestamp partition_key, std::shared_ptr<Chunk> chunk);
+	std::shared_ptr<Chunk> find_live_chunk(Timestamp partition_key);
+	// Per-chunk matches of recent queries, used by scan_chunk
+	ResultCache m_result_cache{ ::Config::RESULT_CACHE_POINTS, ::Config::RESULT_CACHE_SEEN_KEYS };
 
+	// Guarded by m_flush_mutex
 	std::vector<std::pair<std::weak_ptr<ChunkFile>, std::shared_ptr<Chunk>>> m_chunks_to_save;
 	void finalise_single(std::shared_ptr<Chunk> chunk);
-	void finalise_single(
-		const std::weak_ptr<ChunkFile> chunk_file,
-		const std::shared_ptr<Chunk> chunk
-	);
+};
+
+class Table::ChunkCursor
+{
+  public:
+	// Loads not yet started are skipped once the cursor is gone
+	~ChunkCursor();
+
+	// The next chunk in time order, or nullopt after the last. Rethrows a failed load.
+	pipeline::Task<std::optional<ChunkSnapshot>> next();
+
+  private:
+	friend class Table;
+	ChunkCursor(Table& table, std::vector<std::shared_ptr<ChunkFile>>&& chunk_files, QueryStats& stats);
+
+	Table& m_table;
+	std::vector<std::shared_ptr<ChunkFile>> m_chunk_files;
+	std::shared_ptr<ChunkStream> m_stream;
+	QueryStats& m_stats;
+	// Chunks that arrived ahead of their turn, by position in time order
+	std::vector<std::shared_ptr<Chunk>> m_arrived;
+	std::vector<bool> m_ready;
+	size_t m_next{ 0 };
+	size_t m_launched{ 0 }; // Files whose chunks have been requested
 };
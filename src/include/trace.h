@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+
+// Lightweight trace spans, compiled in with TSDB_ENABLE_TRACING. Each thread records into its
+// own fixed-size ring buffer (oldest events are overwritten), so recording never takes a lock.
+// When tracing is compiled out TSDB_TRACE_SPAN expands to nothing.
+#ifdef TSDB_ENABLE_TRACING
+#define TSDB_TRACE_CONCAT_INNER(a, b) a##b
+#define TSDB_TRACE_CONCAT(a, b) TSDB_TRACE_CONCAT_INNER(a, b)
+#define TSDB_TRACE_SPAN(name) ::trace::Span TSDB_TRACE_CONCAT(tsdb_trace_span_, __LINE__)(name)
+#else
+#define TSDB_TRACE_SPAN(name) ((void)0)
+#endif
+
+namespace trace
+{
+constexpr bool enabled()
+{
+#ifdef TSDB_ENABLE_TRACING
+	return true;
+#else
+	return false;
+#endif
+}
+
+// Nanoseconds since the first trace event of the process
+uint64_t now_ns();
+
+// `name` must outlive the trace (string literals)
+void record(const char* name, uint64_t start_ns, uint64_t duration_ns);
+
+// Writes every buffered span in Chrome trace_event JSON (load in chrome://tracing or Perfetto).
+// Safe to call while other threads record; events being overwritten may be skipped.
+void dump_chrome_json(std::ostream& out);
+
+// Drops all buffered events
+void clear();
+
+class Span
+{
+  public:
+	explicit Span(const char* name)
+		: m_name(name)
+		, m_start_ns(now_ns())
+	{
+	}
+	~Span() { record(m_name, m_start_ns, now_ns() - m_start_ns); }
+
+	Span(const Span&) = delete;
+	Span& operator=(const Span&) = delete;
+
+  private:
+	const char* m_name;
+	uint64_t m_start_ns;
+};
+} // namespace trace
@@ -5,7 +5,9 @@
 #include "chunkfile.h"
 
 #include <cstddef>
+#include <functional>
 #include <memory>
+#include <shared_mutex>
 #include <string>
 #include <sys/types.h>
 #include <vector>
@@ -21,6 +23,7 @@ class ChunkTreeNode
 	std::vector<std::variant<std::unique_ptr<ChunkTreeNode>, std::shared_ptr<ChunkFile>>> children;
 	// Next node in the sequence
 	ChunkTreeNode* next_node; // B+ Tree functionality 
+	ChunkTreeNode* prev_node;
 
 	ChunkTreeNode(const bool leaf = false, const size_t node_capacity = Config::MAX_NODE_SIZE)
 		: m_node_capacity(node_capacity)
@@ -29,6 +32,7 @@ class ChunkTreeNode
 		keys.reserve(node_capacity);
 		children.reserve(node_capacity + 1);
 		next_node = nullptr;
+		prev_node = nullptr;
 	}
 
 	bool is_full() const { return children.size() == m_node_capacity; }
@@ -50,10 +54,20 @@ class ChunkTree
 	}
 
 	std::vector<std::shared_ptr<ChunkFile>> range_query(const TimeRange& range) const;
+	// Visits chunk files overlapping the range from newest to oldest until `visit` returns false.
+	// The tree is not locked while `visit` runs.
+	void reverse_range_query(
+		const TimeRange& range,
+		const std::function<bool(const std::shared_ptr<ChunkFile>&)>& visit
+	) const;
+	// The chunk file indexed under exactly `end_ts`, or null
+	std::shared_ptr<ChunkFile> find(Timestamp end_ts) const;
 	void insert(const TimeRange& range, std::shared_ptr<ChunkFile> chunk_file);
 
   private:
 	std::unique_ptr<ChunkTreeNode> m_root;
+	// Lookups share the tree; inserts (which may split nodes) take it exclusively
+	mutable std::shared_mutex m_mutex;
 	std::string m_data_path;
 	TimeDelta m_chunk_interval_secs;
 
@@ -68,6 +82,12 @@ class ChunkTree
 		const TimeRange& range,
 		std::vector<std::shared_ptr<ChunkFile>>& results
 	) const;
+	// Newest first, stopping after `max_files`
+	void gather_chunk_files_in_reverse(
+		const TimeRange& range,
+		size_t max_files,
+		std::vector<std::shared_ptr<ChunkFile>>& results
+	) const;
 
 	// Insertion
 	void split(ChunkTreeNode* parent, size_t index);
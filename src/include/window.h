@@ -0,0 +1,83 @@
+#pragma once
+
+#include "datapoint.h"
+#include "predicate.h"
+#include "query.h"
+#include "utils.h"
+
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <vector>
+
+class ChunkSnapshot;
+
+namespace window
+{
+// Trailing window over a stream of points in time order. Every push updates the sum, the
+// counter increase and the minimum and maximum in amortised O(1): min and max come from
+// monotonic deques, whose fronts are the extremes of the points still in the window.
+class MovingWindow
+{
+  public:
+	// Keeps the last `points` points, or with secs > 0 those less than `secs` seconds older
+	// than the newest
+	MovingWindow(size_t points, TimeDelta secs);
+
+	void push(const DataPoint& point);
+
+	size_t size() const { return m_points.size(); }
+	double sum() const { return m_sum; }
+	double min() const { return m_min.front().value; }
+	double max() const { return m_max.front().value; }
+	// Per-second counter increase from the oldest point to the newest, if they differ in time
+	std::optional<double> rate() const;
+
+  private:
+	struct Entry
+	{
+		size_t seq;
+		Timestamp ts;
+		double value;
+		double increase; // Counter increase since the first point ever pushed
+	};
+
+	bool expired(const Entry& entry, const Entry& newest) const;
+
+	const size_t m_max_points;
+	const TimeDelta m_secs;
+	size_t m_seq{ 0 };
+	double m_sum{ 0 };
+	double m_increase{ 0 };
+	std::deque<Entry> m_points;
+	std::deque<Entry> m_min; // Values increasing from the front
+	std::deque<Entry> m_max; // Values decreasing from the front
+};
+
+// Evaluates a window function over chunks fed in time order. The window state carries from
+// one chunk to the next, so only the chunk being read needs to be held.
+class Evaluator
+{
+  public:
+	// Throws std::invalid_argument for a moving function without a window extent
+	explicit Evaluator(const WindowSpec& spec);
+
+	// Feeds the chunk's points in the range that satisfy the predicate
+	void add(const ChunkSnapshot& chunk, const TimeRange& range, const ValuePredicate& predicate);
+	// The results, including the one held back for the last step
+	std::vector<DataPoint> finish();
+
+  private:
+	void push(const DataPoint& point);
+	void emit(Timestamp ts, double value);
+
+	const WindowSpec m_spec;
+	MovingWindow m_window;
+	std::optional<DataPoint> m_previous{};
+	double m_total{ 0 };
+	std::vector<DataPoint> m_results{};
+	// With a step, only the latest result of the current bucket is held back
+	std::optional<DataPoint> m_held{};
+	Timestamp m_held_bucket{ 0 };
+};
+} // namespace window
@@ -0,0 +1,160 @@
+#include "ingest.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+#include <poll.h>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+const char *skip_blanks(const char *it, const char *end) {
+	while (it != end && is_blank(*it))
+		++it;
+	return it;
+}
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void report(std::ostream &out, const IngestStats &stats) {
+	double secs = stats.seconds > 0 ? stats.seconds : 1;
+	out << "Ingested " << stats.points << " points in " << std::fixed << std::setprecision(1)
+		<< stats.seconds << " s (" << stats.points / secs << " points/s, "
+		<< stats.bytes / secs / (1 << 20) << " MiB/s), " << stats.rejected << " lines rejected\n";
+}
+} // namespace
+
+bool parse_point_line(std::string_view line, DataPoint &point) {
+	const char *it = skip_blanks(line.data(), line.data() + line.size());
+	const char *end = line.data() + line.size();
+
+	auto [ts_end, ts_error] = std::from_chars(it, end, point.ts);
+	if (ts_error != std::errc() || ts_end == end)
+		return false;
+
+	// One comma, or any run of blanks, between the fields
+	it = skip_blanks(ts_end, end);
+	if (it != end && *it == ',')
+		it = skip_blanks(it + 1, end);
+	if (it == ts_end || it == end)
+		return false;
+
+	auto [value_end, value_error] = std::from_chars(it, end, point.value);
+	if (value_error != std::errc())
+		return false;
+	return skip_blanks(value_end, end) == end;
+}
+
+IngestStats ingest_stream(DataBase &db, const std::string &table_name, int fd,
+						  const IngestOptions &options, std::ostream *progress) {
+	if (!db.has_table(table_name)) {
+		throw std::runtime_error("Table not found: " + table_name);
+	}
+
+	IngestStats stats{};
+	std::vector<char> block(std::max<size_t>(options.block_bytes, 64));
+	std::vector<DataPoint> batch{};
+	batch.reserve(options.batch_points);
+	size_t used{0};
+	bool skipping_long_line{false};
+	bool at_end{false};
+
+	const auto start = Clock::now();
+	auto last_report = start;
+
+	auto flush_batch = [&]() {
+		if (batch.empty())
+			return;
+		TSDB_TRACE_SPAN("ingest.batch");
+		db.insert(table_name, batch);
+		stats.points += batch.size();
+		stats.batches++;
+		batch.clear();
+	};
+	auto take_line = [&](std::string_view line) {
+		const char *first = skip_blanks(line.data(), line.data() + line.size());
+		if (first == line.data() + line.size() || *first == '#')
+			return;
+		DataPoint point;
+		if (!parse_point_line(line, point)) {
+			stats.rejected++;
+			return;
+		}
+		batch.push_back(point);
+		if (batch.size() >= options.batch_points)
+			flush_batch();
+	};
+
+	while (!at_end) {
+		// A slow producer should not hold a partial batch back indefinitely
+		if (!batch.empty() && options.max_batch_delay_secs > 0) {
+			pollfd input{fd, POLLIN, 0};
+			int ready = poll(&input, 1, static_cast<int>(options.max_batch_delay_secs * 1000));
+			if (ready == 0) {
+				flush_batch();
+				continue;
+			}
+		}
+		ssize_t received = read(fd, block.data() + used, block.size() - used);
+		if (received < 0) {
+			if (errno == EINTR)
+				continue;
+			throw std::runtime_error(std::string("Failed to read input: ") + std::strerror(errno));
+		}
+		at_end = received == 0;
+		stats.bytes += static_cast<uint64_t>(received);
+		used += static_cast<size_t>(received);
+
+		// Parse every complete line in the block; a partial last line waits for more input
+		const char *line_start = block.data();
+		const char *end = block.data() + used;
+		while (const char *newline = static_cast<const char *>(
+				   std::memchr(line_start, '\n', static_cast<size_t>(end - line_start)))) {
+			if (skipping_long_line) {
+				skipping_long_line = false;
+			} else {
+				take_line(std::string_view(line_start, static_cast<size_t>(newline - line_start)));
+			}
+			line_start = newline + 1;
+		}
+
+		size_t remainder = static_cast<size_t>(end - line_start);
+		if (at_end && remainder > 0 && !skipping_long_line) {
+			take_line(std::string_view(line_start, remainder));
+			remainder = 0;
+		} else if (remainder == block.size()) {
+			// A line filled the whole block: drop it rather than grow
+			stats.rejected += skipping_long_line ? 0 : 1;
+			skipping_long_line = true;
+			remainder = 0;
+		}
+		std::memmove(block.data(), line_start, remainder);
+		used = remainder;
+
+		if (progress && options.report_interval_secs > 0 &&
+			seconds_since(last_report) >= options.report_interval_secs) {
+			last_report = Clock::now();
+			stats.seconds = seconds_since(start);
+			report(*progress, stats);
+		}
+	}
+	flush_batch();
+
+	stats.seconds = seconds_since(start);
+	if (progress)
+		report(*progress, stats);
+	return stats;
+}
@@ -0,0 +1,148 @@
+#include "join.h"
+#include "chunk.h"
+#include "config.h"
+#include "pipeline.h"
+#include "table.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// One side's points in time order, read a morsel at a time from its chunk cursor
+class PointCursor
+{
+  public:
+	PointCursor(Table::ChunkCursor &chunks, const TimeRange &range, const ValuePredicate &predicate)
+		: m_chunks(chunks), m_range(range), m_predicate(predicate) {}
+
+	// A point is ready to peek at without suspending
+	bool ready() const { return m_pos < m_block.size(); }
+	const DataPoint &peek() const { return m_block[m_pos]; }
+	DataPoint take() { return m_block[m_pos++]; }
+
+	// Reads ahead until a point is ready; false once the side has none left
+	pipeline::Task<bool> fill() {
+		while (!ready()) {
+			if (m_exhausted) {
+				co_return false;
+			}
+			if (m_row >= m_last) {
+				auto chunk = co_await m_chunks.next();
+				if (!chunk) {
+					m_exhausted = true;
+					continue;
+				}
+				m_chunk = std::move(*chunk);
+				std::tie(m_row, m_last) = m_chunk.get_index_range(m_range);
+				continue;
+			}
+			const size_t end = std::min(m_last, m_row + Config::SCAN_MORSEL_ROWS);
+			m_block = m_chunk.get_rows(m_row, end, m_predicate);
+			m_pos = 0;
+			m_row = end;
+		}
+		co_return true;
+	}
+
+	// Consumes the points before `end_ts` and returns their mean, if there were any
+	pipeline::Task<std::optional<double>> mean_before(Timestamp end_ts) {
+		double sum{0};
+		size_t count{0};
+		while ((ready() || co_await fill()) && peek().ts < end_ts) {
+			sum += take().value;
+			count++;
+		}
+		co_return count > 0 ? std::optional<double>(sum / static_cast<double>(count)) : std::nullopt;
+	}
+
+  private:
+	Table::ChunkCursor &m_chunks;
+	const TimeRange m_range;
+	const ValuePredicate m_predicate;
+	ChunkSnapshot m_chunk{};
+	size_t m_row{0};
+	size_t m_last{0};
+	std::vector<DataPoint> m_block{};
+	size_t m_pos{0};
+	bool m_exhausted{false};
+};
+
+Timestamp floor_div(Timestamp ts, TimeDelta step) {
+	return ts / step - (ts % step < 0 ? 1 : 0);
+}
+
+pipeline::Task<std::vector<JoinedPoint>> as_of(PointCursor &left, PointCursor &right,
+											   TimeDelta tolerance) {
+	std::vector<JoinedPoint> results{};
+	// The right side's last point at or before the current left point
+	std::optional<DataPoint> latest{};
+	while (left.ready() || co_await left.fill()) {
+		const DataPoint point = left.take();
+		while ((right.ready() || co_await right.fill()) && right.peek().ts <= point.ts) {
+			latest = right.take();
+		}
+		if (latest && (tolerance <= 0 || point.ts - latest->ts <= tolerance)) {
+			results.push_back(JoinedPoint{point.ts, point.value, latest->value});
+		}
+	}
+	co_return results;
+}
+
+pipeline::Task<std::vector<JoinedPoint>> buckets(PointCursor &left, PointCursor &right,
+												 TimeDelta width) {
+	std::vector<JoinedPoint> results{};
+	// Both sides are consumed up to the earlier of their next buckets, one bucket at a time
+	while ((left.ready() || co_await left.fill()) && (right.ready() || co_await right.fill())) {
+		const Timestamp bucket =
+			std::min(floor_div(left.peek().ts, width), floor_div(right.peek().ts, width));
+		const Timestamp end_ts = (bucket + 1) * width;
+		const auto left_mean = co_await left.mean_before(end_ts);
+		const auto right_mean = co_await right.mean_before(end_ts);
+		if (left_mean && right_mean) {
+			results.push_back(JoinedPoint{bucket * width, *left_mean, *right_mean});
+		}
+	}
+	co_return results;
+}
+
+} // namespace
+
+std::vector<JoinedPoint> join::run(Table &left, Table &right, const JoinQuery &query) {
+	TSDB_TRACE_SPAN("join.run");
+	if (query.m_method == JoinMethod::Bucket && query.m_bucket_secs <= 0) {
+		throw std::invalid_argument("Bucket join needs a positive bucket width");
+	}
+	const TimeRange &range = query.m_time_range;
+	TimeRange right_range = range;
+	if (query.m_method == JoinMethod::AsOf && query.m_tolerance > 0) {
+		right_range.start_ts = range.start_ts > TIMESTAMP_MIN + query.m_tolerance
+								   ? range.start_ts - query.m_tolerance
+								   : TIMESTAMP_MIN;
+	} else if (query.m_method == JoinMethod::AsOf && range.start_ts > TIMESTAMP_MIN) {
+		// Unbounded: the right side reaches back to its last point before the range. Without
+		// one in an earlier chunk's metadata (or when it fails the predicate) the right side
+		// is read from the start.
+		const auto before = right.point_before(range.start_ts, query.m_right_predicate);
+		right_range.start_ts = before ? before->ts : TIMESTAMP_MIN;
+	}
+
+	// Both cursors start loading before either is read
+	QueryStats left_stats{};
+	QueryStats right_stats{};
+	auto left_chunks = left.open_chunks(range, left_stats, query.m_left_predicate);
+	auto right_chunks = right.open_chunks(right_range, right_stats, query.m_right_predicate);
+	PointCursor left_points(*left_chunks, range, query.m_left_predicate);
+	PointCursor right_points(*right_chunks, right_range, query.m_right_predicate);
+
+	if (query.m_method == JoinMethod::AsOf) {
+		return pipeline::sync_wait(as_of(left_points, right_points, query.m_tolerance));
+	}
+	return pipeline::sync_wait(buckets(left_points, right_points, query.m_bucket_secs));
+}
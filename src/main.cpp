@@ -1,13 +1,108 @@
 #include <cassert>
 #include <cstddef>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unistd.h>
 
 #include "cli.h"
+#include "config.h"
 #include "db.h"
+#include "ingest.h"
 
-int main() {
+namespace {
+// Number arguments must be whole and non-negative; std::stoul alone accepts "12x" and wraps "-1"
+size_t parse_count(const std::string &text) {
+	size_t used{0};
+	auto parsed = text.starts_with('-') ? 0 : std::stoul(text, &used);
+	if (used == 0 || used != text.size()) {
+		throw std::invalid_argument(text);
+	}
+	return parsed;
+}
+
+double parse_secs(const std::string &text) {
+	size_t used{0};
+	double parsed = std::stod(text, &used);
+	if (used != text.size() || !(parsed >= 0)) {
+		throw std::invalid_argument(text);
+	}
+	return parsed;
+}
+
+// tsdb ingest <table> [--input=PATH] [--batch=POINTS] [--block-bytes=N] [--report-secs=S]
+// Streams "<timestamp> <value>" or CSV lines from stdin (or a file/FIFO) into the table,
+// creating it with default settings if needed
+int run_ingest(DataBase &db, int argc, char *argv[]) {
+	if (argc < 3) {
+		std::cerr << "Usage: tsdb ingest <table> [--input=PATH] [--batch=POINTS] "
+					 "[--block-bytes=N] [--report-secs=S]\n";
+		return 1;
+	}
+	std::string table_name = argv[2];
+	std::string input_path{};
+	IngestOptions options{};
+	for (int i{3}; i < argc; i++) {
+		std::string_view arg(argv[i]);
+		auto value = [&](std::string_view flag) { return std::string(arg.substr(flag.size())); };
+		try {
+			if (arg.starts_with("--input=")) {
+				input_path = value("--input=");
+			} else if (arg.starts_with("--batch=")) {
+				options.batch_points = std::max<size_t>(1, parse_count(value("--batch=")));
+			} else if (arg.starts_with("--block-bytes=")) {
+				options.block_bytes = parse_count(value("--block-bytes="));
+			} else if (arg.starts_with("--report-secs=")) {
+				options.report_interval_secs = parse_secs(value("--report-secs="));
+			} else {
+				std::cerr << "Unknown argument: " << arg << '\n';
+				return 1;
+			}
+		} catch (const std::exception &) {
+			std::cerr << "Error: Invalid value in argument '" << arg << "'\n";
+			return 1;
+		}
+	}
+
+	int fd = STDIN_FILENO;
+	if (!input_path.empty()) {
+		fd = open(input_path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			std::cerr << "Error: Could not open " << input_path << '\n';
+			return 1;
+		}
+	}
+
+	if (!db.has_table(table_name)) {
+		Table::Config config(Config::CHUNK_INTERVAL_SECS, Config::CHUNK_CACHE_SIZE,
+							 Config::MAX_CHUNKS_TO_SAVE, Config::FLUSH_INTERVAL_SECS,
+							 Config::MIN_DATA_RESOLUTION_SECS);
+		db.create_table(table_name, config);
+	}
+
+	int status = 0;
+	try {
+		ingest_stream(db, table_name, fd, options, &std::cerr);
+	} catch (const std::exception &e) {
+		std::cerr << "Error: " << e.what() << '\n';
+		status = 1;
+	}
+	if (fd != STDIN_FILENO)
+		close(fd);
+	return status;
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
 	// Create DB
 	DataBase db{"db1", "tmp/tsdb"};
 
+	if (argc > 1 && std::string_view(argv[1]) == "ingest") {
+		return run_ingest(db, argc, argv);
+	}
+
 	CLI cli(db);
 
 	cli.run();
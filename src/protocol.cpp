@@ -0,0 +1,142 @@
+#include "protocol.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+size_t protocol::begin_frame(std::vector<char> &out, uint32_t request_id, uint8_t code) {
+	size_t frame_offset = out.size();
+	FrameHeader header{0, request_id, code, {0, 0, 0}};
+	Writer(out).put(header);
+	return frame_offset;
+}
+
+void protocol::end_frame(std::vector<char> &out, size_t frame_offset) {
+	auto length = static_cast<uint32_t>(out.size() - frame_offset - sizeof(FrameHeader));
+	std::memcpy(out.data() + frame_offset + offsetof(FrameHeader, length), &length, sizeof(length));
+}
+
+void protocol::Writer::put_string(const std::string &value) {
+	put(static_cast<uint32_t>(value.size()));
+	m_out.insert(m_out.end(), value.begin(), value.end());
+}
+
+void protocol::Writer::put_points(const std::vector<DataPoint> &points) {
+	put(static_cast<uint32_t>(points.size()));
+	const char *bytes = reinterpret_cast<const char *>(points.data());
+	m_out.insert(m_out.end(), bytes, bytes + points.size() * sizeof(DataPoint));
+}
+
+void protocol::Writer::put_range(const TimeRange &range) {
+	put(range.start_ts);
+	put(range.end_ts);
+}
+
+void protocol::Writer::put_query(const Query &query) {
+	put_range(query.m_time_range);
+	put(static_cast<uint8_t>(query.m_sorted));
+	put(static_cast<uint64_t>(query.m_limit));
+	put(static_cast<uint8_t>(query.m_predicate.m_op));
+	put(query.m_predicate.m_lower);
+	put(query.m_predicate.m_upper);
+	put(static_cast<uint8_t>(query.m_newest_first));
+	put(static_cast<uint8_t>(query.m_downsample));
+	put(static_cast<uint64_t>(query.m_target_points));
+	put(static_cast<uint8_t>(query.m_window.function));
+	put(static_cast<uint64_t>(query.m_window.points));
+	put(query.m_window.secs);
+	put(query.m_window.step);
+	put(static_cast<uint8_t>(query.m_fill));
+	put(query.m_fill_step);
+}
+
+void protocol::Writer::put_config(const Table::Config &config) {
+	put(config.chunk_size_secs);
+	put(static_cast<uint64_t>(config.chunk_cache_size));
+	put(static_cast<uint64_t>(config.max_chunks_to_save));
+	put(config.flush_interval_secs);
+	put(config.min_resolution_secs);
+	put(static_cast<uint8_t>(config.value_type));
+	put(static_cast<uint64_t>(config.value_columns));
+	put(static_cast<uint8_t>(config.regular_series));
+	put(static_cast<uint64_t>(config.target_chunk_bytes));
+}
+
+const char *protocol::Reader::take(size_t bytes) {
+	if (bytes > m_size - m_offset) {
+		throw std::runtime_error("Truncated frame payload");
+	}
+	const char *field = m_data + m_offset;
+	m_offset += bytes;
+	return field;
+}
+
+uint32_t protocol::Reader::get_count(size_t element_bytes) {
+	auto count = get<uint32_t>();
+	if (count > (m_size - m_offset) / element_bytes) {
+		throw std::runtime_error("Truncated frame payload");
+	}
+	return count;
+}
+
+std::string protocol::Reader::get_string() {
+	auto size = get<uint32_t>();
+	return std::string(take(size), size);
+}
+
+std::vector<DataPoint> protocol::Reader::get_points() {
+	auto count = get_count(sizeof(DataPoint));
+	std::vector<DataPoint> points(count);
+	std::memcpy(points.data(), take(count * sizeof(DataPoint)), count * sizeof(DataPoint));
+	return points;
+}
+
+TimeRange protocol::Reader::get_range() {
+	auto start_ts = get<Timestamp>();
+	auto end_ts = get<Timestamp>();
+	return TimeRange(start_ts, end_ts);
+}
+
+Query protocol::Reader::get_query() {
+	Query query(get_range());
+	query.m_sorted = get<uint8_t>() != 0;
+	query.m_limit = get<uint64_t>();
+	auto op = static_cast<ValuePredicate::Op>(get<uint8_t>());
+	auto lower = get<double>();
+	auto upper = get<double>();
+	query.m_predicate = ValuePredicate(op, lower, upper);
+	query.m_newest_first = get<uint8_t>() != 0;
+	query.m_downsample = static_cast<DownsampleMethod>(get<uint8_t>());
+	query.m_target_points = get<uint64_t>();
+	query.m_window.function = static_cast<WindowFunction>(get<uint8_t>());
+	query.m_window.points = get<uint64_t>();
+	query.m_window.secs = get<TimeDelta>();
+	query.m_window.step = get<TimeDelta>();
+	query.m_fill = static_cast<FillStrategy>(get<uint8_t>());
+	query.m_fill_step = get<TimeDelta>();
+	return query;
+}
+
+Table::Config protocol::Reader::get_config() {
+	auto chunk_size_secs = get<TimeDelta>();
+	auto cache_size = get<uint64_t>();
+	auto max_save = get<uint64_t>();
+	auto flush_interval_secs = get<TimeDelta>();
+	auto min_resolution_secs = get<TimeDelta>();
+	auto value_type = get<uint8_t>();
+	auto value_columns = get<uint64_t>();
+	auto regular_series = get<uint8_t>();
+	auto target_chunk_bytes = get<uint64_t>();
+	// Chunks need room for at least one row of at least one column
+	if (chunk_size_secs <= 0 || min_resolution_secs <= 0 || min_resolution_secs > chunk_size_secs ||
+		cache_size == 0 || value_type > static_cast<uint8_t>(ValueType::Bool) ||
+		value_columns == 0 || regular_series > 1) {
+		throw std::runtime_error("Invalid table config");
+	}
+	return Table::Config(chunk_size_secs, cache_size, max_save, flush_interval_secs,
+						 min_resolution_secs, static_cast<ValueType>(value_type), value_columns,
+						 regular_series == 1, target_chunk_bytes);
+}
@@ -0,0 +1,59 @@
+#include "result_cache.h"
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace {
+// Counts every entry as at least one point, so empty partials are bounded too
+size_t cost(const ResultCache::Partial &partial) {
+	return partial.matches->size() + 1;
+}
+} // namespace
+
+std::optional<ResultCache::Partial> ResultCache::find(const Key &key) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_entries.find(key);
+	if (it == m_entries.end()) {
+		return std::nullopt;
+	}
+	m_usage_list.splice(m_usage_list.begin(), m_usage_list, it->second.second);
+	return it->second.first;
+}
+
+void ResultCache::store(const Key &key, Partial partial) {
+	if (cost(partial) > m_max_points) {
+		return;
+	}
+	const size_t hash = KeyHash{}(key);
+	// Freed once the lock is released
+	std::vector<std::shared_ptr<const std::vector<DataPoint>>> released{};
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_entries.find(key);
+	if (it == m_entries.end()) {
+		// A one-off query only leaves its hash behind; matches are kept once the key comes back
+		size_t &seen = m_seen[hash % m_seen.size()];
+		if (seen != hash) {
+			seen = hash;
+			return;
+		}
+		m_usage_list.push_front(key);
+		it = m_entries.emplace(key, std::make_pair(std::move(partial), m_usage_list.begin())).first;
+	} else {
+		m_points -= cost(it->second.first);
+		released.push_back(std::move(it->second.first.matches));
+		it->second.first = std::move(partial);
+		m_usage_list.splice(m_usage_list.begin(), m_usage_list, it->second.second);
+	}
+	m_points += cost(it->second.first);
+
+	while (m_points > m_max_points) {
+		auto evicted = m_entries.find(m_usage_list.back());
+		m_points -= cost(evicted->second.first);
+		released.push_back(std::move(evicted->second.first.matches));
+		m_entries.erase(evicted);
+		m_usage_list.pop_back();
+	}
+}
@@ -0,0 +1,407 @@
+#include "server.h"
+#include "protocol.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace {
+// epoll user data: the wake eventfd, a listener (tagged index) or a connection id
+constexpr uint64_t WAKE_TAG = 0;
+constexpr uint64_t LISTENER_TAG = uint64_t{1} << 63;
+constexpr size_t READ_BLOCK_BYTES = 64 * 1024;
+constexpr int MAX_EVENTS = 64;
+// Input held per connection: one frame of the largest size always fits
+constexpr size_t MAX_INPUT_BYTES = sizeof(protocol::FrameHeader) + protocol::MAX_PAYLOAD_BYTES;
+
+std::runtime_error system_error(const std::string &what) {
+	return std::runtime_error(what + ": " + std::strerror(errno));
+}
+} // namespace
+
+Server::Server(DataBase &db, size_t worker_threads)
+	: m_db(db)
+	, m_epoll_fd(epoll_create1(EPOLL_CLOEXEC))
+	, m_wake_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+	, m_stopping(false)
+	, m_next_connection_id(1)
+	, m_pool(worker_threads) {
+	if (m_epoll_fd < 0 || m_wake_fd < 0) {
+		throw system_error("Failed to create server event loop");
+	}
+	epoll_event event{};
+	event.events = EPOLLIN;
+	event.data.u64 = WAKE_TAG;
+	epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_wake_fd, &event);
+}
+
+Server::~Server() {
+	// Workers post completions to the wake fd, so they must finish before it closes
+	m_pool.wait_for_tasks();
+	for (auto &[_, connection] : m_connections) {
+		close(connection.fd);
+	}
+	for (int fd : m_listen_fds) {
+		close(fd);
+	}
+	for (const auto &path : m_unix_paths) {
+		unlink(path.c_str());
+	}
+	close(m_wake_fd);
+	close(m_epoll_fd);
+}
+
+uint16_t Server::listen_tcp(uint16_t port, const std::string &address) {
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		throw system_error("Failed to create TCP socket");
+	}
+	int reuse = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	sockaddr_in addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+		close(fd);
+		throw std::runtime_error("Invalid listen address: " + address);
+	}
+	if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+		listen(fd, SOMAXCONN) < 0) {
+		close(fd);
+		throw system_error("Failed to listen on " + address + ":" + std::to_string(port));
+	}
+
+	socklen_t addr_size = sizeof(addr);
+	getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &addr_size);
+	add_listener(fd);
+	return ntohs(addr.sin_port);
+}
+
+void Server::listen_unix(const std::string &path) {
+	sockaddr_un addr{};
+	if (path.size() >= sizeof(addr.sun_path)) {
+		throw std::runtime_error("Unix socket path too long: " + path);
+	}
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		throw system_error("Failed to create Unix socket");
+	}
+
+	addr.sun_family = AF_UNIX;
+	std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+	unlink(path.c_str());
+	if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+		listen(fd, SOMAXCONN) < 0) {
+		close(fd);
+		throw system_error("Failed to listen on " + path);
+	}
+	m_unix_paths.push_back(path);
+	add_listener(fd);
+}
+
+void Server::add_listener(int fd) {
+	epoll_event event{};
+	event.events = EPOLLIN;
+	event.data.u64 = LISTENER_TAG | m_listen_fds.size();
+	m_listen_fds.push_back(fd);
+	epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+void Server::stop() {
+	m_stopping = true;
+	uint64_t one = 1;
+	[[maybe_unused]] auto written = write(m_wake_fd, &one, sizeof(one));
+}
+
+void Server::run() {
+	std::vector<epoll_event> events(MAX_EVENTS);
+	while (!m_stopping) {
+		int count = epoll_wait(m_epoll_fd, events.data(), MAX_EVENTS, -1);
+		if (count < 0) {
+			if (errno == EINTR)
+				continue;
+			throw system_error("epoll_wait failed");
+		}
+
+		for (int i{0}; i < count; i++) {
+			const uint64_t tag = events[i].data.u64;
+			const uint32_t ready = events[i].events;
+			if (tag == WAKE_TAG) {
+				uint64_t wakeups;
+				[[maybe_unused]] auto read_bytes = read(m_wake_fd, &wakeups, sizeof(wakeups));
+				continue;
+			}
+			if (tag & LISTENER_TAG) {
+				accept_connections(m_listen_fds[tag & ~LISTENER_TAG]);
+				continue;
+			}
+
+			auto it = m_connections.find(tag);
+			if (it == m_connections.end())
+				continue;
+			auto &connection = it->second;
+			if ((ready & (EPOLLERR | EPOLLHUP)) && !(ready & EPOLLIN)) {
+				close_connection(tag);
+				continue;
+			}
+			if (ready & EPOLLIN) {
+				read_from(tag, connection);
+				continue;
+			}
+			if (ready & EPOLLOUT) {
+				flush(connection);
+				update_interest(tag, connection);
+			}
+		}
+
+		drain_completions();
+	}
+	m_pool.wait_for_tasks();
+}
+
+void Server::accept_connections(int listen_fd) {
+	while (true) {
+		int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {
+			// EAGAIN once the backlog is empty; other errors only affect that client
+			return;
+		}
+		// Fails harmlessly on Unix sockets
+		int no_delay = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+
+		uint64_t connection_id = m_next_connection_id++;
+		auto &connection = m_connections.emplace(connection_id, Connection{fd}).first->second;
+		connection.events = EPOLLIN;
+		epoll_event event{};
+		event.events = connection.events;
+		event.data.u64 = connection_id;
+		epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+	}
+}
+
+void Server::read_from(uint64_t connection_id, Connection &connection) {
+	TSDB_TRACE_SPAN("server.read");
+	// Stop at a full buffer; the rest stays in the socket until dispatched requests make room
+	while (connection.in.size() < MAX_INPUT_BYTES) {
+		size_t used = connection.in.size();
+		size_t block = std::min(READ_BLOCK_BYTES, MAX_INPUT_BYTES - used);
+		connection.in.resize(used + block);
+		ssize_t received = recv(connection.fd, connection.in.data() + used, block, 0);
+		connection.in.resize(used + std::max<ssize_t>(received, 0));
+		if (received > 0)
+			continue;
+		if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		// Peer closed (or failed). Requests already read are abandoned with the connection.
+		close_connection(connection_id);
+		return;
+	}
+	dispatch_requests(connection_id, connection);
+}
+
+void Server::dispatch_requests(uint64_t connection_id, Connection &connection) {
+	size_t offset{0};
+	while (connection.in_flight < Config::SERVER_MAX_PIPELINE &&
+		   connection.in.size() - offset >= sizeof(protocol::FrameHeader)) {
+		protocol::FrameHeader header;
+		std::memcpy(&header, connection.in.data() + offset, sizeof(header));
+		if (header.length > protocol::MAX_PAYLOAD_BYTES) {
+			close_connection(connection_id);
+			return;
+		}
+		if (connection.in.size() - offset - sizeof(header) < header.length)
+			break;
+
+		const char *payload = connection.in.data() + offset + sizeof(header);
+		std::vector<char> request(payload, payload + header.length);
+		offset += sizeof(header) + header.length;
+
+		uint64_t seq = connection.next_seq++;
+		connection.in_flight++;
+		m_pool.enqueue_detach([this, connection_id, seq, header, request = std::move(request)]() {
+			auto frame = handle(header.request_id, header.code, request.data(), request.size());
+			{
+				std::lock_guard<std::mutex> lock(m_completions_mutex);
+				m_completions.push_back(Completion{connection_id, seq, std::move(frame)});
+			}
+			uint64_t one = 1;
+			[[maybe_unused]] auto written = write(m_wake_fd, &one, sizeof(one));
+		});
+	}
+	connection.in.erase(connection.in.begin(), connection.in.begin() + offset);
+	update_interest(connection_id, connection);
+}
+
+void Server::drain_completions() {
+	std::vector<Completion> completions{};
+	{
+		std::lock_guard<std::mutex> lock(m_completions_mutex);
+		completions.swap(m_completions);
+	}
+	if (completions.empty())
+		return;
+
+	std::vector<uint64_t> touched{};
+	for (auto &completion : completions) {
+		auto it = m_connections.find(completion.connection_id);
+		if (it == m_connections.end())
+			continue; // Closed while the request ran
+		it->second.ready.emplace(completion.seq, std::move(completion.frame));
+		it->second.in_flight--;
+		touched.push_back(completion.connection_id);
+	}
+	std::sort(touched.begin(), touched.end());
+	touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+
+	for (uint64_t connection_id : touched) {
+		auto &connection = m_connections.at(connection_id);
+		// Responses leave in request order; everything ready goes out in one write
+		auto next = connection.ready.begin();
+		while (next != connection.ready.end() && next->first == connection.next_send_seq) {
+			connection.out.insert(connection.out.end(), next->second.begin(), next->second.end());
+			next = connection.ready.erase(next);
+			connection.next_send_seq++;
+		}
+		if (!flush(connection)) {
+			close_connection(connection_id);
+			continue;
+		}
+		// Requests held back by the pipeline limit can go now
+		dispatch_requests(connection_id, connection);
+	}
+}
+
+bool Server::flush(Connection &connection) {
+	TSDB_TRACE_SPAN("server.write");
+	while (connection.out_offset < connection.out.size()) {
+		ssize_t sent = send(connection.fd, connection.out.data() + connection.out_offset,
+							connection.out.size() - connection.out_offset, MSG_NOSIGNAL);
+		if (sent > 0) {
+			connection.out_offset += static_cast<size_t>(sent);
+		} else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			return true; // The rest goes when the socket is writable again
+		} else {
+			return false;
+		}
+	}
+	connection.out.clear();
+	connection.out_offset = 0;
+	return true;
+}
+
+void Server::update_interest(uint64_t connection_id, Connection &connection) {
+	// Stop reading while the pipeline is full so a fast client cannot queue unbounded work
+	uint32_t events{0};
+	if (connection.in_flight < Config::SERVER_MAX_PIPELINE)
+		events |= EPOLLIN;
+	if (!connection.out.empty())
+		events |= EPOLLOUT;
+	if (events == connection.events)
+		return;
+
+	connection.events = events;
+	epoll_event event{};
+	event.events = events;
+	event.data.u64 = connection_id;
+	epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, connection.fd, &event);
+}
+
+void Server::close_connection(uint64_t connection_id) {
+	auto it = m_connections.find(connection_id);
+	if (it == m_connections.end())
+		return;
+	epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+	close(it->second.fd);
+	m_connections.erase(it);
+}
+
+std::vector<char> Server::handle(uint32_t request_id, uint8_t opcode, const char *payload,
+								 size_t size) {
+	TSDB_TRACE_SPAN("server.request");
+	std::vector<char> frame{};
+	try {
+		protocol::Reader reader(payload, size);
+		size_t frame_offset =
+			protocol::begin_frame(frame, request_id, static_cast<uint8_t>(protocol::Status::Ok));
+		protocol::Writer writer(frame);
+
+		switch (static_cast<protocol::Opcode>(opcode)) {
+		case protocol::Opcode::CreateTable: {
+			auto name = reader.get_string();
+			auto config = reader.get_config();
+			m_db.create_table(name, config);
+			break;
+		}
+		case protocol::Opcode::ListTables: {
+			auto names = m_db.get_table_names();
+			writer.put(static_cast<uint32_t>(names.size()));
+			for (const auto &name : names) {
+				writer.put_string(name);
+			}
+			break;
+		}
+		case protocol::Opcode::Insert: {
+			auto name = reader.get_string();
+			m_db.insert(name, reader.get_points());
+			break;
+		}
+		case protocol::Opcode::Query: {
+			auto name = reader.get_string();
+			auto query = reader.get_query();
+			if (!m_db.has_table(name)) {
+				throw std::runtime_error("Table not found: " + name);
+			}
+			auto points = m_db.query(name, query);
+			if (points.size() > protocol::MAX_RESPONSE_POINTS) {
+				throw std::runtime_error("Query result exceeds " +
+										 std::to_string(protocol::MAX_RESPONSE_POINTS) +
+										 " points, narrow the range or downsample");
+			}
+			writer.put_points(points);
+			break;
+		}
+		case protocol::Opcode::Quantiles: {
+			auto name = reader.get_string();
+			auto range = reader.get_range();
+			std::vector<double> qs(reader.get_count(sizeof(double)));
+			for (auto &q : qs) {
+				q = reader.get<double>();
+			}
+			if (!m_db.has_table(name)) {
+				throw std::runtime_error("Table not found: " + name);
+			}
+			auto results = m_db.quantiles(name, range, qs);
+			writer.put(static_cast<uint32_t>(results.size()));
+			for (double value : results) {
+				writer.put(value);
+			}
+			break;
+		}
+		default:
+			throw std::runtime_error("Unknown opcode " + std::to_string(opcode));
+		}
+		protocol::end_frame(frame, frame_offset);
+	} catch (const std::exception &e) {
+		frame.clear();
+		size_t frame_offset =
+			protocol::begin_frame(frame, request_id, static_cast<uint8_t>(protocol::Status::Error));
+		protocol::Writer(frame).put_string(e.what());
+		protocol::end_frame(frame, frame_offset);
+	}
+	return frame;
+}
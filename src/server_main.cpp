@@ -0,0 +1,67 @@
+#include <csignal>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "config.h"
+#include "db.h"
+#include "server.h"
+
+namespace {
+Server *running_server = nullptr;
+
+void handle_signal(int) {
+	if (running_server)
+		running_server->stop();
+}
+} // namespace
+
+// tsdb_server [--port=N] [--unix=PATH] [--data=DIR] [--threads=N]
+int main(int argc, char *argv[]) {
+	long port = 7070;
+	std::string unix_path{};
+	std::string data_path = "tmp/tsdb";
+	size_t threads = Config::SERVER_WORKER_THREADS;
+
+	for (int i{1}; i < argc; i++) {
+		std::string_view arg(argv[i]);
+		auto value = [&](std::string_view flag) { return std::string(arg.substr(flag.size())); };
+		if (arg.starts_with("--port=")) {
+			port = std::stol(value("--port="));
+		} else if (arg.starts_with("--unix=")) {
+			unix_path = value("--unix=");
+		} else if (arg.starts_with("--data=")) {
+			data_path = value("--data=");
+		} else if (arg.starts_with("--threads=")) {
+			threads = std::stoul(value("--threads="));
+		} else {
+			std::cerr << "Unknown argument: " << arg << '\n';
+			return 1;
+		}
+	}
+
+	DataBase db{"db1", data_path};
+	Server server(db, threads);
+	try {
+		// --port=-1 serves the Unix socket only
+		if (port >= 0) {
+			auto bound = server.listen_tcp(static_cast<uint16_t>(port));
+			std::cout << "Listening on 127.0.0.1:" << bound << '\n';
+		}
+		if (!unix_path.empty()) {
+			server.listen_unix(unix_path);
+			std::cout << "Listening on " << unix_path << '\n';
+		}
+	} catch (const std::exception &e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+
+	running_server = &server;
+	std::signal(SIGINT, handle_signal);
+	std::signal(SIGTERM, handle_signal);
+	server.run();
+	running_server = nullptr;
+	return 0;
+}
@@ -0,0 +1,192 @@
+#include "sketch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+// Magnitudes below this are counted as zero
+constexpr double MIN_INDEXABLE_VALUE = 1e-9;
+
+void write_store(std::ostream &file, int32_t offset, const std::vector<uint64_t> &counts) {
+	size_t num_bins = counts.size();
+	file.write(reinterpret_cast<const char *>(&offset), sizeof(offset));
+	file.write(reinterpret_cast<const char *>(&num_bins), sizeof(num_bins));
+	file.write(reinterpret_cast<const char *>(counts.data()), num_bins * sizeof(uint64_t));
+}
+
+void read_store(std::istream &file, int32_t &offset, std::vector<uint64_t> &counts) {
+	size_t num_bins;
+	file.read(reinterpret_cast<char *>(&offset), sizeof(offset));
+	file.read(reinterpret_cast<char *>(&num_bins), sizeof(num_bins));
+	if (file.fail()) {
+		throw std::runtime_error("Failed to read sketch bins");
+	}
+	// Stores never hold more bins, so a larger count is a corrupt file
+	if (num_bins > Config::SKETCH_MAX_BINS) {
+		throw std::runtime_error("Corrupt sketch: " + std::to_string(num_bins) + " bins");
+	}
+	counts.resize(num_bins);
+	file.read(reinterpret_cast<char *>(counts.data()), num_bins * sizeof(uint64_t));
+}
+} // namespace
+
+QuantileSketch::QuantileSketch(double relative_accuracy)
+	: m_relative_accuracy(relative_accuracy),
+	  m_gamma((1 + relative_accuracy) / (1 - relative_accuracy)), m_log_gamma(std::log(m_gamma)),
+	  m_count(0), m_zero_count(0) {
+	if (relative_accuracy <= 0 || relative_accuracy >= 1) {
+		throw std::invalid_argument("Sketch relative accuracy must be in (0, 1).");
+	}
+}
+
+int32_t QuantileSketch::index_of(double magnitude) const {
+	return static_cast<int32_t>(std::ceil(std::log(magnitude) / m_log_gamma));
+}
+
+double QuantileSketch::value_of(int32_t index) const {
+	// Midpoint (in relative terms) of the bin (gamma^(i-1), gamma^i]
+	return 2 * std::pow(m_gamma, index) / (m_gamma + 1);
+}
+
+void QuantileSketch::Store::add(int32_t index, uint64_t count) {
+	if (m_counts.empty()) {
+		m_offset = index;
+		m_counts.push_back(count);
+		return;
+	}
+	// Only the SKETCH_MAX_BINS bins up to the highest are kept; lower indexes count in the
+	// lowest kept bin, trading accuracy at the small magnitudes for bounded memory
+	const auto max_bins = static_cast<int32_t>(Config::SKETCH_MAX_BINS);
+	const int32_t top = m_offset + static_cast<int32_t>(m_counts.size()) - 1;
+	const int32_t lowest = std::max(index, top) - (max_bins - 1);
+	index = std::max(index, lowest);
+	if (m_offset < lowest) {
+		collapse_below(lowest);
+	}
+
+	if (index < m_offset) {
+		m_counts.insert(m_counts.begin(), static_cast<size_t>(m_offset - index), 0);
+		m_offset = index;
+	} else if (index >= m_offset + static_cast<int32_t>(m_counts.size())) {
+		m_counts.resize(static_cast<size_t>(index - m_offset) + 1, 0);
+	}
+	m_counts[static_cast<size_t>(index - m_offset)] += count;
+}
+
+void QuantileSketch::Store::collapse_below(int32_t lowest) {
+	const size_t folded = std::min(m_counts.size(), static_cast<size_t>(lowest - m_offset));
+	uint64_t total{0};
+	for (size_t i{0}; i < folded; i++) {
+		total += m_counts[i];
+	}
+	m_counts.erase(m_counts.begin(), m_counts.begin() + static_cast<std::ptrdiff_t>(folded));
+	if (m_counts.empty()) {
+		m_counts.push_back(0);
+	}
+	m_offset = lowest;
+	m_counts.front() += total;
+}
+
+void QuantileSketch::Store::merge(const Store &other) {
+	if (other.m_counts.empty()) {
+		return;
+	}
+	// The top first, so bins that collapse are folded once rather than as the store grows
+	add(other.m_offset + static_cast<int32_t>(other.m_counts.size()) - 1, 0);
+	for (size_t i{0}; i < other.m_counts.size(); i++) {
+		if (other.m_counts[i] != 0) {
+			add(other.m_offset + static_cast<int32_t>(i), other.m_counts[i]);
+		}
+	}
+}
+
+void QuantileSketch::add(double value) {
+	// Infinities have no bin
+	if (!std::isfinite(value)) {
+		return;
+	}
+	m_count++;
+	if (value > MIN_INDEXABLE_VALUE) {
+		m_positive.add(index_of(value));
+	} else if (value < -MIN_INDEXABLE_VALUE) {
+		m_negative.add(index_of(-value));
+	} else {
+		m_zero_count++;
+	}
+}
+
+void QuantileSketch::merge(const QuantileSketch &other) {
+	if (other.m_relative_accuracy != m_relative_accuracy) {
+		throw std::invalid_argument("Cannot merge sketches with different accuracies.");
+	}
+	m_count += other.m_count;
+	m_zero_count += other.m_zero_count;
+	m_positive.merge(other.m_positive);
+	m_negative.merge(other.m_negative);
+}
+
+double QuantileSketch::quantile(double q) const {
+	if (empty()) {
+		return std::numeric_limits<double>::quiet_NaN();
+	}
+
+	const double rank = std::clamp(q, 0.0, 1.0) * static_cast<double>(m_count - 1);
+	uint64_t seen{0};
+
+	// Most negative values sit in the highest negative bins
+	for (size_t i{m_negative.m_counts.size()}; i > 0; i--) {
+		seen += m_negative.m_counts[i - 1];
+		if (static_cast<double>(seen) > rank) {
+			return -value_of(m_negative.m_offset + static_cast<int32_t>(i - 1));
+		}
+	}
+
+	seen += m_zero_count;
+	if (static_cast<double>(seen) > rank) {
+		return 0.0;
+	}
+
+	for (size_t i{0}; i < m_positive.m_counts.size(); i++) {
+		seen += m_positive.m_counts[i];
+		if (static_cast<double>(seen) > rank) {
+			return value_of(m_positive.m_offset + static_cast<int32_t>(i));
+		}
+	}
+	return value_of(m_positive.m_offset + static_cast<int32_t>(m_positive.m_counts.size()) - 1);
+}
+
+void QuantileSketch::write(std::ostream &file) const {
+	file.write(reinterpret_cast<const char *>(&m_relative_accuracy), sizeof(m_relative_accuracy));
+	file.write(reinterpret_cast<const char *>(&m_count), sizeof(m_count));
+	file.write(reinterpret_cast<const char *>(&m_zero_count), sizeof(m_zero_count));
+	write_store(file, m_positive.m_offset, m_positive.m_counts);
+	write_store(file, m_negative.m_offset, m_negative.m_counts);
+	if (file.fail()) {
+		throw std::runtime_error("Failed to write sketch");
+	}
+}
+
+QuantileSketch QuantileSketch::read(std::istream &file) {
+	double relative_accuracy;
+	file.read(reinterpret_cast<char *>(&relative_accuracy), sizeof(relative_accuracy));
+	if (file.fail()) {
+		throw std::runtime_error("Failed to read sketch header");
+	}
+
+	QuantileSketch sketch(relative_accuracy);
+	file.read(reinterpret_cast<char *>(&sketch.m_count), sizeof(sketch.m_count));
+	file.read(reinterpret_cast<char *>(&sketch.m_zero_count), sizeof(sketch.m_zero_count));
+	read_store(file, sketch.m_positive.m_offset, sketch.m_positive.m_counts);
+	read_store(file, sketch.m_negative.m_offset, sketch.m_negative.m_counts);
+	if (file.fail()) {
+		throw std::runtime_error("Failed to read sketch");
+	}
+	return sketch;
+}
@@ -1,98 +1,868 @@
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cmath>
 #include <cstddef>
 #include <future>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <memory>
 #include <mutex>
-#include <thread_pool/thread_pool.h>
+#include <stdexcept>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include "chunk.h"
 #include "chunkfile.h"
 #include "datapoint.h"
+#include "downsample.h"
+#include "fill.h"
 #include "query.h"
+#include "result_cache.h"
+#include "sketch.h"
 #include "table.h"
+#include "trace.h"
 #include "tree.h"
-std::vector<DataPoint> Table::query(const Query &q) {
+#include "window.h"
+
+namespace {
+// Pins each chunk's visible rows; null chunks give empty snapshots so results stay aligned
+std::vector<ChunkSnapshot> snapshot_chunks(const std::vector<std::shared_ptr<Chunk>> &chunks) {
+	std::vector<ChunkSnapshot> snapshots{};
+	snapshots.reserve(chunks.size());
+	for (const auto &chunk : chunks) {
+		snapshots.push_back(chunk ? chunk->snapshot() : ChunkSnapshot());
+	}
+	return snapshots;
+}
+} // namespace
+
+std::vector<DataPoint> Table::query(const Query &q, QueryStats *stats) {
+	TSDB_TRACE_SPAN("table.query");
+	QueryStats query_stats{};
+	PhaseTimer timer{};
+	auto results = run_query(q, query_stats);
+	query_stats.rows_returned = results.size();
+	query_stats.total_ns = timer.lap();
+
+	m_metrics.m_query_latency.record(query_stats.total_ns);
+	if (stats) {
+		*stats = query_stats;
+	}
+	return results;
+}
+
+std::vector<DataPoint> Table::run_query(const Query &q, QueryStats &stats) {
+	if (q.m_newest_first && q.m_limit > 0) {
+		return query_latest(q, &stats);
+	}
+
+	if (q.m_window.function != WindowFunction::None) {
+		// Sequential by nature: each result depends on the window state of the points before it
+		window::Evaluator evaluator(q.m_window);
+		stream_query_chunks(q, stats, [&](const ChunkSnapshot &chunk) {
+			evaluator.add(chunk, q.m_time_range, q.m_predicate);
+		});
+		return evaluator.finish();
+	}
+	if (q.m_fill != FillStrategy::None) {
+		const TimeRange &range = q.m_time_range;
+		// Gaps at the range edges are bridged from the chunks' own rows either side of it, else
+		// from the metadata of the neighbouring chunks
+		std::optional<DataPoint> before{};
+		if (q.m_fill != FillStrategy::Null) {
+			before = point_before(range.start_ts, q.m_predicate);
+		}
+		const TimeDelta step = q.m_fill_step != 0 ? q.m_fill_step : m_config.min_resolution_secs;
+		fill::Grid grid(range, q.m_predicate, q.m_fill, step, before);
+		stream_query_chunks(q, stats, [&](const ChunkSnapshot &chunk) { grid.add(chunk); });
+		if (q.m_fill == FillStrategy::Linear && !grid.has_after()) {
+			return grid.finish(point_after(range.end_ts, q.m_predicate));
+		}
+		return grid.finish();
+	}
+
+	if (q.m_downsample != DownsampleMethod::None) {
+		// Buckets are laid over the data's extent in the range, read from the chunk metadata
+		const TimeRange &range = q.m_time_range;
+		const TimeRange extent = data_extent(range).value_or(range);
+		if (q.m_downsample == DownsampleMethod::MinMax) {
+			downsample::MinMax min_max(extent, q.m_predicate, q.m_target_points, m_query_pool);
+			stream_query_chunks(q, stats, [&](const ChunkSnapshot &chunk) { min_max.add(chunk, range); });
+			return min_max.finish();
+		}
+		downsample::Lttb lttb(extent, q.m_predicate, q.m_target_points, m_query_pool);
+		stream_query_chunks(q, stats, [&](const ChunkSnapshot &chunk) { lttb.add(chunk, range); });
+		// A second pass picks the points, once the bucket averages are known
+		if (lttb.selection_needed()) {
+			stream_query_chunks(q, stats, [&](const ChunkSnapshot &chunk) { lttb.select(chunk, range); });
+		}
+		return lttb.finish();
+	}
+
+	PhaseTimer timer{};
 	auto chunk_files = m_chunk_tree.range_query(q.m_time_range);
-	std::vector<std::shared_ptr<Chunk>> chunks;
-	chunks.reserve(chunk_files.size());
-	std::vector<std::future<std::shared_ptr<Chunk>>> chunk_futures{};
-	chunk_futures.reserve(chunk_files.size());
+	stats.chunks_matched = chunk_files.size();
+	// Skip chunks whose value bounds rule out the predicate without loading them
+	std::erase_if(chunk_files, [&](const std::shared_ptr<ChunkFile> &file) {
+		const auto &metadata = file->get_metadata();
+		return !q.m_predicate.may_match(metadata.min_value, metadata.max_value);
+	});
+	stats.chunks_skipped = stats.chunks_matched - chunk_files.size();
+	stats.lookup_ns = timer.lap();
 
-	dp::thread_pool pool(6);
-	for (const auto &file : chunk_files) {
+	// Filters each chunk as it arrives and applies sorted and limit flags at the end
+	return pipeline::sync_wait(filter_chunks(q, std::move(chunk_files), stats));
+}
+
+void Table::stream_query_chunks(const Query &q, QueryStats &stats,
+							   const std::function<void(const ChunkSnapshot &)> &visit) {
+	PhaseTimer timer{};
+	auto cursor = open_chunks(q.m_time_range, stats, q.m_predicate);
+	stats.lookup_ns = timer.lap();
+	while (auto chunk = pipeline::sync_wait(cursor->next())) {
+		stats.load_ns += timer.lap();
+		auto [first, last] = chunk->get_index_range(q.m_time_range);
+		stats.rows_scanned += last - first;
+		visit(*chunk);
+		stats.filter_ns += timer.lap();
+	}
+}
+
+std::shared_ptr<Table::ChunkStream>
+Table::stream_chunks(const std::vector<std::shared_ptr<ChunkFile>> &chunk_files,
+					 QueryStats &stats) {
+	auto stream = std::make_shared<ChunkStream>();
+	feed_chunks(stream, chunk_files, 0, chunk_files.size(), stats, true);
+	return stream;
+}
+
+void Table::feed_chunks(const std::shared_ptr<ChunkStream> &stream,
+						const std::vector<std::shared_ptr<ChunkFile>> &chunk_files, size_t begin,
+						size_t end, QueryStats &stats, bool cache_loads) {
+	std::vector<std::pair<size_t, std::shared_ptr<ChunkFile>>> batch{};
+	const auto launch = [&]() {
+		auto task = [this, stream, batch, cache_loads]() {
+			TSDB_TRACE_SPAN("query.load_batch");
+			std::vector<std::shared_ptr<Chunk>> chunks(batch.size());
+			size_t bytes_read{0};
+			std::exception_ptr error{};
+			if (!stream->cancelled) {
+				try {
+					std::vector<const ChunkFile *> files{};
+					for (const auto &[_, file] : batch) {
+						files.push_back(file.get());
+					}
+					auto loaded = ChunkFile::load_batch(files, &bytes_read);
+					for (size_t j{0}; j < batch.size(); j++) {
+						Timestamp key = batch[j].second->get_metadata().chunk_range.end_ts;
+						chunks[j] = cache_loads ? put_chunk_in_cache(key, std::move(loaded[j]))
+												: std::move(loaded[j]);
+					}
+				} catch (...) {
+					error = std::current_exception();
+				}
+			}
+			// The last push may resume and complete the query, so nothing is touched after it
+			for (size_t j{0}; j < batch.size(); j++) {
+				stream->channel.push({batch[j].first, std::move(chunks[j]), j == 0 ? bytes_read : 0, error});
+			}
+		};
+		m_query_pool.submit(std::move(task));
+		batch.clear();
+	};
+
+	size_t misses{0};
+	for (size_t i{begin}; i < end; i++) {
+		const auto &file = chunk_files[i];
+		Timestamp key = file->get_metadata().chunk_range.end_ts;
+		if (auto chunk = get_chunk_from_cache(key)) {
+			m_metrics.m_cache_hits++;
+			stream->channel.push({i, std::move(chunk), 0, nullptr});
+			continue;
+		}
+		m_metrics.m_cache_misses++;
+		misses++;
+		if (auto live = find_live_chunk(key)) {
+			stream->channel.push({i, cache_loads ? put_chunk_in_cache(key, std::move(live)) : std::move(live), 0, nullptr});
+			continue;
+		}
+		batch.emplace_back(i, file);
+		if (batch.size() == ::Config::QUERY_LOAD_BATCH_CHUNKS) {
+			launch();
+		}
+	}
+	if (!batch.empty()) {
+		launch();
+	}
+
+	stats.cache_misses += misses;
+	stats.cache_hits += end - begin - misses;
+}
+
+pipeline::Task<std::vector<DataPoint>>
+Table::filter_chunks(const Query &q, std::vector<std::shared_ptr<ChunkFile>> chunk_files,
+					 QueryStats &stats) {
+	PhaseTimer timer{};
+	auto stream = stream_chunks(chunk_files, stats);
+
+	// Matches are kept per lookup slot, so results do not depend on the order loads finish
+	std::vector<std::shared_ptr<const std::vector<DataPoint>>> matches(chunk_files.size());
+	std::vector<bool> arrived(chunk_files.size(), false);
+	size_t prefix{0};
+	size_t prefix_rows{0};
+	std::exception_ptr error{};
+	// Every chunk is awaited, even after cancelling, so no load outlives the query
+	for (size_t received{0}; received < chunk_files.size(); received++) {
+		stats.filter_ns += timer.lap();
+		StreamedChunk item = co_await stream->channel.next();
+		stats.load_ns += timer.lap();
+		stats.bytes_read += item.bytes_read;
+		if (item.error) {
+			error = error ? error : item.error;
+			stream->cancelled = true;
+		}
+		if (stream->cancelled)
+			continue;
+
+		// Every chunk is read through one snapshot for the whole query
+		const ChunkSnapshot chunk = item.chunk->snapshot();
+		if (!chunk.empty() && chunk.may_match(q.m_predicate)) {
+			matches[item.slot] = scan_chunk(chunk, chunk_files[item.slot]->get_metadata(), q, stats);
+		}
+		// Once the leading chunks hold the limit, the rest cannot contribute
+		arrived[item.slot] = true;
+		for (; prefix < arrived.size() && arrived[prefix]; prefix++) {
+			prefix_rows += matches[prefix] ? matches[prefix]->size() : 0;
+		}
+		if (q.m_limit > 0 && prefix_rows >= q.m_limit) {
+			stream->cancelled = true;
+		}
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+	stats.filter_ns += timer.lap();
+
+	TSDB_TRACE_SPAN("query.sort");
+	size_t total{0};
+	for (const auto &chunk_matches : matches) {
+		total += chunk_matches ? chunk_matches->size() : 0;
+	}
+	std::vector<DataPoint> results{};
+	results.reserve(q.m_limit > 0 ? std::min(q.m_limit, total) : total);
+	for (const auto &chunk_matches : matches) {
+		if (!chunk_matches)
+			continue;
+		results.insert(results.end(), chunk_matches->begin(), chunk_matches->end());
+		if (q.m_limit > 0 && results.size() >= q.m_limit) {
+			break;
+		}
+	}
+	if (q.m_sorted) {
+		std::sort(results.begin(), results.end(),
+				  [](const DataPoint &a, const DataPoint &b) { return a.ts < b.ts; });
+	}
+	if (q.m_limit > 0 && results.size() > q.m_limit) {
+		results.resize(q.m_limit);
+	}
+	stats.sort_ns = timer.lap();
+	co_return results;
+}
+
+std::shared_ptr<const std::vector<DataPoint>>
+Table::scan_chunk(const ChunkSnapshot &chunk, const ChunkMetadata &metadata, const Query &q,
+				  QueryStats &stats) {
+	const TimeRange &range = q.m_time_range;
+	const ResultCache::Key key(metadata.chunk_id, std::max(range.start_ts, metadata.chunk_range.start_ts),
+							   q.m_predicate);
+	const Timestamp end_ts = std::min(range.end_ts, metadata.chunk_range.end_ts);
+	auto [first, last] = chunk.get_index_range(range);
+
+	// Rows only ever append within a buffer, so an entry for the same buffer, no more rows and
+	// no later end holds the matches of a prefix of this scan
+	size_t from{first};
+	std::shared_ptr<const std::vector<DataPoint>> cached{};
+	if (auto partial = m_result_cache.find(key)) {
+		if (partial->generation == chunk.generation() && partial->size <= chunk.size() &&
+			partial->end_ts <= end_ts) {
+			from = std::max(first, partial->last);
+			cached = std::move(partial->matches);
+			stats.partials_reused++;
+		}
+	}
+	stats.rows_scanned += last - std::min(from, last);
+
+	std::vector<DataPoint> fresh{};
+	const size_t morsel = ::Config::SCAN_MORSEL_ROWS;
+	const size_t morsels = (last - std::min(from, last) + morsel - 1) / morsel;
+	if (morsels <= 1) {
+		fresh = chunk.get_rows(from, last, q.m_predicate);
+	} else {
+		// A large chunk is scanned in morsels shared with idle workers, then merged in row order
+		std::vector<std::vector<DataPoint>> parts(morsels);
+		m_query_pool.parallel_for(morsels, [&](size_t m) {
+			const size_t begin = from + m * morsel;
+			parts[m] = chunk.get_rows(begin, std::min(last, begin + morsel), q.m_predicate);
+		});
+		for (const auto &part : parts) {
+			fresh.insert(fresh.end(), part.begin(), part.end());
+		}
+	}
+
+	std::shared_ptr<const std::vector<DataPoint>> matches{};
+	if (cached && fresh.empty()) {
+		matches = std::move(cached);
+	} else if (cached) {
+		auto combined = std::make_shared<std::vector<DataPoint>>();
+		combined->reserve(cached->size() + fresh.size());
+		combined->insert(combined->end(), cached->begin(), cached->end());
+		combined->insert(combined->end(), fresh.begin(), fresh.end());
+		matches = std::move(combined);
+	} else {
+		matches = std::make_shared<const std::vector<DataPoint>>(std::move(fresh));
+	}
+	m_result_cache.store(key, {chunk.generation(), chunk.size(), end_ts, last, matches});
+	return matches;
+}
+
+std::vector<std::vector<DataPoint>> Table::query_batch(const std::vector<Query> &queries) {
+	TSDB_TRACE_SPAN("table.query_batch");
+	std::vector<std::vector<DataPoint>> results(queries.size());
+
+	// Plan: the union of chunk files needed by every range query, each listed once
+	std::map<Timestamp, size_t> slot_by_key{};
+	std::vector<std::shared_ptr<ChunkFile>> chunk_files{};
+	std::vector<std::vector<size_t>> slots_per_query(queries.size());
+	for (size_t i{0}; i < queries.size(); i++) {
+		const auto &q = queries[i];
+		if (q.m_newest_first && q.m_limit > 0) {
+			results[i] = query_latest(q);
+			continue;
+		}
+
+		for (auto &file : m_chunk_tree.range_query(q.m_time_range)) {
+			const auto &metadata = file->get_metadata();
+			if (!q.m_predicate.may_match(metadata.min_value, metadata.max_value))
+				continue;
+			auto [it, inserted] = slot_by_key.emplace(metadata.chunk_range.end_ts, chunk_files.size());
+			if (inserted) {
+				chunk_files.push_back(std::move(file));
+			}
+			slots_per_query[i].push_back(it->second);
+		}
+	}
+
+	// Load and pin each chunk once, so every query in the batch sees the same rows
+	auto chunks = snapshot_chunks(fetch_chunks(chunk_files));
+
+	// Fan results out to each query in parallel
+	std::vector<std::pair<size_t, std::future<std::vector<DataPoint>>>> result_futures{};
+	for (size_t i{0}; i < queries.size(); i++) {
+		const auto &q = queries[i];
+		if (q.m_newest_first && q.m_limit > 0) {
+			continue;
+		}
+		auto task = [this, &q, &chunks, &slots = slots_per_query[i]]() {
+			std::vector<ChunkSnapshot> query_chunks{};
+			query_chunks.reserve(slots.size());
+			for (size_t slot : slots) {
+				query_chunks.push_back(chunks[slot]);
+			}
+			return gather_data_from_chunks(query_chunks, q.m_time_range, q.m_predicate,
+										   q.m_sorted, q.m_limit);
+		};
+		result_futures.emplace_back(i, m_query_pool.enqueue(task));
+	}
+
+	for (auto &[i, future] : result_futures) {
+		results[i] = future.get();
+	}
+	return results;
+}
+
+ColumnQueryResult Table::query_columns(const Query &q, const std::vector<size_t> &columns,
+									   QueryStats *stats) {
+	TSDB_TRACE_SPAN("table.query_columns");
+	if (columns.empty()) {
+		throw std::invalid_argument("No value columns requested");
+	}
+	for (size_t column : columns) {
+		if (column >= m_config.value_columns) {
+			throw std::invalid_argument("Value column " + std::to_string(column) + " out of range");
+		}
+	}
+
+	QueryStats query_stats{};
+	PhaseTimer timer{};
+	auto chunk_files = m_chunk_tree.range_query(q.m_time_range);
+	std::sort(chunk_files.begin(), chunk_files.end(), [](const auto &a, const auto &b) {
+		return a->get_metadata().chunk_range.start_ts < b->get_metadata().chunk_range.start_ts;
+	});
+	query_stats.chunks_matched = chunk_files.size();
+	// Stored bounds describe column 0, so they only prune when it is the filtered column
+	if (columns[0] == 0) {
+		std::erase_if(chunk_files, [&](const std::shared_ptr<ChunkFile> &file) {
+			const auto &metadata = file->get_metadata();
+			return !q.m_predicate.may_match(metadata.min_value, metadata.max_value);
+		});
+	}
+	query_stats.chunks_skipped = query_stats.chunks_matched - chunk_files.size();
+	query_stats.lookup_ns = timer.lap();
+
+	// Chunks in memory already hold every column. The rest read only the projection and are
+	// not cached, since a partial chunk cannot serve other queries.
+	std::vector<ChunkSnapshot> chunks(chunk_files.size());
+	std::vector<bool> projected(chunk_files.size(), false);
+	std::vector<std::pair<size_t, std::future<ChunkSnapshot>>> chunk_futures{};
+	std::atomic<size_t> bytes_read{0};
+	for (size_t i{0}; i < chunk_files.size(); i++) {
+		const auto &file = chunk_files[i];
+		if (auto chunk = find_live_chunk(file->get_metadata().chunk_range.end_ts)) {
+			chunks[i] = chunk->snapshot();
+			m_metrics.m_cache_hits++;
+			continue;
+		}
+		m_metrics.m_cache_misses++;
+		projected[i] = true;
+		auto task = [file, &columns, &bytes_read]() {
+			size_t chunk_bytes{0};
+			auto snapshot = file->load_columns(columns, &chunk_bytes);
+			bytes_read += chunk_bytes;
+			return snapshot;
+		};
+		chunk_futures.emplace_back(i, m_query_pool.enqueue(task));
+	}
+	for (auto &[i, future] : chunk_futures) {
+		chunks[i] = future.get();
+	}
+	query_stats.cache_misses = chunk_futures.size();
+	query_stats.cache_hits = chunk_files.size() - chunk_futures.size();
+	query_stats.bytes_read = bytes_read;
+	query_stats.load_ns = timer.lap();
+
+	ColumnQueryResult result{};
+	result.columns.resize(columns.size());
+	const size_t limit = q.m_limit > 0 ? q.m_limit : std::numeric_limits<size_t>::max();
+	for (size_t i{0}; i < chunks.size() && result.timestamps.size() < limit; i++) {
+		const auto &chunk = chunks[i];
+		auto [first, last] = chunk.get_index_range(q.m_time_range);
+		query_stats.rows_scanned += last - first;
+		// Loaded chunks hold the projection in order, chunks in memory hold every column
+		auto source = [&](size_t k) { return projected[i] ? k : columns[k]; };
+		visit_value_type(chunk.value_type(), [&]<typename T>(std::type_identity<T>) {
+			const T *filtered = chunk.template column<T>(source(0));
+			for (size_t row{first}; row < last && result.timestamps.size() < limit; row++) {
+				if (!chunk.has_row(row) || !q.m_predicate.matches(ValueTraits<T>::load(filtered[row])))
+					continue;
+				result.timestamps.push_back(chunk.timestamp_at(row));
+				for (size_t k{0}; k < columns.size(); k++) {
+					result.columns[k].push_back(
+						ValueTraits<T>::load(chunk.template column<T>(source(k))[row]));
+				}
+			}
+		});
+	}
+	query_stats.filter_ns = timer.lap();
+	query_stats.rows_returned = result.timestamps.size();
+	query_stats.total_ns = query_stats.lookup_ns + query_stats.load_ns + query_stats.filter_ns;
+
+	m_metrics.m_query_latency.record(query_stats.total_ns);
+	if (stats) {
+		*stats = query_stats;
+	}
+	return result;
+}
+
+std::vector<double> Table::quantiles(const TimeRange &range, const std::vector<double> &qs) {
+	TSDB_TRACE_SPAN("table.quantiles");
+	QuantileSketch merged{};
+	std::vector<std::shared_ptr<ChunkFile>> edge_files{};
+	std::vector<std::future<QuantileSketch>> sketch_futures{};
+
+	for (auto &file : m_chunk_tree.range_query(range)) {
+		const auto &chunk_range = file->get_metadata().chunk_range;
+		// Chunk ranges are half open
+		bool covered =
+			range.start_ts <= chunk_range.start_ts && chunk_range.end_ts - 1 <= range.end_ts;
+		if (!covered) {
+			edge_files.push_back(std::move(file));
+		} else if (auto chunk = get_chunk_from_cache(chunk_range.end_ts)) {
+			merged.merge(chunk->sketch());
+		} else {
+			sketch_futures.push_back(m_query_pool.enqueue([file]() { return file->load_sketch(); }));
+		}
+	}
+
+	for (const auto &chunk : snapshot_chunks(fetch_chunks(edge_files))) {
+		auto [first, last] = chunk.get_index_range(range);
+		for (size_t i{first}; i < last; i++) {
+			if (chunk.has_row(i)) {
+				merged.add(chunk.value_at(i));
+			}
+		}
+	}
+
+	for (auto &future : sketch_futures) {
+		merged.merge(future.get());
+	}
+
+	std::vector<double> results{};
+	results.reserve(qs.size());
+	for (double q : qs) {
+		results.push_back(merged.quantile(q));
+	}
+	return results;
+}
+
+std::vector<std::shared_ptr<Chunk>>
+Table::fetch_chunks(const std::vector<std::shared_ptr<ChunkFile>> &chunk_files,
+					QueryStats *stats) {
+	std::vector<std::shared_ptr<Chunk>> chunks(chunk_files.size());
+	// Every miss without an in-memory copy is read in one batch of asynchronous reads
+	std::vector<size_t> to_load{};
+	std::vector<const ChunkFile *> load_files{};
+	size_t misses{0};
+
+	for (size_t i{0}; i < chunk_files.size(); i++) {
+		const auto &file = chunk_files[i];
 		Timestamp key = file->get_metadata().chunk_range.end_ts;
 		auto chunk = get_chunk_from_cache(key);
 
 		if (chunk) {
-			chunks.push_back(chunk);
+			chunks[i] = std::move(chunk);
 			m_metrics.m_cache_hits++;
+			continue;
+		}
+		m_metrics.m_cache_misses++;
+		misses++;
+		if (auto live = find_live_chunk(key)) {
+			chunks[i] = put_chunk_in_cache(key, std::move(live));
 		} else {
-			m_metrics.m_cache_misses++;
-			auto task = [this, file, key]() {
-				auto chunk = file->load();
-				if (chunk) {
-					std::shared_ptr<Chunk> shared_chunk(std::move(chunk));
-					put_chunk_in_cache(key, shared_chunk);
-					return shared_chunk;
-				}
-				return std::shared_ptr<Chunk>();
-			};
-			chunk_futures.push_back(pool.enqueue(task));
+			to_load.push_back(i);
+			load_files.push_back(file.get());
 		}
 	}
 
-	for (auto &future : chunk_futures) {
-		auto chunk = future.get();
-		if (chunk) {
-			chunks.push_back(chunk);
+	size_t bytes_read{0};
+	if (!load_files.empty()) {
+		auto loaded = ChunkFile::load_batch(load_files, &bytes_read);
+		for (size_t j{0}; j < to_load.size(); j++) {
+			const size_t i = to_load[j];
+			Timestamp key = chunk_files[i]->get_metadata().chunk_range.end_ts;
+			chunks[i] = put_chunk_in_cache(key, std::move(loaded[j]));
 		}
 	}
 
-	// Pass sorted and limit flags
-	auto results = gather_data_from_chunks(chunks, q.m_time_range, q.m_sorted, q.m_limit);
+	if (stats) {
+		stats->cache_misses += misses;
+		stats->cache_hits += chunk_files.size() - misses;
+		stats->bytes_read += bytes_read;
+	}
+	return chunks;
+}
+
+std::vector<DataPoint> Table::query_latest(const Query &q, QueryStats *stats) {
+	TSDB_TRACE_SPAN("table.query_latest");
+	std::vector<DataPoint> results{};
+	results.reserve(std::min(q.m_limit, m_row_count.load()));
+	if (m_row_count == 0) {
+		return results;
+	}
+
+	// Serve from the write-behind head chunk first; it is usually all that is needed
+	Timestamp head_key = get_partition_key(m_latest_point_ts);
+	bool head_served{false};
+	if (auto head = get_chunk_from_cache(head_key)) {
+		head_served = true;
+		m_metrics.m_cache_hits++;
+		if (stats) {
+			stats->cache_hits++;
+		}
+		auto snapshot = head->snapshot();
+		if (q.m_time_range.overlaps(snapshot.get_range()) && snapshot.may_match(q.m_predicate)) {
+			snapshot.get_latest_in_range(q.m_time_range, q.m_predicate, q.m_limit, results);
+		}
+	}
+
+	if (results.size() >= q.m_limit) {
+		return results;
+	}
+
+	m_chunk_tree.reverse_range_query(
+		q.m_time_range, [&](const std::shared_ptr<ChunkFile> &file) {
+			const auto &metadata = file->get_metadata();
+			Timestamp key = metadata.chunk_range.end_ts;
+			// An evicted head chunk is loaded like any other
+			if (head_served && key == head_key) {
+				return true;
+			}
+			if (stats) {
+				stats->chunks_matched++;
+			}
+
+			auto chunk = get_chunk_from_cache(key);
+			if (chunk) {
+				m_metrics.m_cache_hits++;
+				if (stats) {
+					stats->cache_hits++;
+				}
+			} else {
+				if (!q.m_predicate.may_match(metadata.min_value, metadata.max_value)) {
+					if (stats) {
+						stats->chunks_skipped++;
+					}
+					return true;
+				}
+				m_metrics.m_cache_misses++;
+				size_t bytes_read{0};
+				chunk = load_chunk(*file, &bytes_read);
+				if (stats) {
+					stats->cache_misses++;
+					stats->bytes_read += bytes_read;
+				}
+				chunk = put_chunk_in_cache(key, std::move(chunk));
+			}
+
+			chunk->snapshot().get_latest_in_range(q.m_time_range, q.m_predicate, q.m_limit,
+												  results);
+			return results.size() < q.m_limit;
+		});
 	return results;
 }
+
 void Table::insert(const std::vector<DataPoint> &points) {
+	TSDB_TRACE_SPAN("table.insert");
+	PhaseTimer timer{};
+	// The chunk being written; each chunk is finalised once this call moves past it
+	std::shared_ptr<Chunk> current{};
 	for (const auto &point : points) {
-		insert_single(point);
-		if (m_chunks_to_save.size() == m_config.max_chunks_to_save)
-			flush_chunks();
+		insert_single(point, current);
+	}
+	// Perist the last chunk written
+	if (current) {
+		finalise_single(std::move(current));
 	}
-	// Perist remaining from cache
-	finalise_all();
 	flush_chunks();
+	m_metrics.m_insert_latency.record(timer.lap());
 }
 
-void Table::insert_single(const DataPoint &point) {
-	assert(point.ts > m_latest_point_ts && "Does not support historical data implementation");
-	m_latest_point_ts = point.ts;
+void Table::insert_rows(const std::vector<Timestamp> &timestamps,
+						const std::vector<std::vector<double>> &columns) {
+	TSDB_TRACE_SPAN("table.insert_rows");
+	if (columns.size() != m_config.value_columns) {
+		throw std::invalid_argument("Expected " + std::to_string(m_config.value_columns) +
+									" value columns, got " + std::to_string(columns.size()));
+	}
+	for (const auto &column : columns) {
+		if (column.size() != timestamps.size()) {
+			throw std::invalid_argument("Value column length does not match timestamps");
+		}
+	}
 
-	Timestamp partition_key = get_partition_key(point.ts);
-	auto chunk = get_chunk_from_cache(partition_key);
+	PhaseTimer timer{};
+	std::shared_ptr<Chunk> current{};
+	std::vector<double> row(columns.size());
+	for (size_t i{0}; i < timestamps.size(); i++) {
+		advance_to(timestamps[i], current);
+		for (size_t c{0}; c < columns.size(); c++) {
+			row[c] = columns[c][i];
+		}
+		current->append_row(timestamps[i], row.data());
+		m_row_count++;
+	}
+	if (current) {
+		finalise_single(std::move(current));
+	}
+	flush_chunks();
+	m_metrics.m_insert_latency.record(timer.lap());
+}
+
+void Table::insert_single(const DataPoint &point, std::shared_ptr<Chunk> &current) {
+	advance_to(point.ts, current);
+	current->append(point);
+	m_row_count++;
+}
+
+void Table::advance_to(Timestamp ts, std::shared_ptr<Chunk> &current) {
+	Timestamp latest = m_latest_point_ts.load();
+	while (ts > latest && !m_latest_point_ts.compare_exchange_weak(latest, ts)) {
+	}
 
+	// Consecutive points nearly always share a partition, so only look up the chunk on a change
+	if (current && ts >= current->get_range().start_ts && ts < current->get_range().end_ts) {
+		return;
+	}
+	if (current) {
+		finalise_single(std::move(current));
+	}
+	current = get_or_create_chunk(get_partition(ts));
+}
+
+std::shared_ptr<Chunk> Table::get_or_create_chunk(const TimeRange &partition) {
+	const Timestamp partition_key = partition.end_ts;
 	// Uses write behind cache -- first written to cache
-	if (chunk != nullptr) {
-		chunk->append(point);
+	if (auto chunk = get_chunk_from_cache(partition_key)) {
+		return chunk;
+	}
+
+	// Late points can land in a partition that has already been evicted
+	std::shared_ptr<Chunk> chunk{};
+	if (auto chunk_file = m_chunk_tree.find(partition_key)) {
+		chunk = load_chunk(*chunk_file);
 	} else {
-		auto new_chunk = create_chunk(partition_key);
-		new_chunk->append(point);
-		put_chunk_in_cache(partition_key, std::move(new_chunk));
+		chunk = create_chunk(partition);
 	}
-	m_row_count++;
+	// Another writer may have cached the partition meanwhile; both then use its copy
+	return put_chunk_in_cache(partition_key, std::move(chunk));
+}
+
+void Table::scan(const TimeRange &range,
+				 const std::function<void(const ChunkSnapshot &)> &visit) {
+	TSDB_TRACE_SPAN("table.scan");
+	auto chunk_files = m_chunk_tree.range_query(range);
+	std::sort(chunk_files.begin(), chunk_files.end(), [](const auto &a, const auto &b) {
+		return a->get_metadata().chunk_range.start_ts < b->get_metadata().chunk_range.start_ts;
+	});
+	for (const auto &file : chunk_files) {
+		if (auto chunk = load_chunk(*file)) {
+			visit(chunk->snapshot());
+		}
+	}
+}
+
+std::unique_ptr<Table::ChunkCursor> Table::open_chunks(const TimeRange &range, QueryStats &stats,
+														const ValuePredicate &predicate) {
+	auto chunk_files = m_chunk_tree.range_query(range);
+	stats.chunks_matched += chunk_files.size();
+	std::erase_if(chunk_files, [&](const std::shared_ptr<ChunkFile> &file) {
+		const auto &metadata = file->get_metadata();
+		if (predicate.may_match(metadata.min_value, metadata.max_value)) {
+			return false;
+		}
+		stats.chunks_skipped++;
+		return true;
+	});
+	std::sort(chunk_files.begin(), chunk_files.end(), [](const auto &a, const auto &b) {
+		return a->get_metadata().chunk_range.start_ts < b->get_metadata().chunk_range.start_ts;
+	});
+	return std::unique_ptr<ChunkCursor>(new ChunkCursor(*this, std::move(chunk_files), stats));
+}
+
+Table::ChunkCursor::ChunkCursor(Table &table, std::vector<std::shared_ptr<ChunkFile>> &&chunk_files,
+								QueryStats &stats)
+	: m_table(table), m_chunk_files(std::move(chunk_files)),
+	  m_stream(std::make_shared<ChunkStream>()), m_stats(stats),
+	  m_arrived(m_chunk_files.size()), m_ready(m_chunk_files.size()) {}
+
+Table::ChunkCursor::~ChunkCursor() {
+	m_stream->cancelled = true;
+}
+
+pipeline::Task<std::optional<ChunkSnapshot>> Table::ChunkCursor::next() {
+	while (m_next < m_ready.size()) {
+		// Tops the loads up in whole batches once less than a batch is left in flight
+		if (m_launched < m_ready.size() && m_launched <= m_next + ::Config::QUERY_LOAD_BATCH_CHUNKS) {
+			const size_t end = std::min(m_ready.size(), m_next + ::Config::CURSOR_PREFETCH_CHUNKS);
+			m_table.feed_chunks(m_stream, m_chunk_files, m_launched, end, m_stats, false);
+			m_launched = end;
+		}
+		if (m_ready[m_next]) {
+			auto chunk = std::move(m_arrived[m_next++]);
+			if (chunk) {
+				co_return chunk->snapshot();
+			}
+			continue;
+		}
+		StreamedChunk item = co_await m_stream->channel.next();
+		m_stats.bytes_read += item.bytes_read;
+		if (item.error) {
+			std::rethrow_exception(item.error);
+		}
+		m_arrived[item.slot] = std::move(item.chunk);
+		m_ready[item.slot] = true;
+	}
+	co_return std::nullopt;
+}
+
+std::optional<TimeRange> Table::data_extent(const TimeRange &range) const {
+	std::optional<TimeRange> extent{};
+	for (const auto &file : m_chunk_tree.range_query(range)) {
+		const auto &metadata = file->get_metadata();
+		if (metadata.first_ts > metadata.last_ts) {
+			continue;
+		}
+		const Timestamp start_ts = std::max(range.start_ts, metadata.first_ts);
+		const Timestamp end_ts = std::min(range.end_ts, metadata.last_ts);
+		if (start_ts > end_ts) {
+			continue;
+		}
+		extent = extent ? TimeRange(std::min(extent->start_ts, start_ts), std::max(extent->end_ts, end_ts))
+						: TimeRange(start_ts, end_ts);
+	}
+	return extent;
+}
+
+std::optional<DataPoint> Table::point_before(Timestamp ts, const ValuePredicate &predicate) const {
+	std::optional<DataPoint> found{};
+	m_chunk_tree.reverse_range_query(TimeRange(TIMESTAMP_MIN, ts), [&](const auto &file) {
+		const auto &metadata = file->get_metadata();
+		// Empty chunks, and the chunk holding `ts`, whose rows the caller has seen, are skipped
+		if (metadata.first_ts > metadata.last_ts || metadata.last_ts >= ts) {
+			return true;
+		}
+		if (predicate.matches(metadata.last_value)) {
+			found = DataPoint{metadata.last_ts, metadata.last_value};
+		}
+		return false;
+	});
+	return found;
+}
+
+std::optional<DataPoint> Table::point_after(Timestamp ts, const ValuePredicate &predicate) const {
+	if (ts >= TIMESTAMP_MAX) {
+		return std::nullopt;
+	}
+	auto chunk_files = m_chunk_tree.range_query(TimeRange(ts + 1, TIMESTAMP_MAX));
+	std::sort(chunk_files.begin(), chunk_files.end(), [](const auto &a, const auto &b) {
+		return a->get_metadata().chunk_range.start_ts < b->get_metadata().chunk_range.start_ts;
+	});
+	for (const auto &file : chunk_files) {
+		const auto &metadata = file->get_metadata();
+		if (metadata.first_ts > metadata.last_ts || metadata.first_ts <= ts) {
+			continue;
+		}
+		if (predicate.matches(metadata.first_value)) {
+			return DataPoint{metadata.first_ts, metadata.first_value};
+		}
+		break;
+	}
+	return std::nullopt;
+}
+
+std::shared_ptr<Chunk> Table::load_chunk(const ChunkFile &chunk_file, size_t *bytes_read) {
+	if (auto chunk = find_live_chunk(chunk_file.get_metadata().chunk_range.end_ts)) {
+		return chunk;
+	}
+	return chunk_file.load(bytes_read);
 }
 
 std::vector<DataPoint>
-Table::gather_data_from_chunks(const std::vector<std::shared_ptr<Chunk>> &chunks,
-							   const TimeRange &query_range, bool sorted, size_t limit) const {
+Table::gather_data_from_chunks(const std::vector<ChunkSnapshot> &chunks,
+							   const TimeRange &query_range, const ValuePredicate &predicate,
+							   bool sorted, size_t limit, QueryStats *stats) const {
+	TSDB_TRACE_SPAN("query.gather");
+	PhaseTimer timer{};
 	std::vector<DataPoint> results{};
 
-	// Reserve space - account for limit if specified
-	size_t reserve_size =
-		query_range.duration() / (m_config.chunk_size_secs / m_config.min_resolution_secs);
+	// Reserve space - bounded by the rows actually held and the limit if specified
+	size_t reserve_size{0};
+	for (const auto &chunk : chunks) {
+		reserve_size += chunk.size();
+	}
 	if (limit > 0 && limit < reserve_size) {
 		results.reserve(limit);
 	} else {
@@ -101,7 +871,13 @@ Table::gather_data_from_chunks(const std::vector<std::shared_ptr<Chunk>> &chunks
 
 	// Gather data from all chunks
 	for (const auto &chunk : chunks) {
-		auto data = chunk->get_data_in_range(query_range);
+		if (chunk.empty() || !chunk.may_match(predicate))
+			continue;
+		if (stats) {
+			auto [first, last] = chunk.get_index_range(query_range);
+			stats->rows_scanned += last - first;
+		}
+		auto data = chunk.get_data_in_range(query_range, predicate);
 		results.insert(results.end(), data.begin(), data.end());
 
 		// Early exit if we've reached the limit
@@ -111,8 +887,13 @@ Table::gather_data_from_chunks(const std::vector<std::shared_ptr<Chunk>> &chunks
 		}
 	}
 
+	if (stats) {
+		stats->filter_ns = timer.lap();
+	}
+
 	// Sort by timestamp if requested
 	if (sorted) {
+		TSDB_TRACE_SPAN("query.sort");
 		std::sort(results.begin(), results.end(),
 				  [](const DataPoint &a, const DataPoint &b) { return a.ts < b.ts; });
 	}
@@ -122,12 +903,81 @@ Table::gather_data_from_chunks(const std::vector<std::shared_ptr<Chunk>> &chunks
 		results.resize(limit);
 	}
 
+	if (stats) {
+		stats->sort_ns = timer.lap();
+	}
+
 	return results;
 }
 
-Timestamp Table::get_partition_key(Timestamp timestamp) {
-	Timestamp current_chunk_start = timestamp - (timestamp % m_config.chunk_size_secs);
-	return current_chunk_start + m_config.chunk_size_secs;
+TimeRange Table::get_partition(Timestamp timestamp) {
+	if (m_config.target_chunk_bytes == 0) {
+		Timestamp current_chunk_start = timestamp - (timestamp % m_config.chunk_size_secs);
+		return TimeRange{current_chunk_start, current_chunk_start + m_config.chunk_size_secs};
+	}
+
+	std::lock_guard<std::mutex> lock(m_partition_mutex);
+	// The first partition ending after the timestamp holds it if it also starts at or before it
+	auto next = m_partitions.upper_bound(timestamp);
+	if (next != m_partitions.end() && next->second <= timestamp) {
+		return TimeRange{next->second, next->first};
+	}
+
+	// A new partition aligned to its width, clipped so it never overlaps its neighbours
+	const TimeDelta width = adaptive_chunk_width();
+	Timestamp start = timestamp - ((timestamp % width) + width) % width;
+	Timestamp end = start + width;
+	if (next != m_partitions.end()) {
+		end = std::min(end, next->second);
+	}
+	if (next != m_partitions.begin()) {
+		start = std::max(start, std::prev(next)->first);
+	}
+	m_partitions.emplace(end, start);
+	return TimeRange{start, end};
+}
+
+TimeDelta Table::adaptive_chunk_width() const {
+	const TimeDelta base = m_config.chunk_size_secs;
+	const double rate = m_rows_per_sec.load();
+	if (rate <= 0) {
+		return base;
+	}
+	const size_t row_bytes = value_size(m_config.value_type) * m_config.value_columns +
+							 (m_config.regular_series ? 0 : sizeof(Timestamp));
+	const double target_secs =
+		static_cast<double>(m_config.target_chunk_bytes) / static_cast<double>(row_bytes) / rate;
+
+	// Widths stay multiples of the resolution so regular series slots stay on the grid
+	TimeDelta width = base;
+	for (int shift{0}; shift < ::Config::CHUNK_WIDTH_MAX_SHIFT && 2.0 * width <= target_secs; shift++) {
+		width *= 2;
+	}
+	for (int shift{0}; shift < ::Config::CHUNK_WIDTH_MAX_SHIFT && width > target_secs && width % 2 == 0 &&
+					   (width / 2) % m_config.min_resolution_secs == 0;
+		 shift++) {
+		width /= 2;
+	}
+	return width;
+}
+
+void Table::observe_rate(const TimeRange &partition) {
+	// Samples the partition ending where this one starts, which is usually just completed
+	size_t rows{0};
+	TimeDelta width{0};
+	if (auto previous = find_live_chunk(partition.start_ts)) {
+		rows = previous->size();
+		width = previous->get_range().duration();
+	} else if (auto file = m_chunk_tree.find(partition.start_ts)) {
+		rows = file->get_metadata().row_count;
+		width = file->get_metadata().chunk_range.duration();
+	}
+	if (width <= 0) {
+		return;
+	}
+	const double sample = static_cast<double>(rows) / static_cast<double>(width);
+	const double rate = m_rows_per_sec.load();
+	m_rows_per_sec = rate > 0 ? (rate + sample) / 2 : sample;
 }
 
 ChunkId Table::generate_chunk_id() {
@@ -135,16 +985,32 @@ ChunkId Table::generate_chunk_id() {
 	return next_id++;
 }
 
-std::shared_ptr<Chunk> Table::create_chunk(Timestamp partition_key) {
+std::shared_ptr<Chunk> Table::create_chunk(const TimeRange &partition) {
+	observe_rate(partition);
+	// Sized from the observed rate so sparse series reserve little; bursts grow the rows. A
+	// regular series always has a row per slot.
+	size_t capacity = m_config.chunk_capacity;
+	if (const double rate = m_rows_per_sec.load(); rate > 0 && !m_config.regular_series) {
+		capacity = std::max(::Config::CHUNK_MIN_CAPACITY,
+							static_cast<size_t>(std::ceil(rate * static_cast<double>(partition.duration()) *
+														  ::Config::CHUNK_CAPACITY_HEADROOM)));
+	}
+
 	auto id = generate_chunk_id();
 	auto chunk =
-		std::make_shared<Chunk>(TimeRange{partition_key - m_config.chunk_size_secs, partition_key},
-								id, m_config.chunk_capacity);
+		std::make_shared<Chunk>(partition, id, capacity, m_config.value_type,
+								m_config.value_columns,
+								m_config.regular_series ? m_config.min_resolution_secs : 0);
 	return chunk;
 }
 
 std::shared_ptr<Chunk> Table::get_chunk_from_cache(Timestamp partition_key) {
-	std::lock_guard<std::mutex> lock(m_cache_mutex);
+	TSDB_TRACE_SPAN("cache.get");
+	std::unique_lock<std::mutex> lock(m_cache_mutex, std::defer_lock);
+	{
+		TSDB_TRACE_SPAN("cache.lock_wait");
+		lock.lock();
+	}
 	auto it = m_chunk_cache.find(partition_key);
 	if (it != m_chunk_cache.end()) {
 		m_chunk_cache_usage_list.erase(it->second.second);
@@ -155,62 +1021,114 @@ std::shared_ptr<Chunk> Table::get_chunk_from_cache(Timestamp partition_key) {
 	return nullptr;
 }
 
-void Table::put_chunk_in_cache(Timestamp partition_key, std::shared_ptr<Chunk> chunk) {
-	std::lock_guard<std::mutex> lock(m_cache_mutex);
+std::shared_ptr<Chunk> Table::put_chunk_in_cache(Timestamp partition_key,
+												 std::shared_ptr<Chunk> chunk) {
+	TSDB_TRACE_SPAN("cache.put");
+	std::shared_ptr<Chunk> evicted{};
+	{
+		std::unique_lock<std::mutex> lock(m_cache_mutex, std::defer_lock);
+		{
+			TSDB_TRACE_SPAN("cache.lock_wait");
+			lock.lock();
+		}
+
+		auto it = m_chunk_cache.find(partition_key);
+		if (it != m_chunk_cache.end()) {
+			m_chunk_cache_usage_list.erase(it->second.second);
+			m_chunk_cache_usage_list.push_front(partition_key);
+			it->second.second = m_chunk_cache_usage_list.begin();
+			return it->second.first;
+		}
+
+		// Prefer a copy still held elsewhere (e.g. awaiting its save) over the one given
+		auto &live = m_live_chunks[partition_key];
+		if (auto live_chunk = live.lock()) {
+			chunk = std::move(live_chunk);
+		} else {
+			live = chunk;
+		}
 
-	auto it = m_chunk_cache.find(partition_key);
-	if (it != m_chunk_cache.end()) {
-		m_chunk_cache_usage_list.erase(it->second.second);
-		m_chunk_cache_usage_list.push_front(partition_key);
-		it->second.second = m_chunk_cache_usage_list.begin();
-	} else {
 		if (m_chunk_cache.size() >= m_config.chunk_cache_size) {
 			Timestamp lru_key = m_chunk_cache_usage_list.back();
-			evict_from_cache(lru_key);
+			m_chunk_cache_usage_list.pop_back();
+			auto lru = m_chunk_cache.find(lru_key);
+			evicted = std::move(lru->second.first);
+			m_chunk_cache.erase(lru);
 		}
 		m_chunk_cache_usage_list.push_front(partition_key);
-		m_chunk_cache[partition_key] = {std::move(chunk), m_chunk_cache_usage_list.begin()};
+		m_chunk_cache[partition_key] = {chunk, m_chunk_cache_usage_list.begin()};
+
+		if (m_live_chunks.size() > 2 * m_config.chunk_cache_size + m_config.max_chunks_to_save) {
+			std::erase_if(m_live_chunks, [](const auto &entry) { return entry.second.expired(); });
+		}
+	}
+
+	// Finalising takes the flush and tree locks, so it runs after the cache lock is released
+	if (evicted) {
+		finalise_single(std::move(evicted));
 	}
+	return chunk;
 }
 
-void Table::evict_from_cache(Timestamp partition_key) {
-	auto it = m_chunk_cache.find(partition_key);
-	m_chunk_cache_usage_list.erase(it->second.second);
-	finalise_single(std::move(it->second.first));
-	m_chunk_cache.erase(it);
+std::shared_ptr<Chunk> Table::find_live_chunk(Timestamp partition_key) {
+	std::lock_guard<std::mutex> lock(m_cache_mutex);
+	auto it = m_live_chunks.find(partition_key);
+	return it != m_live_chunks.end() ? it->second.lock() : nullptr;
 }
 
 void Table::finalise_single(std::shared_ptr<Chunk> chunk) {
-	std::lock_guard<std::mutex> lock(m_flush_mutex);
-	auto chunk_file = std::make_shared<ChunkFile>(m_data_path, chunk->id(), chunk->get_range(),
-												  chunk->size(), chunk->capacity());
+	bool flush_due{false};
+	{
+		std::lock_guard<std::mutex> lock(m_flush_mutex);
+		auto chunk_file = std::make_shared<ChunkFile>(m_data_path, chunk->metadata());
 
-	// Insert into tree and get a reference to the stored ChunkFile
-	m_chunk_tree.insert(chunk->get_range(), chunk_file); // Insert the shared_ptr
+		// Insert into tree, replacing any entry indexed for this chunk with stale metadata
+		m_chunk_tree.insert(chunk->get_range(), chunk_file); // Insert the shared_ptr
 
-	// Store weak pointer to the ChunkFile along with the chunk
-	m_chunks_to_save.emplace_back(std::weak_ptr<ChunkFile>(chunk_file), std::move(chunk));
+		// Store weak pointer to the ChunkFile along with the chunk. A chunk already waiting to
+		// be saved keeps its one entry, now pointing at the file just indexed.
+		auto pending = std::find_if(m_chunks_to_save.begin(), m_chunks_to_save.end(),
+									[&](const auto &entry) { return entry.second == chunk; });
+		if (pending != m_chunks_to_save.end()) {
+			pending->first = chunk_file;
+		} else {
+			m_chunks_to_save.emplace_back(std::weak_ptr<ChunkFile>(chunk_file), std::move(chunk));
+		}
+		flush_due = m_chunks_to_save.size() >= m_config.max_chunks_to_save;
+	}
+	if (flush_due) {
+		flush_chunks();
+	}
 }
 
 void Table::finalise_all() {
-	for (auto [_, pair] : m_chunk_cache) {
-		finalise_single(std::move(pair.first));
+	std::vector<std::shared_ptr<Chunk>> chunks{};
+	{
+		std::lock_guard<std::mutex> lock(m_cache_mutex);
+		for (const auto &[_, entry] : m_chunk_cache) {
+			chunks.push_back(entry.first);
+		}
+	}
+	for (auto &chunk : chunks) {
+		finalise_single(std::move(chunk));
 	}
 }
 
 void Table::flush_chunks() {
-	for (auto &[chunk_file_weak, chunk] : m_chunks_to_save) {
-		finalise_single(chunk_file_weak, chunk);
+	TSDB_TRACE_SPAN("table.flush");
+	std::lock_guard<std::mutex> lock(m_flush_mutex);
+	// The files stay referenced until the batch is written
+	std::vector<std::shared_ptr<ChunkFile>> files{};
+	std::vector<std::pair<const ChunkFile *, const Chunk *>> batch{};
+	for (const auto &[chunk_file_weak, chunk] : m_chunks_to_save) {
+		if (auto chunk_file = chunk_file_weak.lock()) {
+			batch.emplace_back(chunk_file.get(), chunk.get());
+			files.push_back(std::move(chunk_file));
+		} else {
+			// the weak pointer has expired. Skip this chunk.
+			std::cerr << "Chunk file does not exist." << "\n";
+		}
 	}
+	ChunkFile::save_batch(batch);
 	m_chunks_to_save.clear();
 }
-
-void Table::finalise_single(std::weak_ptr<ChunkFile> chunk_file, std::shared_ptr<Chunk> chunk) {
-	std::lock_guard<std::mutex> lock(m_flush_mutex);
-	if (auto chunk_file_shared = chunk_file.lock()) {
-		chunk_file_shared->save(*chunk);
-	} else {
-		// the weak pointer has expired. Skip this chunk.
-		std::cerr << "Chunk file does not exist." << "\n";
-	}
-}
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "trace.h"
+#include "config.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace {
+
+// Each slot is a seqlock: `sequence` is odd while event i is being written and 2 * (i + 1) once
+// it is whole, so a reader can tell a torn or recycled slot from the event it expects
+struct Event
+{
+	std::atomic<uint64_t> sequence{0};
+	std::atomic<const char *> name{nullptr};
+	std::atomic<uint64_t> start_ns{0};
+	std::atomic<uint64_t> duration_ns{0};
+};
+
+// Single-writer ring buffer owned by one thread. Readers skip slots whose sequence changed while
+// they read them, so a concurrent dump is race free (if possibly missing in-flight events).
+struct ThreadBuffer
+{
+	explicit ThreadBuffer(uint64_t thread_id)
+		: thread_id(thread_id), events(std::make_unique<Event[]>(Config::TRACE_BUFFER_EVENTS)) {}
+
+	uint64_t thread_id;
+	std::atomic<uint64_t> head{0};
+	std::unique_ptr<Event[]> events;
+};
+
+// Buffers outlive their threads so pool workers that exit still appear in the dump
+struct Registry
+{
+	std::mutex mutex;
+	std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+	uint64_t next_thread_id{1};
+};
+
+Registry &registry() {
+	static Registry instance;
+	return instance;
+}
+
+ThreadBuffer &thread_buffer() {
+	thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+		auto &reg = registry();
+		std::lock_guard<std::mutex> lock(reg.mutex);
+		auto created = std::make_shared<ThreadBuffer>(reg.next_thread_id++);
+		reg.buffers.push_back(created);
+		return created;
+	}();
+	return *buffer;
+}
+
+const auto TRACE_EPOCH = std::chrono::steady_clock::now();
+
+} // namespace
+
+uint64_t trace::now_ns() {
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+									 std::chrono::steady_clock::now() - TRACE_EPOCH)
+									 .count());
+}
+
+void trace::record(const char *name, uint64_t start_ns, uint64_t duration_ns) {
+	auto &buffer = thread_buffer();
+	uint64_t head = buffer.head.load(std::memory_order_relaxed);
+	auto &event = buffer.events[head % Config::TRACE_BUFFER_EVENTS];
+	event.sequence.store(2 * head + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	event.name.store(name, std::memory_order_relaxed);
+	event.start_ns.store(start_ns, std::memory_order_relaxed);
+	event.duration_ns.store(duration_ns, std::memory_order_relaxed);
+	event.sequence.store(2 * head + 2, std::memory_order_release);
+	buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void trace::dump_chrome_json(std::ostream &out) {
+	std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+	{
+		auto &reg = registry();
+		std::lock_guard<std::mutex> lock(reg.mutex);
+		buffers = reg.buffers;
+	}
+
+	const auto flags = out.flags();
+	const auto precision = out.precision();
+	out << std::fixed << std::setprecision(3);
+	out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	bool first = true;
+	for (const auto &buffer : buffers) {
+		uint64_t head = buffer->head.load(std::memory_order_acquire);
+		uint64_t begin = head > Config::TRACE_BUFFER_EVENTS ? head - Config::TRACE_BUFFER_EVENTS : 0;
+		for (uint64_t i{begin}; i < head; i++) {
+			const auto &event = buffer->events[i % Config::TRACE_BUFFER_EVENTS];
+			const uint64_t sequence = event.sequence.load(std::memory_order_acquire);
+			if (sequence != 2 * i + 2) {
+				continue;
+			}
+			const char *name = event.name.load(std::memory_order_relaxed);
+			const uint64_t start_ns = event.start_ns.load(std::memory_order_relaxed);
+			const uint64_t duration_ns = event.duration_ns.load(std::memory_order_relaxed);
+			// A writer lapping the ring mid-read has bumped the sequence
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (event.sequence.load(std::memory_order_relaxed) != sequence) {
+				continue;
+			}
+			out << (first ? "" : ",") << "\n{\"name\":\"" << name
+				<< "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread_id
+				<< ",\"ts\":" << static_cast<double>(start_ns) / 1000
+				<< ",\"dur\":" << static_cast<double>(duration_ns) / 1000 << "}";
+			first = false;
+		}
+	}
+	out << "\n]}\n";
+	out.flags(flags);
+	out.precision(precision);
+}
+
+void trace::clear() {
+	auto &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	for (const auto &buffer : reg.buffers) {
+		for (size_t i{0}; i < Config::TRACE_BUFFER_EVENTS; i++) {
+			buffer->events[i].sequence.store(0, std::memory_order_relaxed);
+		}
+	}
+}
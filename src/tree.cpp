@@ -1,21 +1,131 @@
 #include "tree.h"
+#include "trace.h"
 #include "utils.h"
 
 #include <cassert>
+#include <algorithm>
 #include <cstddef>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <vector>
 
 std::vector<std::shared_ptr<ChunkFile>> ChunkTree::range_query(const TimeRange& range) const
 {
+	TSDB_TRACE_SPAN("index.lookup");
 	std::vector<std::shared_ptr<ChunkFile>> results{};
+	std::shared_lock<std::shared_mutex> lock(m_mutex);
 	gather_chunk_files_in_range(range, results);
 	return results;
 }
 
-void ChunkTree::insert(const TimeRange& range, std::shared_ptr<ChunkFile> chunk_file)
+std::shared_ptr<ChunkFile> ChunkTree::find(Timestamp end_ts) const
 {
+	std::shared_lock<std::shared_mutex> lock(m_mutex);
+	ChunkTreeNode* current = m_root.get();
+
+	while (!current->is_leaf())
+	{
+		size_t i{ 0 };
+		while (i < current->keys.size() && end_ts > current->keys[i])
+		{
+			i++;
+		}
+		current = std::get<std::unique_ptr<ChunkTreeNode>>(current->children[i]).get();
+	}
 
+	auto it = std::lower_bound(current->keys.begin(), current->keys.end(), end_ts);
+	if (it == current->keys.end() || *it != end_ts)
+	{
+		return nullptr;
+	}
+	return std::get<std::shared_ptr<ChunkFile>>(current->children[it - current->keys.begin()]);
+}
+
+void ChunkTree::reverse_range_query(
+	const TimeRange& range,
+	const std::function<bool(const std::shared_ptr<ChunkFile>&)>& visit
+) const
+{
+	// Files are copied out a page at a time and visited with the tree unlocked, so a slow
+	// visitor never holds up inserts
+	std::vector<std::shared_ptr<ChunkFile>> page{};
+	page.reserve(Config::REVERSE_SCAN_PAGE_SIZE);
+	TimeRange remaining = range;
+
+	while (true)
+	{
+		page.clear();
+		gather_chunk_files_in_reverse(remaining, Config::REVERSE_SCAN_PAGE_SIZE, page);
+		for (const auto& chunk : page)
+		{
+			if (!visit(chunk))
+			{
+				return;
+			}
+		}
+		if (page.size() < Config::REVERSE_SCAN_PAGE_SIZE)
+		{
+			return;
+		}
+
+		// Resume below the oldest chunk visited
+		Timestamp oldest_start = page.back()->get_metadata().chunk_range.start_ts;
+		if (oldest_start <= remaining.start_ts)
+		{
+			return;
+		}
+		remaining.end_ts = oldest_start - 1;
+	}
+}
+
+void ChunkTree::gather_chunk_files_in_reverse(
+	const TimeRange& range,
+	size_t max_files,
+	std::vector<std::shared_ptr<ChunkFile>>& results
+) const
+{
+	std::shared_lock<std::shared_mutex> lock(m_mutex);
+	ChunkTreeNode* current = m_root.get();
+
+	// Descend to the leaf holding the last chunk that can overlap the range. Subtrees right
+	// of the first key past the range end only hold chunks starting after it.
+	while (!current->is_leaf())
+	{
+		size_t i{ 0 };
+		while (i < current->keys.size() && range.end_ts >= current->keys[i])
+		{
+			i++;
+		}
+		current = std::get<std::unique_ptr<ChunkTreeNode>>(current->children[i]).get();
+	}
+
+	while (current != nullptr)
+	{
+		for (size_t i{ current->children.size() }; i > 0; i--)
+		{
+			const auto& chunk = std::get<std::shared_ptr<ChunkFile>>(current->children[i - 1]);
+			const auto& current_chunk_range = chunk->get_metadata().chunk_range;
+			if (range.overlaps(current_chunk_range))
+			{
+				results.push_back(chunk);
+				if (results.size() == max_files)
+				{
+					return;
+				}
+			}
+			else if (current_chunk_range.end_ts <= range.start_ts)
+			{
+				return;
+			}
+		}
+		current = current->prev_node;
+	}
+}
+
+void ChunkTree::insert(const TimeRange& range, std::shared_ptr<ChunkFile> chunk_file)
+{
+	std::unique_lock<std::shared_mutex> lock(m_mutex);
 	if (m_root->is_full())
 	{
 		auto old_root = std::move(m_root);
@@ -87,6 +197,11 @@ void ChunkTree::split(ChunkTreeNode* parent, size_t index)
 	if (child->is_leaf())
 	{
 		new_node->next_node = child->next_node;
+		new_node->prev_node = child;
+		if (child->next_node != nullptr)
+		{
+			child->next_node->prev_node = new_node.get();
+		}
 		child->next_node = new_node.get();
 	}
 
@@ -94,8 +209,9 @@ void ChunkTree::split(ChunkTreeNode* parent, size_t index)
 	parent->keys.insert(parent->keys.begin() + index, child->keys[mid_index]);
 	parent->children.insert(parent->children.begin() + index + 1, std::move(new_node));
 
-	// Cleanup original child
-	child->keys.erase(child->keys.begin() + mid_index, child->keys.end());
+	// Cleanup original child. Leaves keep one key per child, so the separator stays in the leaf
+	const size_t keys_kept = child->is_leaf() ? mid_index + 1 : mid_index;
+	child->keys.erase(child->keys.begin() + keys_kept, child->keys.end());
 	child->children.erase(child->children.begin() + mid_index + 1, child->children.end());
 }
 
@@ -115,6 +231,12 @@ void ChunkTree::insert_non_full(
 			auto it = std::lower_bound(node->keys.begin(), node->keys.end(), range.end_ts);
 			index = std::distance(node->keys.begin(), it);
 		}
+		// Chunks are keyed by end timestamp, so re-indexing a chunk replaces its old entry
+		if (index < node->keys.size() && node->keys[index] == range.end_ts)
+		{
+			node->children[index] = std::move(chunk_file);
+			return;
+		}
 		node->keys.insert(node->keys.begin() + index, range.end_ts);
 		
 		auto child_it = node->children.begin() + index;
@@ -122,8 +244,9 @@ void ChunkTree::insert_non_full(
 	}
 	else
 	{
+		// Descend by the key being inserted so leaves stay ordered by end timestamp
 		size_t i = 0;
-		while (i < node->keys.size() && range.start_ts > node->keys[i])
+		while (i < node->keys.size() && range.end_ts > node->keys[i])
 		{
 			i++;
 		}
@@ -131,7 +254,7 @@ void ChunkTree::insert_non_full(
 		if (child->is_full())
 		{
 			split(node, i);
-			if (range.start_ts > node->keys[i])
+			if (range.end_ts > node->keys[i])
 			{
 				i++;
 			}
@@ -0,0 +1,159 @@
+#include "window.h"
+#include "chunk.h"
+#include "config.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+window::MovingWindow::MovingWindow(size_t points, TimeDelta secs)
+	: m_max_points(secs > 0 ? 0 : points), m_secs(secs) {}
+
+void window::MovingWindow::push(const DataPoint &point) {
+	if (!m_points.empty()) {
+		const double previous = m_points.back().value;
+		// A counter that drops was reset, so all of its new value is increase
+		m_increase += point.value >= previous ? point.value - previous : point.value;
+	}
+	const Entry entry{m_seq++, point.ts, point.value, m_increase};
+	m_points.push_back(entry);
+	m_sum += point.value;
+	// Points the new one dominates can never be an extreme again
+	while (!m_min.empty() && m_min.back().value >= point.value) {
+		m_min.pop_back();
+	}
+	m_min.push_back(entry);
+	while (!m_max.empty() && m_max.back().value <= point.value) {
+		m_max.pop_back();
+	}
+	m_max.push_back(entry);
+
+	// The new point itself never expires, so none of the deques empties
+	while (expired(m_points.front(), entry)) {
+		m_sum -= m_points.front().value;
+		m_points.pop_front();
+	}
+	while (expired(m_min.front(), entry)) {
+		m_min.pop_front();
+	}
+	while (expired(m_max.front(), entry)) {
+		m_max.pop_front();
+	}
+}
+
+std::optional<double> window::MovingWindow::rate() const {
+	const Entry &oldest = m_points.front();
+	const Entry &newest = m_points.back();
+	if (newest.ts <= oldest.ts) {
+		return std::nullopt;
+	}
+	return (newest.increase - oldest.increase) / static_cast<double>(newest.ts - oldest.ts);
+}
+
+bool window::MovingWindow::expired(const Entry &entry, const Entry &newest) const {
+	return (m_max_points > 0 && newest.seq - entry.seq >= m_max_points) ||
+		   (m_secs > 0 && newest.ts - entry.ts >= m_secs);
+}
+
+namespace {
+Timestamp floor_div(Timestamp ts, TimeDelta step) {
+	return ts / step - (ts % step < 0 ? 1 : 0);
+}
+} // namespace
+
+namespace {
+// Rate without an extent compares each point with the previous one
+size_t window_points(const WindowSpec &spec) {
+	const bool moving =
+		spec.function == WindowFunction::MovingSum || spec.function == WindowFunction::MovingAvg ||
+		spec.function == WindowFunction::MovingMin || spec.function == WindowFunction::MovingMax;
+	if (moving && spec.points == 0 && spec.secs <= 0) {
+		throw std::invalid_argument("Moving window needs a point count or a duration");
+	}
+	return spec.points > 0 || spec.secs > 0 ? spec.points : 2;
+}
+} // namespace
+
+window::Evaluator::Evaluator(const WindowSpec &spec)
+	: m_spec(spec), m_window(window_points(spec), spec.secs) {}
+
+void window::Evaluator::emit(Timestamp ts, double value) {
+	if (m_spec.step <= 0) {
+		m_results.push_back(DataPoint{ts, value});
+		return;
+	}
+	const Timestamp bucket = floor_div(ts, m_spec.step);
+	if (m_held && bucket != m_held_bucket) {
+		m_results.push_back(*m_held);
+	}
+	m_held = DataPoint{ts, value};
+	m_held_bucket = bucket;
+}
+
+void window::Evaluator::push(const DataPoint &point) {
+	switch (m_spec.function) {
+	case WindowFunction::None:
+		emit(point.ts, point.value);
+		break;
+	case WindowFunction::MovingSum:
+		m_window.push(point);
+		emit(point.ts, m_window.sum());
+		break;
+	case WindowFunction::MovingAvg:
+		m_window.push(point);
+		emit(point.ts, m_window.sum() / static_cast<double>(m_window.size()));
+		break;
+	case WindowFunction::MovingMin:
+		m_window.push(point);
+		emit(point.ts, m_window.min());
+		break;
+	case WindowFunction::MovingMax:
+		m_window.push(point);
+		emit(point.ts, m_window.max());
+		break;
+	case WindowFunction::Rate:
+		m_window.push(point);
+		if (auto rate = m_window.rate()) {
+			emit(point.ts, *rate);
+		}
+		break;
+	case WindowFunction::Derivative:
+		if (m_previous && point.ts > m_previous->ts) {
+			emit(point.ts, (point.value - m_previous->value) /
+							   static_cast<double>(point.ts - m_previous->ts));
+		}
+		m_previous = point;
+		break;
+	case WindowFunction::CumulativeSum:
+		m_total += point.value;
+		emit(point.ts, m_total);
+		break;
+	}
+}
+
+void window::Evaluator::add(const ChunkSnapshot &chunk, const TimeRange &range,
+							const ValuePredicate &predicate) {
+	TSDB_TRACE_SPAN("window.chunk");
+	auto [first, last] = chunk.get_index_range(range);
+	if (m_spec.step <= 0) {
+		m_results.reserve(m_results.size() + (last - first));
+	}
+	// Read in morsels, so no more than one morsel of raw points is copied out at a time
+	for (size_t begin{first}; begin < last; begin += Config::SCAN_MORSEL_ROWS) {
+		const size_t end = std::min(last, begin + Config::SCAN_MORSEL_ROWS);
+		for (const auto &point : chunk.get_rows(begin, end, predicate)) {
+			push(point);
+		}
+	}
+}
+
+std::vector<DataPoint> window::Evaluator::finish() {
+	if (m_held) {
+		m_results.push_back(*m_held);
+		m_held.reset();
+	}
+	return std::move(m_results);
+}
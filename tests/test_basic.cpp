@@ -1,12 +1,40 @@
+#include "aio.h"
+#include "bulk.h"
+#include "chunk.h"
+#include "chunkfile.h"
+#include "codec.h"
+#include "client.h"
 #include "datapoint.h"
 #include "db.h"
+#include "executor.h"
+#include "ingest.h"
+#include "protocol.h"
 #include "query.h"
+#include "server.h"
+#include "sketch.h"
 #include "table.h"
+#include "trace.h"
 #include "utils.h"
 #include <ctime>
 #include <gtest/gtest.h>
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
 #include <limits>
+#include <map>
+#include <numeric>
+#include <regex>
+#include <set>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 class DatabaseTest : public ::testing::Test {
   protected:
@@ -192,4 +220,1571 @@ TEST_F(DatabaseTest, RowCountAfterInsert) {
 
     const Table* table = db.get_table("test_table");
     EXPECT_GE(table->rows(), 3);
-}
\ No newline at end of file
+}
+// Test query with a value predicate
+TEST_F(DatabaseTest, QueryWithValuePredicate) {
+    std::vector<DataPoint> points;
+    for (int i = 0; i < 100; ++i) {
+        points.push_back({static_cast<Timestamp>(i * 300), static_cast<double>(i)});
+    }
+    points.push_back({100 * 300, std::numeric_limits<double>::quiet_NaN()});
+    db.insert("test_table", points);
+
+    Query above(TimeRange(), true, 0, ValuePredicate::greater(89.5));
+    std::vector<DataPoint> results = db.query("test_table", above);
+    ASSERT_EQ(results.size(), 10);
+    for (const auto& point : results) {
+        EXPECT_GT(point.value, 89.5);
+    }
+
+    Query between(TimeRange(0, 50 * 300), true, 0, ValuePredicate::between(10, 19));
+    results = db.query("test_table", between);
+    ASSERT_EQ(results.size(), 10);
+    EXPECT_DOUBLE_EQ(results.front().value, 10);
+    EXPECT_DOUBLE_EQ(results.back().value, 19);
+
+    Query not_nan(TimeRange(), false, 0, ValuePredicate::not_nan());
+    EXPECT_EQ(db.query("test_table", not_nan).size(), 100);
+}
+
+// Test chunks whose value bounds cannot match are skipped
+TEST_F(DatabaseTest, QuerySkipsChunksOutsidePredicate) {
+    std::vector<DataPoint> points;
+    for (int i = 0; i < 100; ++i) {
+        points.push_back({static_cast<Timestamp>(i * 300), i == 50 ? 1000.0 : 1.0});
+    }
+    db.insert("test_table", points);
+
+    const Table* table = db.get_table("test_table");
+    const auto& metrics = table->get_metrics();
+    double chunks_before = metrics.m_cache_hits + metrics.m_cache_misses;
+
+    Query q(TimeRange(), false, 0, ValuePredicate::greater(500));
+    std::vector<DataPoint> results = db.query("test_table", q);
+
+    ASSERT_EQ(results.size(), 1);
+    EXPECT_EQ(results[0].ts, 50 * 300);
+    // Only the chunk holding the excursion is touched
+    EXPECT_EQ(metrics.m_cache_hits + metrics.m_cache_misses - chunks_before, 1);
+}
+
+// Test latest-N query returns newest points first
+TEST_F(DatabaseTest, QueryLatestPoints) {
+    std::vector<DataPoint> points;
+    for (int i = 0; i < 100; ++i) {
+        points.push_back({static_cast<Timestamp>(i * 300), static_cast<double>(i)});
+    }
+    db.insert("test_table", points);
+
+    std::vector<DataPoint> latest = db.query("test_table", Query::latest());
+    ASSERT_EQ(latest.size(), 1);
+    EXPECT_EQ(latest[0].ts, 99 * 300);
+
+    // Spans several chunks (12 points per chunk)
+    latest = db.query("test_table", Query::latest(30));
+    ASSERT_EQ(latest.size(), 30);
+    for (size_t i = 0; i < latest.size(); ++i) {
+        EXPECT_EQ(latest[i].ts, static_cast<Timestamp>((99 - i) * 300));
+    }
+
+    // Bounded by range and predicate
+    latest = db.query("test_table",
+                      Query::latest(5, TimeRange(0, 50 * 300), ValuePredicate::less(20)));
+    ASSERT_EQ(latest.size(), 5);
+    EXPECT_DOUBLE_EQ(latest[0].value, 19);
+    EXPECT_DOUBLE_EQ(latest[4].value, 15);
+
+    // More than available
+    EXPECT_EQ(db.query("test_table", Query::latest(1000)).size(), 100);
+
+    // Older chunks are loaded from disk when the cache only holds the head
+    Table::Config small_cache(3600, 2, 2, 60, 300);
+    db.create_table("small_cache", small_cache);
+    db.insert("small_cache", points);
+    latest = db.query("small_cache", Query::latest(30));
+    ASSERT_EQ(latest.size(), 30);
+    EXPECT_EQ(latest.back().ts, 70 * 300);
+
+    // A historical query evicts the head chunk, which must then be loaded too
+    db.query("small_cache", Query(TimeRange(0, 3 * 3600 - 1)));
+    latest = db.query("small_cache", Query::latest(3));
+    ASSERT_EQ(latest.size(), 3);
+    EXPECT_EQ(latest[0].ts, 99 * 300);
+    EXPECT_EQ(latest[2].ts, 97 * 300);
+}
+
+// Test batched queries match individual queries and share chunk loads
+TEST_F(DatabaseTest, QueryBatchSharesChunks) {
+    Table::Config config(3600, 24, 2, 60, 300);
+    db.create_table("batch_other", config);
+
+    std::vector<DataPoint> points;
+    for (int i = 0; i < 100; ++i) {
+        points.push_back({static_cast<Timestamp>(i * 300), static_cast<double>(i)});
+    }
+    db.insert("test_table", points);
+    db.insert("batch_other", points);
+
+    std::vector<TableQuery> batch = {
+        {"test_table", Query(TimeRange(0, 20000), true)},
+        {"test_table", Query(TimeRange(10000, 29700), true)},
+        {"batch_other", Query(TimeRange(5000, 6000), true)},
+        {"test_table", Query(TimeRange(), true, 0, ValuePredicate::greater(95))},
+        {"missing_table", Query()},
+        {"test_table", Query::latest(3)},
+    };
+
+    const auto& metrics = db.get_table("test_table")->get_metrics();
+    double chunks_before = metrics.m_cache_hits + metrics.m_cache_misses;
+    auto results = db.query_batch(batch);
+    // Nine chunks hold the data; overlapping ranges only fetch each once (+1 for latest)
+    EXPECT_EQ(metrics.m_cache_hits + metrics.m_cache_misses - chunks_before, 9 + 1);
+
+    ASSERT_EQ(results.size(), batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        auto expected = db.query(batch[i].table_name, batch[i].query);
+        ASSERT_EQ(results[i].size(), expected.size());
+        for (size_t j = 0; j < expected.size(); ++j) {
+            EXPECT_EQ(results[i][j].ts, expected[j].ts);
+        }
+    }
+    EXPECT_TRUE(results[4].empty());
+}
+
+// Test approximate quantiles from chunk sketches
+TEST_F(DatabaseTest, QuantilesWithinRelativeError) {
+    Table::Config small_cache(3600, 2, 2, 60, 300);
+    db.create_table("latency", small_cache);
+
+    std::vector<DataPoint> points;
+    for (int i = 0; i < 1000; ++i) {
+        points.push_back({static_cast<Timestamp>(i * 300), static_cast<double>(i + 1)});
+    }
+    db.insert("latency", points);
+
+    // Mostly fully covered (sketches loaded from disk) plus partial edge chunks
+    TimeRange range(1000, 250000);
+    std::vector<double> values;
+    for (const auto& point : points) {
+        if (range.contains(point.ts)) {
+            values.push_back(point.value);
+        }
+    }
+
+    std::vector<double> qs = {0.0, 0.5, 0.95, 0.99, 1.0};
+    auto results = db.quantiles("latency", range, qs);
+    ASSERT_EQ(results.size(), qs.size());
+    for (size_t i = 0; i < qs.size(); ++i) {
+        double exact = values[static_cast<size_t>(qs[i] * (values.size() - 1))];
+        EXPECT_NEAR(results[i], exact, exact * 0.02) << "q=" << qs[i];
+    }
+
+    // Empty range
+    auto empty = db.quantiles("latency", TimeRange(10000000, 20000000), {0.5});
+    ASSERT_EQ(empty.size(), 1);
+    EXPECT_TRUE(std::isnan(empty[0]));
+
+    // Infinite values are stored but left out of the sketches
+    const double inf = std::numeric_limits<double>::infinity();
+    db.insert("latency", {{400000, inf}, {400300, -inf}, {400600, 5}});
+    auto stored = db.query("latency", Query(TimeRange(400000, 400600)));
+    ASSERT_EQ(stored.size(), 3);
+    EXPECT_EQ(stored[0].value, inf);
+    EXPECT_EQ(stored[1].value, -inf);
+    auto finite = db.quantiles("latency", TimeRange(400000, 400600), {0.0, 1.0});
+    EXPECT_NEAR(finite[0], 5, 0.1);
+    EXPECT_NEAR(finite[1], 5, 0.1);
+}
+
+// Test sketches stay bounded over a huge value span and refuse corrupt bin counts
+TEST(SketchTest, BoundedBinsAndCorruptFiles) {
+    QuantileSketch sketch{};
+    std::vector<double> values;
+    for (int e = -300; e <= 300; ++e) {
+        values.push_back(std::pow(10.0, e));
+    }
+    for (double value : values) {
+        sketch.add(value);
+    }
+    std::stringstream encoded;
+    sketch.write(encoded);
+    const size_t header = 3 * sizeof(double);
+    const size_t store = sizeof(int32_t) + sizeof(size_t);
+    EXPECT_LE(encoded.str().size(), header + 2 * store + Config::SKETCH_MAX_BINS * sizeof(uint64_t));
+    // Collapsing only costs accuracy at the small magnitudes: the kept bins span ~17 decades
+    EXPECT_EQ(sketch.count(), values.size());
+    EXPECT_NEAR(sketch.quantile(1.0) / 1e300, 1.0, 0.02);
+    EXPECT_NEAR(sketch.quantile(590.0 / 600) / 1e290, 1.0, 0.02);
+    EXPECT_GT(sketch.quantile(0.5), 1e200);
+
+    // Merging keeps the bound too
+    QuantileSketch merged{};
+    merged.add(1e-200);
+    merged.merge(sketch);
+    EXPECT_EQ(merged.count(), values.size() + 1);
+    EXPECT_NEAR(merged.quantile(1.0) / 1e300, 1.0, 0.02);
+
+    // A bin count past the cap is rejected before anything is allocated for it
+    std::string corrupt = encoded.str();
+    const size_t huge = size_t{1} << 40;
+    std::memcpy(corrupt.data() + header + sizeof(int32_t), &huge, sizeof(huge));
+    std::stringstream corrupt_stream(corrupt);
+    EXPECT_THROW(QuantileSketch::read(corrupt_stream), std::runtime_error);
+    std::stringstream round_trip(encoded.str());
+    EXPECT_NEAR(QuantileSketch::read(round_trip).quantile(1.0) / 1e300, 1.0, 0.02);
+}
+
+// Test in-engine downsampling keeps extremes and respects the target size
+TEST_F(DatabaseTest, QueryDownsampled) {
+    std::vector<DataPoint> points;
+    for (int i = 0; i < 1000; ++i) {
+        double value = (i == 437) ? 500.0 : (i == 731) ? -500.0 : std::sin(i / 10.0);
+        points.push_back({static_cast<Timestamp>(i * 300), value});
+    }
+    db.insert("test_table", points);
+
+    auto has_spikes = [](const std::vector<DataPoint>& results) {
+        bool high = false, low = false;
+        for (const auto& point : results) {
+            high |= point.ts == 437 * 300 && point.value == 500.0;
+            low |= point.ts == 731 * 300 && point.value == -500.0;
+        }
+        return high && low;
+    };
+    auto is_ordered = [](const std::vector<DataPoint>& results) {
+        return std::is_sorted(results.begin(), results.end(),
+                              [](const DataPoint& a, const DataPoint& b) { return a.ts <= b.ts; });
+    };
+
+    for (auto method : {DownsampleMethod::MinMax, DownsampleMethod::LTTB}) {
+        auto results = db.query("test_table", Query::downsampled(TimeRange(), 100, method));
+        EXPECT_LE(results.size(), 100);
+        EXPECT_GE(results.size(), 50);
+        EXPECT_TRUE(has_spikes(results));
+        EXPECT_TRUE(is_ordered(results));
+    }
+
+    auto lttb = db.query("test_table", Query::downsampled(TimeRange(), 100));
+    EXPECT_EQ(lttb.front().ts, 0);
+    EXPECT_EQ(lttb.back().ts, 999 * 300);
+
+    // Fewer points than the target are returned unchanged
+    auto small = db.query("test_table", Query::downsampled(TimeRange(0, 10 * 300), 100));
+    EXPECT_EQ(small.size(), 11);
+
+    // Targets too small to downsample to are refused rather than truncating the series
+    EXPECT_THROW(db.query("test_table", Query::downsampled(TimeRange(), 1, DownsampleMethod::MinMax)),
+                 std::invalid_argument);
+    EXPECT_THROW(db.query("test_table", Query::downsampled(TimeRange(), 2)), std::invalid_argument);
+    auto three = db.query("test_table", Query::downsampled(TimeRange(), 3));
+    ASSERT_EQ(three.size(), 3);
+    EXPECT_EQ(three[0].ts, 0);
+    EXPECT_EQ(three[1].ts, 437 * 300);
+    EXPECT_EQ(three[2].ts, 999 * 300);
+
+    // Both passes stream the chunks past the cache instead of loading the range into it
+    Table::Config small_cache(3600, 2, 2, 60, 300);
+    db.create_table("long_downsample", small_cache);
+    db.insert("long_downsample", points);
+    const Query first_hour(TimeRange(0, 3599));
+    db.query("long_downsample", first_hour);
+    auto streamed = db.query("long_downsample", Query::downsampled(TimeRange(), 100));
+    EXPECT_EQ(streamed.size(), lttb.size());
+    for (size_t i = 0; i < std::min(streamed.size(), lttb.size()); ++i) {
+        EXPECT_EQ(streamed[i].ts, lttb[i].ts);
+    }
+    QueryStats stats{};
+    db.query("long_downsample", first_hour, &stats);
+    EXPECT_EQ(stats.cache_hits, 1);
+}
+
+TEST_F(DatabaseTest, WindowFunctionsCarryStateAcrossChunks) {
+    // A counter rising by i % 5 per point that resets at point 40, 12 points per chunk
+    std::vector<DataPoint> points;
+    double counter = 0;
+    for (int i = 0; i < 100; ++i) {
+        counter = (i == 40) ? 3.0 : counter + i % 5;
+        points.push_back({static_cast<Timestamp>(i * 300), counter});
+    }
+    db.insert("test_table", points);
+
+    // Brute force over the trailing window of each point
+    auto expected = [&](auto fold, size_t window_points, TimeDelta window_secs) {
+        std::vector<double> values;
+        for (size_t i = 0; i < points.size(); ++i) {
+            std::vector<double> window;
+            for (size_t j = 0; j <= i; ++j) {
+                bool inside = window_secs > 0 ? points[i].ts - points[j].ts < window_secs
+                                              : i - j < window_points;
+                if (inside) window.push_back(points[j].value);
+            }
+            values.push_back(fold(window));
+        }
+        return values;
+    };
+    auto values_of = [](const std::vector<DataPoint> &results) {
+        std::vector<double> values;
+        for (const auto &point : results) values.push_back(point.value);
+        return values;
+    };
+
+    auto avg = db.query("test_table", Query::windowed(TimeRange(), {WindowFunction::MovingAvg, 5}));
+    ASSERT_EQ(avg.size(), points.size());
+    auto expected_avg = expected([](const std::vector<double> &w) {
+        return std::accumulate(w.begin(), w.end(), 0.0) / static_cast<double>(w.size());
+    }, 5, 0);
+    for (size_t i = 0; i < avg.size(); ++i) {
+        EXPECT_EQ(avg[i].ts, points[i].ts);
+        EXPECT_NEAR(avg[i].value, expected_avg[i], 1e-9);
+    }
+
+    auto max = db.query("test_table", Query::windowed(TimeRange(), {WindowFunction::MovingMax, 0, 1800}));
+    EXPECT_EQ(values_of(max), expected([](const std::vector<double> &w) {
+        return *std::max_element(w.begin(), w.end());
+    }, 0, 1800));
+    auto min = db.query("test_table", Query::windowed(TimeRange(), {WindowFunction::MovingMin, 7}));
+    EXPECT_EQ(values_of(min), expected([](const std::vector<double> &w) {
+        return *std::min_element(w.begin(), w.end());
+    }, 7, 0));
+
+    // Per-point rate: the reset counts its whole new value as increase
+    auto rate = db.query("test_table", Query::windowed(TimeRange(), {WindowFunction::Rate}));
+    ASSERT_EQ(rate.size(), points.size() - 1);
+    EXPECT_DOUBLE_EQ(rate[39].value, 3.0 / 300);
+    EXPECT_DOUBLE_EQ(rate[40].value, 1.0 / 300);
+    auto derivative = db.query("test_table", Query::windowed(TimeRange(), {WindowFunction::Derivative}));
+    EXPECT_DOUBLE_EQ(derivative[39].value, (3.0 - points[39].value) / 300);
+
+    auto total = db.query("test_table", Query::windowed(TimeRange(0, 2 * 3600 - 1), {WindowFunction::CumulativeSum}));
+    ASSERT_EQ(total.size(), 24);
+    double sum = 0;
+    for (size_t i = 0; i < 24; ++i) sum += points[i].value;
+    EXPECT_DOUBLE_EQ(total.back().value, sum);
+
+    // A step keeps only the last result of each hour
+    auto hourly = db.query("test_table", Query::windowed(TimeRange(), {WindowFunction::Rate, 0, 3600, 3600}));
+    ASSERT_EQ(hourly.size(), 9);
+    EXPECT_EQ(hourly.front().ts, 11 * 300);
+    EXPECT_EQ(hourly.back().ts, 99 * 300);
+
+    EXPECT_THROW(db.query("test_table", Query::windowed(TimeRange(), {WindowFunction::MovingSum})),
+                 std::invalid_argument);
+
+    // A window over a long range streams past the cache instead of loading into it
+    Table::Config small_cache(3600, 2, 2, 60, 300);
+    db.create_table("long_window", small_cache);
+    std::vector<DataPoint> long_points;
+    for (int i = 0; i < 24 * 12; ++i) {
+        long_points.push_back({static_cast<Timestamp>(i * 300), 1.0});
+    }
+    db.insert("long_window", long_points);
+    const Query first_hour(TimeRange(0, 3599));
+    db.query("long_window", first_hour);
+    QueryStats stats{};
+    auto sums = db.query("long_window", Query::windowed(TimeRange(), {WindowFunction::CumulativeSum}), &stats);
+    ASSERT_EQ(sums.size(), long_points.size());
+    EXPECT_DOUBLE_EQ(sums.back().value, static_cast<double>(long_points.size()));
+    EXPECT_EQ(stats.chunks_matched, 24);
+    db.query("long_window", first_hour, &stats);
+    EXPECT_EQ(stats.cache_hits, 1);
+}
+
+TEST_F(DatabaseTest, JoinsMergeTwoTablesInTimeOrder) {
+    // A small cache, so most chunks of both sides load from disk during the join
+    Table::Config config(3600, 2, 2, 60, 60);
+    db.create_table("cpu", config);
+    db.create_table("requests", config);
+    std::vector<DataPoint> cpu, requests;
+    for (Timestamp ts = 0; ts < 10 * 3600; ts += 300) {
+        cpu.push_back({ts, static_cast<double>(ts / 300)});
+    }
+    for (Timestamp ts = 1000; ts < 8 * 3600; ts += 420) {
+        requests.push_back({ts, static_cast<double>(ts)});
+    }
+    db.insert("cpu", cpu);
+    db.insert("requests", requests);
+
+    // Brute force: the last request point at or before each cpu point
+    std::vector<JoinedPoint> expected;
+    size_t within_600 = 0;
+    for (const auto &point : cpu) {
+        const DataPoint *latest = nullptr;
+        for (const auto &r : requests) {
+            if (r.ts <= point.ts) latest = &r;
+        }
+        if (latest) expected.push_back({point.ts, point.value, latest->value});
+        if (latest && point.ts - latest->ts <= 600) within_600++;
+    }
+    auto as_of = db.join("cpu", "requests", JoinQuery::as_of(TimeRange()));
+    ASSERT_EQ(as_of.size(), expected.size());
+    for (size_t i = 0; i < as_of.size(); ++i) {
+        EXPECT_EQ(as_of[i].ts, expected[i].ts);
+        EXPECT_EQ(as_of[i].left, expected[i].left);
+        EXPECT_EQ(as_of[i].right, expected[i].right);
+    }
+
+    // A range starting after some request points still matches its first points with the
+    // last request before it, whether that sits in the range's first chunk or an earlier one
+    for (const TimeRange range : {TimeRange(5 * 3600, 6 * 3600 - 1), TimeRange(5 * 3600 + 300, 7 * 3600 - 1)}) {
+        auto within = db.join("cpu", "requests", JoinQuery::as_of(range));
+        std::vector<JoinedPoint> in_range;
+        for (const auto &point : expected) {
+            if (point.ts >= range.start_ts && point.ts <= range.end_ts) in_range.push_back(point);
+        }
+        ASSERT_EQ(within.size(), in_range.size());
+        for (size_t i = 0; i < within.size(); ++i) {
+            EXPECT_EQ(within[i].ts, in_range[i].ts);
+            EXPECT_EQ(within[i].right, in_range[i].right);
+        }
+    }
+    db.create_table("sparse", config);
+    db.insert("sparse", {{600, 42}});
+    auto stale = db.join("cpu", "sparse", JoinQuery::as_of(TimeRange(3 * 3600, 4 * 3600 - 1)));
+    ASSERT_EQ(stale.size(), 12);
+    EXPECT_EQ(stale.front().right, 42);
+
+    // Past the last request point, matches go stale after the tolerance
+    auto fresh = db.join("cpu", "requests", JoinQuery::as_of(TimeRange(), 600));
+    EXPECT_EQ(fresh.size(), within_600);
+    EXPECT_LT(fresh.size(), expected.size());
+    EXPECT_EQ(fresh.back().right, requests.back().value);
+
+    // Hourly means of both sides, only for hours where both have points
+    auto hourly = db.join("cpu", "requests", JoinQuery::buckets(TimeRange(), 3600));
+    ASSERT_EQ(hourly.size(), 8);
+    for (size_t h = 0; h < hourly.size(); ++h) {
+        const Timestamp start = static_cast<Timestamp>(h) * 3600;
+        double cpu_sum = 0, request_sum = 0;
+        size_t cpu_count = 0, request_count = 0;
+        for (const auto &p : cpu) {
+            if (p.ts >= start && p.ts < start + 3600) { cpu_sum += p.value; cpu_count++; }
+        }
+        for (const auto &p : requests) {
+            if (p.ts >= start && p.ts < start + 3600) { request_sum += p.value; request_count++; }
+        }
+        EXPECT_EQ(hourly[h].ts, start);
+        EXPECT_DOUBLE_EQ(hourly[h].left, cpu_sum / cpu_count);
+        EXPECT_DOUBLE_EQ(hourly[h].right, request_sum / request_count);
+    }
+
+    EXPECT_THROW(db.join("cpu", "missing", JoinQuery::as_of(TimeRange())), std::runtime_error);
+    EXPECT_THROW(db.join("cpu", "requests", JoinQuery::buckets(TimeRange(), 0)), std::invalid_argument);
+}
+
+TEST_F(DatabaseTest, GapFilledQueriesBridgeChunkBoundaries) {
+    // The hour from 3600 holds no chunk at all; the range below starts in that gap
+    db.insert("test_table", {{600, 1}, {1200, 2}, {7800, 8}, {11400, 10}});
+    const TimeRange range(3600, 3 * 3600 - 1);
+
+    // Neighbouring points come from the first and last chunks' metadata
+    auto linear = db.query("test_table", Query::filled(range, FillStrategy::Linear, 600));
+    ASSERT_EQ(linear.size(), 12u);
+    for (const auto &point : linear) {
+        EXPECT_EQ(point.ts % 600, 0);
+        double expected = point.ts <= 7800 ? 2 + 6.0 * static_cast<double>(point.ts - 1200) / 6600
+                                           : 8 + 2.0 * static_cast<double>(point.ts - 7800) / 3600;
+        EXPECT_NEAR(point.value, expected, 1e-9);
+    }
+    EXPECT_EQ(linear.front().ts, 3600);
+    EXPECT_EQ(linear.back().ts, 10200);
+
+    auto previous = db.query("test_table", Query::filled(range, FillStrategy::Previous, 600));
+    ASSERT_EQ(previous.size(), 12u);
+    for (const auto &point : previous) {
+        EXPECT_EQ(point.value, point.ts < 7800 ? 2 : 8);
+    }
+
+    auto null = db.query("test_table", Query::filled(range, FillStrategy::Null, 600));
+    ASSERT_EQ(null.size(), 12u);
+    for (const auto &point : null) {
+        EXPECT_EQ(std::isnan(point.value), point.ts != 7800);
+    }
+
+    // The step defaults to min_resolution_secs; an open range is clipped to the data
+    EXPECT_EQ(db.query("test_table", Query::filled(range, FillStrategy::Previous)).size(), 24u);
+    auto all = db.query("test_table", Query::filled(TimeRange(), FillStrategy::Previous, 600));
+    ASSERT_EQ(all.size(), 19u);
+    EXPECT_EQ(all.front().ts, 600);
+    EXPECT_EQ(all.front().value, 1);
+    EXPECT_EQ(all.back().ts, 11400);
+    EXPECT_EQ(all.back().value, 10);
+
+    EXPECT_THROW(db.query("test_table", Query::filled(range, FillStrategy::Null, -600)), std::invalid_argument);
+    // Grids past FILL_MAX_POINTS are refused before anything is allocated for them
+    EXPECT_THROW(db.query("test_table", Query::filled(TimeRange(1, TIMESTAMP_MAX - 1), FillStrategy::Null, 1)),
+                 std::invalid_argument);
+    EXPECT_EQ(db.query("test_table", Query::filled(TimeRange(1, TIMESTAMP_MAX - 1), FillStrategy::Null, 86400)).size(),
+              static_cast<size_t>((TIMESTAMP_MAX - 1) / 86400));
+    auto widest = db.query("test_table", Query::filled(TimeRange(1, TIMESTAMP_MAX - 1), FillStrategy::Null, TIMESTAMP_MAX - 1));
+    ASSERT_EQ(widest.size(), 1u);
+    EXPECT_EQ(widest[0].ts, TIMESTAMP_MAX - 1);
+
+    // The grid rounds a negative start up to the next multiple of the step
+    auto before_epoch = db.query("test_table", Query::filled(TimeRange(-1000, 1200), FillStrategy::Previous, 600));
+    ASSERT_EQ(before_epoch.size(), 4u);
+    EXPECT_EQ(before_epoch.front().ts, -600);
+    EXPECT_TRUE(std::isnan(before_epoch.front().value));
+    EXPECT_EQ(before_epoch.back().ts, 1200);
+    EXPECT_EQ(before_epoch.back().value, 2);
+}
+
+// Test per-query statistics and cumulative latency histograms
+TEST_F(DatabaseTest, QueryStatsAndLatencyHistograms) {
+    Table::Config small_cache(3600, 2, 2, 60, 300);
+    db.create_table("explained", small_cache);
+
+    std::vector<DataPoint> points;
+    for (int i = 0; i < 120; ++i) {
+        points.push_back({static_cast<Timestamp>(i * 300), static_cast<double>(i)});
+    }
+    db.insert("explained", points);
+
+    // Ten chunks of 12 points; the first five are only on disk
+    QueryStats stats;
+    auto results = db.query("explained", Query(TimeRange(0, 5 * 3600 - 1), true), &stats);
+    EXPECT_EQ(results.size(), 60);
+    EXPECT_EQ(stats.rows_returned, 60);
+    EXPECT_EQ(stats.rows_scanned, 60);
+    EXPECT_GE(stats.chunks_matched, 5);
+    EXPECT_EQ(stats.cache_misses, 5);
+    EXPECT_GT(stats.bytes_read, 60 * (sizeof(Timestamp) + sizeof(double)));
+    EXPECT_GE(stats.total_ns, stats.lookup_ns + stats.load_ns);
+
+    Query filtered(TimeRange(), false, 0, ValuePredicate::greater(115));
+    db.query("explained", filtered, &stats);
+    EXPECT_EQ(stats.rows_returned, 4);
+    EXPECT_EQ(stats.chunks_skipped, stats.chunks_matched - 1);
+
+    const auto& metrics = db.get_table("explained")->get_metrics();
+    EXPECT_EQ(metrics.m_query_latency.count(), 2);
+    EXPECT_EQ(metrics.m_insert_latency.count(), 1);
+    EXPECT_GE(metrics.m_query_latency.percentile_ns(0.99),
+              metrics.m_query_latency.percentile_ns(0.5));
+}
+
+// Test trace spans are exported as Chrome trace_event JSON
+TEST_F(DatabaseTest, TraceDumpChromeJson) {
+    std::vector<DataPoint> points = {{1000, 10.5}, {2000, 20.3}};
+    db.insert("test_table", points);
+    db.query("test_table", Query());
+
+    std::stringstream out;
+    trace::dump_chrome_json(out);
+    std::string json = out.str();
+    EXPECT_NE(json.find("\"traceEvents\":["), std::string::npos);
+    if (trace::enabled()) {
+        EXPECT_NE(json.find("\"name\":\"table.query\""), std::string::npos);
+        EXPECT_NE(json.find("\"name\":\"table.insert\""), std::string::npos);
+        EXPECT_NE(json.find("\"ph\":\"X\""), std::string::npos);
+    } else {
+        EXPECT_EQ(json.find("\"ph\""), std::string::npos);
+    }
+}
+
+// Test a dump racing a writer that laps the ring only ever sees whole events
+TEST(TraceTest, DumpSkipsTornEvents) {
+    std::atomic<bool> started{false};
+    std::atomic<bool> done{false};
+    std::thread writer([&]() {
+        for (uint64_t i = 1; !done.load(); ++i) {
+            trace::record("trace.torn", i * 1000, i * 1000);
+            started = true;
+        }
+    });
+    while (!started) {
+        std::this_thread::yield();
+    }
+    const std::regex event("\"name\":\"trace.torn\"[^}]*\"ts\":([0-9.]+),\"dur\":([0-9.]+)");
+    auto check_dump = [&]() {
+        std::stringstream out;
+        trace::dump_chrome_json(out);
+        const std::string json = out.str();
+        size_t seen = 0;
+        for (std::sregex_iterator it(json.begin(), json.end(), event), end; it != end; ++it) {
+            EXPECT_EQ((*it)[1].str(), (*it)[2].str());
+            seen++;
+        }
+        return seen;
+    };
+    for (int dump = 0; dump < 20; ++dump) {
+        check_dump();
+    }
+    done = true;
+    writer.join();
+    EXPECT_GT(check_dump(), 0);
+    trace::clear();
+    EXPECT_EQ(check_dump(), 0);
+}
+
+// Test many writers ingest into one table while readers query it
+TEST_F(DatabaseTest, ConcurrentWritersAndReaders) {
+    Table::Config small_cache(3600, 4, 2, 60, 1);
+    db.create_table("concurrent", small_cache);
+
+    // Writers interleave timestamps, so each sees its points land out of global order
+    constexpr int writers = 4;
+    constexpr int batches = 50;
+    constexpr int batch_size = 40;
+    std::vector<std::thread> threads;
+    for (int w = 0; w < writers; ++w) {
+        threads.emplace_back([&, w]() {
+            for (int b = 0; b < batches; ++b) {
+                std::vector<DataPoint> batch;
+                for (int i = 0; i < batch_size; ++i) {
+                    Timestamp ts = (static_cast<Timestamp>(b) * batch_size + i) * writers + w;
+                    batch.push_back({ts, static_cast<double>(ts)});
+                }
+                db.insert("concurrent", batch);
+            }
+        });
+    }
+    for (int r = 0; r < 2; ++r) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < 50; ++i) {
+                auto results = db.query("concurrent", Query(TimeRange(0, 3600 * 2), true));
+                for (size_t j = 1; j < results.size(); ++j) {
+                    ASSERT_LT(results[j - 1].ts, results[j].ts);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    constexpr size_t total = writers * batches * batch_size;
+    EXPECT_EQ(db.get_table("concurrent")->rows(), total);
+    auto results = db.query("concurrent", Query(TimeRange(), true));
+    ASSERT_EQ(results.size(), total);
+    for (size_t i = 0; i < results.size(); ++i) {
+        EXPECT_EQ(results[i].ts, static_cast<Timestamp>(i));
+    }
+}
+
+// Test late points reach a chunk that has already been evicted to disk
+TEST_F(DatabaseTest, LateInsertIntoEvictedChunk) {
+    Table::Config small_cache(3600, 1, 2, 60, 300);
+    db.create_table("late", small_cache);
+
+    db.insert("late", {{0, 1.0}, {600, 3.0}});
+    db.insert("late", {{4 * 3600, 5.0}});
+    db.insert("late", {{300, 2.0}});
+
+    auto results = db.query("late", Query(TimeRange(0, 3599), true));
+    ASSERT_EQ(results.size(), 3);
+    EXPECT_EQ(results[0].ts, 0);
+    EXPECT_EQ(results[1].ts, 300);
+    EXPECT_DOUBLE_EQ(results[1].value, 2.0);
+    EXPECT_EQ(results[2].ts, 600);
+}
+
+// Test a chunk snapshot keeps its rows while the chunk is appended to and rewritten
+TEST(ChunkSnapshotTest, UnaffectedByLaterAppends) {
+    Chunk chunk(TimeRange(0, 3600), 1, 12);
+    chunk.append({0, 1.0});
+    chunk.append({600, 3.0});
+    auto before = chunk.snapshot();
+
+    // In order appends fill unpublished slots; a late point copies the rows
+    chunk.append({900, 4.0});
+    chunk.append({300, 2.0});
+
+    EXPECT_EQ(before.size(), 2);
+    auto old_rows = before.get_data_in_range(TimeRange());
+    ASSERT_EQ(old_rows.size(), 2);
+    EXPECT_EQ(old_rows[0].ts, 0);
+    EXPECT_EQ(old_rows[1].ts, 600);
+
+    auto now = chunk.snapshot().get_data_in_range(TimeRange());
+    ASSERT_EQ(now.size(), 4);
+    for (size_t i = 0; i < now.size(); ++i) {
+        EXPECT_EQ(now[i].ts, static_cast<Timestamp>(i * 300));
+        EXPECT_DOUBLE_EQ(now[i].value, static_cast<double>(i + 1));
+    }
+}
+
+// Test the server end to end over a Unix socket, including pipelined queries and errors
+TEST_F(DatabaseTest, ServerRoundTripAndPipelining) {
+    const std::string socket_path = "./test_db_data/server.sock";
+    Server server(db, 4);
+    server.listen_unix(socket_path);
+    std::thread loop([&]() { server.run(); });
+
+    {
+        auto client = Client::unix_socket(socket_path);
+        Table::Config config(3600, 24, 2, 60, 300);
+        client.create_table("remote", config);
+        auto names = client.table_names();
+        EXPECT_TRUE(std::find(names.begin(), names.end(), "remote") != names.end());
+
+        std::vector<DataPoint> points{};
+        for (Timestamp ts = 0; ts < 3 * 3600; ts += 300) {
+            points.push_back({ts, static_cast<double>(ts / 300)});
+        }
+        client.insert("remote", points);
+
+        auto all = client.query("remote", Query(TimeRange(0, 3 * 3600), true));
+        ASSERT_EQ(all.size(), points.size());
+        EXPECT_EQ(all.front().ts, 0);
+        EXPECT_EQ(all.back().ts, 3 * 3600 - 300);
+
+        // Queries of different cost finish out of order but come back aligned
+        std::vector<TableQuery> batch{};
+        for (Timestamp hour = 2; hour >= 0; --hour) {
+            batch.push_back({"remote", Query(TimeRange(hour * 3600, hour * 3600 + 3599), true)});
+        }
+        batch.push_back({"remote", Query(TimeRange(0, 3 * 3600), true)});
+        auto results = client.query_pipelined(batch);
+        ASSERT_EQ(results.size(), 4);
+        for (size_t i = 0; i < 3; ++i) {
+            ASSERT_EQ(results[i].size(), 12);
+            EXPECT_EQ(results[i].front().ts, static_cast<Timestamp>(2 - i) * 3600);
+        }
+        EXPECT_EQ(results[3].size(), points.size());
+
+        EXPECT_THROW(client.insert("missing", points), std::runtime_error);
+        EXPECT_THROW(client.query("missing", Query(TimeRange(0, 10))), std::runtime_error);
+        // The connection is still usable after an error
+        EXPECT_EQ(client.query("remote", Query(TimeRange(0, 299))).size(), 1);
+    }
+
+    server.stop();
+    loop.join();
+}
+
+// Test a result too large for one frame is refused with an error, not sent
+TEST_F(DatabaseTest, ServerRefusesOversizedResult) {
+    const std::string socket_path = "./test_db_data/oversized.sock";
+    Server server(db, 4);
+    server.listen_unix(socket_path);
+    std::thread loop([&]() { server.run(); });
+
+    {
+        auto client = Client::unix_socket(socket_path);
+        client.insert("test_table", {{0, 1.0}});
+        // A grid of FILL_MAX_POINTS points is one point past what a frame holds
+        static_assert(Config::FILL_MAX_POINTS > protocol::MAX_RESPONSE_POINTS);
+        const auto huge = Query::filled(
+            TimeRange(0, static_cast<Timestamp>(Config::FILL_MAX_POINTS) - 1), FillStrategy::Previous, 1);
+        try {
+            client.query("test_table", huge);
+            FAIL() << "Oversized result was sent";
+        } catch (const std::runtime_error &e) {
+            EXPECT_NE(std::string(e.what()).find("narrow the range or downsample"), std::string::npos);
+        }
+        EXPECT_THROW(client.query_pipelined({{"test_table", huge}, {"test_table", Query(TimeRange(0, 10))}}),
+                     std::runtime_error);
+        EXPECT_EQ(client.query("test_table", Query(TimeRange(0, 10))).size(), 1);
+    }
+
+    server.stop();
+    loop.join();
+}
+
+// Test the client skips a response frame past MAX_PAYLOAD_BYTES and stays in sync
+TEST(ClientTest, SkipsOversizedResponse) {
+    std::filesystem::create_directories("./test_db_data");
+    const std::string socket_path = "./test_db_data/fake_server.sock";
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(socket_path.c_str());
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_GE(listener, 0);
+    ASSERT_EQ(bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)), 0);
+    ASSERT_EQ(listen(listener, 1), 0);
+
+    // Answers the first request with an oversized frame and the second with no points
+    std::thread peer([&]() {
+        int fd = accept(listener, nullptr, nullptr);
+        for (size_t length : {size_t{protocol::MAX_PAYLOAD_BYTES} + 1, sizeof(uint32_t)}) {
+            protocol::FrameHeader request;
+            recv(fd, &request, sizeof(request), MSG_WAITALL);
+            std::vector<char> payload(request.length);
+            recv(fd, payload.data(), payload.size(), MSG_WAITALL);
+
+            std::vector<char> frame{};
+            size_t offset = protocol::begin_frame(frame, request.request_id,
+                                                  static_cast<uint8_t>(protocol::Status::Ok));
+            frame.resize(frame.size() + length, 0);
+            protocol::end_frame(frame, offset);
+            for (size_t sent = 0; sent < frame.size();) {
+                ssize_t written = send(fd, frame.data() + sent, frame.size() - sent, MSG_NOSIGNAL);
+                if (written <= 0)
+                    break;
+                sent += static_cast<size_t>(written);
+            }
+        }
+        close(fd);
+    });
+
+    {
+        auto client = Client::unix_socket(socket_path);
+        EXPECT_THROW(client.query("any", Query()), std::runtime_error);
+        EXPECT_TRUE(client.query("any", Query()).empty());
+    }
+    peer.join();
+    close(listener);
+    unlink(socket_path.c_str());
+}
+
+// Test a duplicate CreateTable is refused while other clients query the table
+TEST_F(DatabaseTest, ServerRefusesDuplicateCreateTable) {
+    const std::string socket_path = "./test_db_data/duplicate.sock";
+    Server server(db, 4);
+    server.listen_unix(socket_path);
+    std::thread loop([&]() { server.run(); });
+
+    Table::Config config(3600, 2, 2, 60, 300);
+    {
+        auto client = Client::unix_socket(socket_path);
+        client.create_table("shared", config);
+        std::vector<DataPoint> points{};
+        for (Timestamp ts = 0; ts < 6 * 3600; ts += 300) {
+            points.push_back({ts, static_cast<double>(ts)});
+        }
+        client.insert("shared", points);
+    }
+
+    std::atomic<bool> done{false};
+    std::atomic<size_t> wrong{0};
+    std::vector<std::thread> readers{};
+    for (int i = 0; i < 3; ++i) {
+        readers.emplace_back([&]() {
+            auto client = Client::unix_socket(socket_path);
+            while (!done) {
+                if (client.query("shared", Query(TimeRange(0, 6 * 3600), true)).size() != 72) {
+                    wrong++;
+                }
+            }
+        });
+    }
+    {
+        auto client = Client::unix_socket(socket_path);
+        for (int i = 0; i < 20; ++i) {
+            EXPECT_THROW(client.create_table("shared", config), std::runtime_error);
+        }
+        EXPECT_EQ(client.query("shared", Query(TimeRange(0, 6 * 3600))).size(), 72);
+    }
+    done = true;
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(wrong, 0);
+    EXPECT_THROW(db.create_table("shared", config), std::runtime_error);
+
+    server.stop();
+    loop.join();
+}
+
+// Test element counts are checked against the payload before anything is allocated
+TEST(ProtocolTest, RejectsCountsBeyondPayload) {
+    std::vector<char> payload{};
+    protocol::Writer writer(payload);
+    writer.put(std::numeric_limits<uint32_t>::max());
+    writer.put(1.0);
+    writer.put(2.0);
+
+    protocol::Reader points(payload.data(), payload.size());
+    EXPECT_THROW(points.get_points(), std::runtime_error);
+    protocol::Reader doubles(payload.data(), payload.size());
+    EXPECT_THROW(doubles.get_count(sizeof(double)), std::runtime_error);
+
+    payload.clear();
+    writer.put(uint32_t{2});
+    writer.put(1.0);
+    writer.put(2.0);
+    protocol::Reader exact(payload.data(), payload.size());
+    EXPECT_EQ(exact.get_count(sizeof(double)), 2u);
+}
+
+// Test a table config crosses the wire whole and invalid ones are refused
+TEST(ProtocolTest, RoundTripsTableConfig) {
+    std::vector<char> payload{};
+    protocol::Writer writer(payload);
+    writer.put_config(Table::Config(7200, 12, 3, 30, 60, ValueType::Int64, 4, true, 1 << 16));
+    protocol::Reader reader(payload.data(), payload.size());
+    auto config = reader.get_config();
+    EXPECT_EQ(config.chunk_size_secs, 7200);
+    EXPECT_EQ(config.chunk_cache_size, 12u);
+    EXPECT_EQ(config.max_chunks_to_save, 3u);
+    EXPECT_EQ(config.flush_interval_secs, 30);
+    EXPECT_EQ(config.min_resolution_secs, 60);
+    EXPECT_EQ(config.value_type, ValueType::Int64);
+    EXPECT_EQ(config.value_columns, 4u);
+    EXPECT_TRUE(config.regular_series);
+    EXPECT_EQ(config.target_chunk_bytes, 1u << 16);
+
+    // A resolution coarser than the chunk, and a table without value columns
+    for (const auto &invalid : {Table::Config(3600, 24, 2, 60, 7200),
+                                Table::Config(3600, 24, 2, 60, 300, ValueType::Float64, 0)}) {
+        payload.clear();
+        writer.put_config(invalid);
+        protocol::Reader refused(payload.data(), payload.size());
+        EXPECT_THROW(refused.get_config(), std::runtime_error);
+    }
+}
+
+// Test the ingest line parser accepts CSV and whitespace separated points only
+TEST(IngestTest, ParsePointLine) {
+    DataPoint point{};
+    EXPECT_TRUE(parse_point_line("1700000000,12.5", point));
+    EXPECT_EQ(point.ts, 1700000000);
+    EXPECT_DOUBLE_EQ(point.value, 12.5);
+    EXPECT_TRUE(parse_point_line("  42 \t -3e2\r", point));
+    EXPECT_EQ(point.ts, 42);
+    EXPECT_DOUBLE_EQ(point.value, -300.0);
+    EXPECT_TRUE(parse_point_line("7 , 1", point));
+
+    EXPECT_FALSE(parse_point_line("timestamp,value", point));
+    EXPECT_FALSE(parse_point_line("42", point));
+    EXPECT_FALSE(parse_point_line("42,", point));
+    EXPECT_FALSE(parse_point_line("42,1,2", point));
+    EXPECT_FALSE(parse_point_line("4x2 1", point));
+}
+
+// Test streaming ingest through a pipe with blocks smaller than the input and a split last line
+TEST_F(DatabaseTest, IngestStreamFromPipe) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    std::thread producer([&]() {
+        std::string data = "timestamp,value\n";
+        for (Timestamp ts = 0; ts < 2 * 3600; ts += 300) {
+            data += std::to_string(ts) + (ts % 600 ? " " : ",") + std::to_string(ts / 300) + "\n";
+        }
+        data += "# comment\n\nbad line\n";
+        data += std::string(200, '9') + "\n"; // Longer than a block
+        data += "7200 24";                     // No trailing newline
+        ASSERT_EQ(write(fds[1], data.data(), data.size()), static_cast<ssize_t>(data.size()));
+        close(fds[1]);
+    });
+
+    IngestOptions options{};
+    options.batch_points = 5;
+    options.block_bytes = 64;
+    auto stats = ingest_stream(db, "test_table", fds[0], options);
+    producer.join();
+    close(fds[0]);
+
+    EXPECT_EQ(stats.points, 25);
+    EXPECT_EQ(stats.batches, 5);
+    EXPECT_EQ(stats.rejected, 3); // Header, bad line and the oversized line
+    auto results = db.query("test_table", Query(TimeRange(0, 3 * 3600), true));
+    ASSERT_EQ(results.size(), 25);
+    EXPECT_EQ(results.back().ts, 7200);
+    EXPECT_DOUBLE_EQ(results.back().value, 24.0);
+}
+
+// Test the column codecs round trip irregular timestamps and awkward values bit for bit
+TEST(CodecTest, RoundTripsColumns) {
+    std::vector<Timestamp> timestamps = {TIMESTAMP_MIN, -5, 0, 1, 2, 3, 1000, 999, TIMESTAMP_MAX};
+    std::vector<double> values = {0.0, -0.0, 1.0, 1.0, 2.5, std::numeric_limits<double>::quiet_NaN(),
+                                  std::numeric_limits<double>::infinity(), 1e-300, -7.25};
+    std::vector<char> encoded{};
+    codec::encode_timestamps(timestamps.data(), timestamps.size(), encoded);
+    size_t ts_bytes = encoded.size();
+    codec::encode_values(values.data(), values.size(), encoded);
+
+    std::vector<Timestamp> decoded_ts(timestamps.size());
+    std::vector<double> decoded_values(values.size());
+    EXPECT_EQ(codec::decode_timestamps(encoded.data(), encoded.size(), timestamps.size(),
+                                       decoded_ts.data()), ts_bytes);
+    EXPECT_EQ(codec::decode_values(encoded.data() + ts_bytes, encoded.size() - ts_bytes,
+                                   values.size(), decoded_values.data()), encoded.size() - ts_bytes);
+    EXPECT_EQ(decoded_ts, timestamps);
+    EXPECT_EQ(std::memcmp(decoded_values.data(), values.data(), values.size() * sizeof(double)), 0);
+
+    EXPECT_THROW(codec::decode_values(encoded.data() + ts_bytes, 3, values.size(),
+                                      decoded_values.data()), std::runtime_error);
+}
+
+// Test a range exported from one database imports into another, raw and compressed
+TEST_F(DatabaseTest, BulkExportImportRoundTrip) {
+    std::vector<DataPoint> points{};
+    for (Timestamp ts = 0; ts < 5 * 3600; ts += 300) {
+        points.push_back({ts, std::floor(std::sin(static_cast<double>(ts)) * 100)});
+    }
+    db.insert("test_table", points);
+    const TimeRange range(3600, 4 * 3600 - 1);
+
+    DataBase target{"bulk_target", "./test_db_data/bulk_target"};
+    for (bool compress : {false, true}) {
+        std::stringstream file;
+        bulk::ExportOptions options{};
+        options.compress = compress;
+        options.block_points = 7; // Blocks straddle chunk boundaries
+        auto exported = bulk::export_table(db, "test_table", range, file, options);
+        EXPECT_EQ(exported.points, 36);
+        EXPECT_EQ(exported.blocks, 6);
+        EXPECT_EQ(exported.bytes, file.str().size());
+
+        const std::string name = compress ? "compressed" : "raw";
+        Table::Config config(3600, 24, 2, 60, 300);
+        target.create_table(name, config);
+        auto imported = bulk::import_table(target, name, file);
+        EXPECT_EQ(imported.points, 36);
+        EXPECT_EQ(imported.bytes, exported.bytes);
+
+        auto expected = db.query("test_table", Query(range, true));
+        auto results = target.query(name, Query(TimeRange(0, 5 * 3600), true));
+        ASSERT_EQ(results.size(), expected.size());
+        for (size_t i = 0; i < results.size(); ++i) {
+            EXPECT_EQ(results[i].ts, expected[i].ts);
+            EXPECT_DOUBLE_EQ(results[i].value, expected[i].value);
+        }
+
+        std::string data = file.str();
+        std::stringstream truncated(data.substr(0, data.size() - 20));
+        target.create_table(name + "_truncated", config);
+        EXPECT_THROW(bulk::import_table(target, name + "_truncated", truncated), std::runtime_error);
+    }
+}
+
+// Test an export of a wide, narrow-typed table keeps every column and is refused by a table
+// of another layout
+TEST_F(DatabaseTest, BulkExportImportWideTable) {
+    Table::Config wide(3600, 24, 2, 60, 300, ValueType::Float32, 3);
+    db.create_table("wide_source", wide);
+    std::vector<Timestamp> timestamps{};
+    std::vector<std::vector<double>> columns(3);
+    for (Timestamp ts = 0; ts < 3 * 3600; ts += 300) {
+        timestamps.push_back(ts);
+        for (size_t c = 0; c < columns.size(); ++c) {
+            columns[c].push_back(static_cast<double>(ts / 300) + 0.5 * static_cast<double>(c));
+        }
+    }
+    db.insert_rows("wide_source", timestamps, columns);
+
+    DataBase target{"bulk_wide", "./test_db_data/bulk_wide"};
+    for (bool compress : {false, true}) {
+        std::stringstream file;
+        bulk::ExportOptions options{};
+        options.compress = compress;
+        options.block_points = 10;
+        auto exported = bulk::export_table(db, "wide_source", TimeRange(), file, options);
+        EXPECT_EQ(exported.points, timestamps.size());
+        EXPECT_EQ(exported.bytes, file.str().size());
+
+        const std::string name = compress ? "compressed" : "raw";
+        target.create_table(name, wide);
+        bulk::import_table(target, name, file);
+        auto results = target.query_columns(name, Query(TimeRange(), true), {0, 1, 2});
+        EXPECT_EQ(results.timestamps, timestamps);
+        EXPECT_EQ(results.columns, columns);
+
+        Table::Config narrow(3600, 24, 2, 60, 300);
+        target.create_table(name + "_narrow", narrow);
+        std::stringstream again(file.str());
+        EXPECT_THROW(bulk::import_table(target, name + "_narrow", again), std::runtime_error);
+        EXPECT_EQ(target.get_table(name + "_narrow")->rows(), 0);
+    }
+}
+
+// Test the integer and bitmap codecs round trip, including the full int64 range
+TEST(CodecTest, RoundTripsIntegerAndBitmapColumns) {
+    std::vector<int64_t> integers = {0, 1, 2, 3, 5, 8, -13, std::numeric_limits<int64_t>::max(),
+                                     std::numeric_limits<int64_t>::min(), 42};
+    std::vector<char> encoded{};
+    codec::encode_integers(integers.data(), integers.size(), encoded);
+    std::vector<int64_t> decoded(integers.size());
+    EXPECT_EQ(codec::decode_integers(encoded.data(), encoded.size(), integers.size(), decoded.data()),
+              encoded.size());
+    EXPECT_EQ(decoded, integers);
+
+    // A steady counter packs into a few bits per value
+    std::vector<int64_t> counter(1000);
+    for (size_t i = 0; i < counter.size(); ++i) {
+        counter[i] = 1000000 + static_cast<int64_t>(i) * 3;
+    }
+    encoded.clear();
+    codec::encode_integers(counter.data(), counter.size(), encoded);
+    EXPECT_LT(encoded.size(), counter.size());
+
+    bool flags[11] = {true, false, false, true, true, true, false, true, false, false, true};
+    encoded.clear();
+    codec::encode_bitmap(flags, 11, encoded);
+    EXPECT_EQ(encoded.size(), 2);
+    bool decoded_flags[11];
+    codec::decode_bitmap(encoded.data(), encoded.size(), 11, decoded_flags);
+    EXPECT_TRUE(std::equal(flags, flags + 11, decoded_flags));
+}
+
+// Test typed tables store values in their type and read them back as doubles after a reload
+TEST_F(DatabaseTest, TypedValueColumns) {
+    struct Case {
+        ValueType type;
+        double input;
+        double expected;
+    };
+    const std::vector<Case> cases = {
+        {ValueType::Float64, 2.1, 2.1},
+        {ValueType::Float32, 2.1, static_cast<double>(2.1f)},
+        {ValueType::Int64, 2.6, 3.0},
+        {ValueType::Bool, 2.1, 1.0},
+    };
+    for (const auto &c : cases) {
+        const std::string name = std::string("typed_") + value_type_name(c.type);
+        // One cached chunk, so the first partition is reloaded from its file
+        Table::Config config(3600, 1, 1, 60, 300, c.type);
+        db.create_table(name, config);
+        db.insert(name, {{0, 0.0}, {300, c.input}, {600, c.input}});
+        db.insert(name, {{2 * 3600, c.input}});
+
+        auto results = db.query(name, Query(TimeRange(0, 3599), true));
+        ASSERT_EQ(results.size(), 3) << name;
+        EXPECT_EQ(results[0].value, 0.0) << name;
+        EXPECT_EQ(results[1].value, c.expected) << name;
+        EXPECT_EQ(results[2].value, c.expected) << name;
+
+        auto filtered = db.query(name, Query(TimeRange(0, 3599), true, 0, ValuePredicate::greater(0.5)));
+        EXPECT_EQ(filtered.size(), 2) << name;
+    }
+    EXPECT_EQ(parse_value_type("int64"), ValueType::Int64);
+    EXPECT_THROW(parse_value_type("decimal"), std::invalid_argument);
+}
+
+// Test a narrow column halves (or better) the row buffer and survives copy on write
+TEST(ChunkSnapshotTest, TypedRowsUseNarrowStorage) {
+    EXPECT_EQ(value_size(ValueType::Float32), 4);
+    EXPECT_EQ(value_size(ValueType::Bool), 1);
+
+    Chunk chunk(TimeRange(0, 3600), 1, 12, ValueType::Int64);
+    chunk.append({600, 7.0});
+    chunk.append({0, 5.0}); // Out of order, so the rows are copied
+    auto snapshot = chunk.snapshot();
+    ASSERT_EQ(snapshot.value_type(), ValueType::Int64);
+    ASSERT_EQ(snapshot.size(), 2);
+    EXPECT_EQ(snapshot.column<int64_t>()[0], 5);
+    EXPECT_EQ(snapshot.column<int64_t>()[1], 7);
+    EXPECT_EQ(chunk.metadata().value_type, ValueType::Int64);
+}
+
+// Test wide table rows round trip and that projections read only the requested columns
+TEST_F(DatabaseTest, WideTableColumnProjection) {
+    // One cached chunk, so the first partition is read back from its file
+    Table::Config config(3600, 1, 1, 60, 300, ValueType::Float64, 3);
+    db.create_table("wide", config);
+    db.insert_rows("wide", {0, 300, 600}, {{1, 2, 3}, {10, 20, 30}, {100, 200, 300}});
+    EXPECT_THROW(db.insert_rows("wide", {0}, {{1}, {2}}), std::invalid_argument);
+    EXPECT_THROW(db.insert_rows("wide", {0}, {{1}, {2}, {}}), std::invalid_argument);
+
+    // Projected in the order asked for, with the predicate on the first projected column
+    auto check = [&](const ColumnQueryResult &result) {
+        ASSERT_EQ(result.timestamps, (std::vector<Timestamp>{300, 600}));
+        ASSERT_EQ(result.columns.size(), 2);
+        EXPECT_EQ(result.columns[0], (std::vector<double>{200, 300}));
+        EXPECT_EQ(result.columns[1], (std::vector<double>{2, 3}));
+    };
+    const Query query(TimeRange(0, 3599), true, 0, ValuePredicate::greater(150));
+    check(db.query_columns("wide", query, {2, 0}));
+
+    db.insert_rows("wide", {2 * 3600}, {{4}, {40}, {400}});
+    QueryStats one{};
+    check(db.query_columns("wide", query, {2, 0}));
+    db.query_columns("wide", query, {1}, &one);
+    QueryStats all{};
+    auto every = db.query_columns("wide", Query(TimeRange(0, 3599)), {0, 1, 2}, &all);
+    EXPECT_EQ(every.timestamps.size(), 3);
+    EXPECT_EQ(one.cache_misses, 1);
+    EXPECT_LT(one.bytes_read, all.bytes_read);
+    EXPECT_THROW(db.query_columns("wide", query, {3}), std::invalid_argument);
+
+    // Point inserts fill the other columns with NaN and queries see the first column
+    db.insert("wide", {{900, 5.0}});
+    auto points = db.query("wide", Query(TimeRange(0, 3599), true));
+    ASSERT_EQ(points.size(), 4);
+    EXPECT_EQ(points[3].value, 5.0);
+    auto row = db.query_columns("wide", Query(TimeRange(900, 901)), {1});
+    ASSERT_EQ(row.timestamps.size(), 1);
+    EXPECT_TRUE(std::isnan(row.columns[0][0]));
+}
+
+// Test chunk files carry a format version and files of another layout are refused
+TEST(ChunkFileTest, RejectsUnknownFormatVersion) {
+    const std::string dir = "./test_db_data/format";
+    std::filesystem::create_directories(dir);
+    Chunk chunk(TimeRange(0, 3600), 7, 12);
+    chunk.append({0, 1.0});
+    chunk.append({300, 2.0});
+    ChunkFile file(dir, chunk.metadata());
+    file.save(chunk);
+    EXPECT_EQ(file.load()->get_data_in_range(TimeRange(0, 3600)).size(), 2);
+
+    // Overwrites the 32-bit field at `offset` of the saved file
+    const auto patch = [&](std::streamoff offset, uint32_t value) {
+        std::fstream out(dir + "/chunk_7.bin", std::ios::in | std::ios::out | std::ios::binary);
+        out.seekp(offset);
+        out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    };
+    patch(4, CHUNK_FILE_VERSION + 1);
+    EXPECT_THROW(file.load(), std::runtime_error);
+    patch(4, CHUNK_FILE_VERSION);
+    EXPECT_EQ(file.load()->get_data_in_range(TimeRange(0, 3600)).size(), 2);
+    patch(0, 0);
+    EXPECT_THROW(file.load(), std::runtime_error);
+}
+
+// Test a regular series locates rows by arithmetic and tracks missing samples
+TEST(ChunkSnapshotTest, RegularSeriesImpliesTimestamps) {
+    Chunk chunk(TimeRange(0, 3600), 1, 12, ValueType::Float64, 1, 300);
+    chunk.append({0, 1.0});
+    chunk.append({600, 3.0});
+    chunk.append({1200, 5.0});
+    auto before = chunk.snapshot();
+    EXPECT_EQ(before.deltas(), nullptr);
+    EXPECT_EQ(before.size(), 5);
+    EXPECT_EQ(before.count(), 3);
+    EXPECT_EQ(before.get_index_range(TimeRange(300, 900)), std::make_pair(size_t{1}, size_t{4}));
+    EXPECT_EQ(before.timestamp_at(4), 1200);
+
+    // Filling a gap and a repeated (off grid) slot leave earlier snapshots alone
+    chunk.append({300, 2.0});
+    chunk.append({1250, 6.0});
+    auto points = chunk.get_data_in_range(TimeRange(0, 3600));
+    ASSERT_EQ(points.size(), 4);
+    EXPECT_EQ(points[1].ts, 300);
+    EXPECT_EQ(points[3].ts, 1200);
+    EXPECT_EQ(points[3].value, 6.0);
+    EXPECT_EQ(chunk.size(), 4);
+    EXPECT_EQ(before.get_data_in_range(TimeRange(0, 3600)).size(), 3);
+    EXPECT_EQ(before.value_at(4), 5.0);
+    EXPECT_FALSE(chunk.is_full());
+}
+
+// Test a replaced regular series sample leaves the chunk's sketch and bounds
+TEST_F(DatabaseTest, RegularSeriesReplacedSampleLeavesSketch) {
+    Table::Config regular(3600, 24, 2, 60, 300, ValueType::Float64, 1, true);
+    db.create_table("replaced", regular);
+    db.insert("replaced", {{0, 2.0}, {300, 3.0}});
+    for (int i = 0; i < 50; ++i) {
+        db.insert("replaced", {{1500, 100.0}});
+    }
+    db.insert("replaced", {{1500, 1.0}});
+
+    auto points = db.query("replaced", Query(TimeRange(0, 3599)));
+    ASSERT_EQ(points.size(), 3);
+    EXPECT_EQ(points[2].value, 1.0);
+    auto qs = db.quantiles("replaced", TimeRange(0, 3599), {0.5, 1.0});
+    EXPECT_NEAR(qs[0], 2.0, 0.05);
+    EXPECT_NEAR(qs[1], 3.0, 0.05);
+    // The bounds no longer admit the replaced value
+    EXPECT_TRUE(db.query("replaced", Query(TimeRange(0, 3599), true, 0, ValuePredicate::greater(50))).empty());
+    Chunk chunk(TimeRange(0, 3600), 1, 12, ValueType::Float64, 1, 300);
+    chunk.append({300, 100.0});
+    chunk.append({300, 1.0});
+    EXPECT_FALSE(chunk.may_match(ValuePredicate::greater(50)));
+    EXPECT_NEAR(chunk.sketch().quantile(1.0), 1.0, 0.02);
+}
+
+// Test regular series chunks survive a reload and take fewer bytes than stored timestamps
+TEST_F(DatabaseTest, RegularSeriesTable) {
+    // One cached chunk, so the first partition is read back from its file
+    Table::Config regular(3600, 1, 1, 60, 300, ValueType::Float64, 1, true);
+    Table::Config irregular(3600, 1, 1, 60, 300);
+    db.create_table("regular", regular);
+    db.create_table("irregular", irregular);
+
+    std::vector<DataPoint> points{};
+    for (Timestamp ts = 0; ts < 3600; ts += 300) {
+        if (ts != 1500) {
+            points.push_back({ts, static_cast<double>(ts)});
+        }
+    }
+    for (const char *name : {"regular", "irregular"}) {
+        db.insert(name, points);
+        db.insert(name, {{2 * 3600, 1.0}});
+    }
+
+    QueryStats regular_stats{};
+    QueryStats irregular_stats{};
+    auto regular_points = db.query("regular", Query(TimeRange(0, 3599), true), &regular_stats);
+    auto irregular_points = db.query("irregular", Query(TimeRange(0, 3599), true), &irregular_stats);
+    ASSERT_EQ(regular_points.size(), points.size());
+    for (size_t i = 0; i < points.size(); i++) {
+        EXPECT_EQ(regular_points[i].ts, points[i].ts);
+        EXPECT_EQ(regular_points[i].value, points[i].value);
+    }
+    EXPECT_EQ(regular_stats.cache_misses, 1);
+    EXPECT_LT(regular_stats.bytes_read, irregular_stats.bytes_read);
+
+    auto filtered = db.query("regular", Query(TimeRange(0, 3599), true, 0, ValuePredicate::greater(1000)));
+    EXPECT_EQ(filtered.size(), 7);
+    auto latest = db.query("regular", Query::latest(2, TimeRange(0, 3599)));
+    ASSERT_EQ(latest.size(), 2);
+    EXPECT_EQ(latest[0].ts, 3300);
+}
+
+// Test a chunk grows its rows past the initial capacity instead of dropping points
+TEST(ChunkSnapshotTest, FullChunkGrows) {
+    Chunk chunk(TimeRange(0, 3600), 1, 4);
+    for (Timestamp ts = 100; ts <= 1000; ts += 100) {
+        chunk.append({ts, static_cast<double>(ts)});
+    }
+    auto before = chunk.snapshot();
+    chunk.append({50, 0.5}); // Out of order into a full buffer
+    EXPECT_EQ(before.size(), 10);
+    EXPECT_EQ(before.timestamp_at(0), 100);
+
+    auto points = chunk.get_data_in_range(TimeRange(0, 3600));
+    ASSERT_EQ(points.size(), 11);
+    EXPECT_EQ(points[0].ts, 50);
+    EXPECT_EQ(points[10].ts, 1000);
+    EXPECT_GE(chunk.capacity(), 11);
+    EXPECT_EQ(chunk.metadata().row_count, 11);
+}
+
+// Test chunk widths follow the ingest rate and bursts above the resolution keep every point
+TEST_F(DatabaseTest, AdaptiveChunkWidth) {
+    // Points every second against a declared 300 s resolution, so chunks fill 12 times over
+    std::vector<DataPoint> points{};
+    for (Timestamp ts = 0; ts < 4 * 3600; ts++) {
+        points.push_back({ts, static_cast<double>(ts % 7)});
+    }
+
+    // About 64 rows (1 KiB) per chunk: a point a second narrows chunks as far as allowed
+    Table::Config narrow(3600, 64, 4, 60, 300, ValueType::Float64, 1, false, 1024);
+    // Sparse relative to a 1 MiB target, so chunks widen instead
+    Table::Config wide(3600, 64, 4, 60, 300, ValueType::Float64, 1, false, 1 << 20);
+    Table::Config fixed(3600, 64, 4, 60, 300);
+    db.create_table("adaptive_narrow", narrow);
+    db.create_table("adaptive_wide", wide);
+    db.create_table("adaptive_fixed", fixed);
+    for (const char *name : {"adaptive_narrow", "adaptive_wide", "adaptive_fixed"}) {
+        for (size_t i = 0; i < points.size(); i += 1000) {
+            db.insert(name, std::vector<DataPoint>(points.begin() + i,
+                                                   points.begin() + std::min(points.size(), i + 1000)));
+        }
+    }
+
+    // Every table keeps every point, in order
+    // Starts past the boundary, as a range query also matches the chunk ending where it starts
+    const Query late(TimeRange(2 * 3600 + 1, 3 * 3600 - 1), true);
+    std::map<std::string, QueryStats> stats{};
+    for (const char *name : {"adaptive_narrow", "adaptive_wide", "adaptive_fixed"}) {
+        auto all = db.query(name, Query(TimeRange(0, 4 * 3600), true));
+        ASSERT_EQ(all.size(), points.size()) << name;
+        EXPECT_EQ(all.back().ts, 4 * 3600 - 1) << name;
+
+        auto results = db.query(name, late, &stats[name]);
+        ASSERT_EQ(results.size(), 3599) << name;
+        EXPECT_EQ(results.front().ts, 2 * 3600 + 1) << name;
+    }
+    EXPECT_EQ(stats["adaptive_fixed"].chunks_matched, 1);
+    // Narrowed to 900 s, the smallest width that stays a multiple of the resolution
+    EXPECT_EQ(stats["adaptive_narrow"].chunks_matched, 4);
+    EXPECT_EQ(stats["adaptive_wide"].chunks_matched, 1);
+}
+
+TEST(AioTest, EnginesTransferWholeRanges) {
+    for (auto backend : {aio::Backend::Uring, aio::Backend::Threads}) {
+        auto engine = aio::make_engine(backend);
+        if (backend == aio::Backend::Threads) {
+            EXPECT_EQ(engine->backend(), aio::Backend::Threads);
+        }
+        char path[] = "/tmp/tsdb_aio_XXXXXX";
+        int fd = mkstemp(path);
+        ASSERT_GE(fd, 0);
+        unlink(path);
+
+        // Many writes in one batch, each at its own offset
+        constexpr size_t blocks = 100, block_bytes = 4096;
+        std::vector<char> out(blocks * block_bytes);
+        for (size_t i = 0; i < out.size(); i++) {
+            out[i] = static_cast<char>(i * 31 + i / block_bytes);
+        }
+        std::vector<aio::Request> writes{};
+        for (size_t b = 0; b < blocks; b++) {
+            writes.push_back({fd, b * block_bytes, out.data() + b * block_bytes, block_bytes, true});
+        }
+        engine->submit(writes);
+        for (const auto &request : writes) {
+            EXPECT_EQ(request.result, static_cast<ssize_t>(block_bytes));
+        }
+
+        // Reads of the whole file, one past its end and one with a bad descriptor
+        std::vector<char> in(out.size() + 100);
+        std::vector<aio::Request> reads{
+            {fd, 0, in.data(), out.size() - 10},
+            {fd, out.size() - 10, in.data() + out.size() - 10, 110},
+            {-1, 0, in.data(), 1},
+        };
+        engine->submit(reads);
+        EXPECT_EQ(reads[0].result, static_cast<ssize_t>(out.size() - 10));
+        EXPECT_EQ(reads[1].result, 10); // Stops at end of file
+        EXPECT_EQ(reads[2].result, -EBADF);
+        EXPECT_TRUE(std::equal(out.begin(), out.end(), in.begin()));
+        close(fd);
+    }
+
+    // Released buffers are handed out again when they fit
+    aio::BufferPool pool(2, 1 << 20);
+    auto buffer = pool.acquire(1000);
+    const char *data = buffer.data.get();
+    pool.release(std::move(buffer));
+    auto reused = pool.acquire(500);
+    EXPECT_EQ(reused.data.get(), data);
+    EXPECT_EQ(reused.size, 500);
+    EXPECT_NE(pool.acquire(2000).data.get(), data);
+}
+
+TEST_F(DatabaseTest, PipelinedQueriesRunConcurrently) {
+    // Two cached chunks out of 24, so nearly every query streams its chunks from disk
+    Table::Config small_cache(3600, 2, 2, 60, 300);
+    db.create_table("pipelined", small_cache);
+    std::vector<DataPoint> points;
+    for (int i = 0; i < 24 * 12; ++i) {
+        points.push_back({static_cast<Timestamp>(i * 300), static_cast<double>(i)});
+    }
+    db.insert("pipelined", points);
+
+    // Far more queries in flight than the table has pool threads
+    std::atomic<int> wrong{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 24; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int r = 0; r < 10; ++r) {
+                const Timestamp start = ((t + r) % 12) * 3600;
+                auto results = db.query("pipelined", Query(TimeRange(start, start + 6 * 3600 - 1), true));
+                if (results.size() != 6 * 12 || results.front().ts != start ||
+                    !std::is_sorted(results.begin(), results.end(),
+                                    [](const DataPoint &a, const DataPoint &b) { return a.ts < b.ts; })) {
+                    wrong++;
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(wrong, 0);
+
+    // A limit met by the leading chunks still returns whole, filtered results
+    QueryStats stats;
+    auto limited = db.query("pipelined", Query(TimeRange(), false, 30, ValuePredicate::greater(100)), &stats);
+    ASSERT_EQ(limited.size(), 30);
+    for (const auto &point : limited) {
+        EXPECT_GT(point.value, 100);
+    }
+    EXPECT_EQ(stats.chunks_matched, 24);
+}
+
+TEST(ExecutorTest, IdleWorkersStealQueuedTasks) {
+    WorkStealingExecutor executor(4);
+
+    // Every task lands on one worker's deque, yet the others take some of them
+    std::mutex mutex;
+    std::set<std::thread::id> ran_on;
+    executor.enqueue([&]() {
+        executor.parallel_for(64, [&](size_t) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            std::lock_guard<std::mutex> lock(mutex);
+            ran_on.insert(std::this_thread::get_id());
+        });
+    }).get();
+    EXPECT_GT(ran_on.size(), 1);
+
+    // Nested loops finish, as waiting threads run queued tasks
+    std::atomic<size_t> sum{0};
+    executor.parallel_for(16, [&](size_t i) {
+        executor.parallel_for(100, [&](size_t j) { sum += i * 100 + j; });
+    });
+    EXPECT_EQ(sum, 1600 * 1599 / 2);
+
+    EXPECT_THROW(executor.parallel_for(8, [](size_t i) {
+        if (i == 3)
+            throw std::runtime_error("morsel failed");
+    }), std::runtime_error);
+}
+
+TEST_F(DatabaseTest, SkewedChunkScansInMorsels) {
+    // One chunk with 50000 points, then chunks with a handful each
+    Table::Config skewed(100000, 4, 2, 60, 1);
+    db.create_table("skewed", skewed);
+    std::vector<DataPoint> points;
+    for (Timestamp ts = 0; ts < 50000; ++ts) {
+        points.push_back({ts, static_cast<double>(ts % 1000)});
+    }
+    for (Timestamp ts = 100000; ts < 1000000; ts += 10000) {
+        points.push_back({ts, 5000.0});
+    }
+    db.insert("skewed", points);
+
+    QueryStats stats;
+    auto all = db.query("skewed", Query(TimeRange(0, 1000000), true), &stats);
+    ASSERT_EQ(all.size(), points.size());
+    for (size_t i = 0; i < all.size(); ++i) {
+        ASSERT_EQ(all[i].ts, points[i].ts);
+    }
+    EXPECT_EQ(stats.rows_scanned, points.size());
+
+    // Morsels keep row order within the large chunk, with or without a predicate
+    auto high = db.query("skewed", Query(TimeRange(0, 49999), false, 0, ValuePredicate::greater(990)));
+    ASSERT_EQ(high.size(), 50 * 9);
+    EXPECT_TRUE(std::is_sorted(high.begin(), high.end(),
+                               [](const DataPoint &a, const DataPoint &b) { return a.ts < b.ts; }));
+
+    // Bucket partials from neighbouring morsels merge to the same extremes
+    auto extremes = db.query("skewed", Query::downsampled(TimeRange(0, 49999), 2, DownsampleMethod::MinMax));
+    ASSERT_EQ(extremes.size(), 2);
+    EXPECT_EQ(extremes[0].value, 0);
+    EXPECT_EQ(extremes[1].value, 999);
+}
+
+TEST_F(DatabaseTest, RepeatedQueriesRescanOnlyNewRows) {
+    Table::Config config(3600, 24, 2, 60, 60);
+    db.create_table("dashboard", config);
+    std::vector<DataPoint> points;
+    for (Timestamp ts = 0; ts < 5 * 3600; ts += 300) {
+        points.push_back({ts, static_cast<double>(ts % 7)});
+    }
+    // The head chunk is half full at first
+    const auto half = points.begin() + 4 * 12 + 6;
+    db.insert("dashboard", std::vector<DataPoint>(points.begin(), half));
+
+    auto same = [](const std::vector<DataPoint> &a, const std::vector<DataPoint> &b) {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const DataPoint &x, const DataPoint &y) {
+            return x.ts == y.ts && x.value == y.value;
+        });
+    };
+    const Query window(TimeRange(0, 5 * 3600 - 1), true);
+    // The first run only marks the query as seen, the second keeps its matches
+    QueryStats first;
+    auto before = db.query("dashboard", window, &first);
+    EXPECT_EQ(before.size(), 4 * 12 + 6);
+    EXPECT_EQ(first.partials_reused, 0);
+    EXPECT_EQ(first.rows_scanned, 4 * 12 + 6);
+    QueryStats second;
+    db.query("dashboard", window, &second);
+    EXPECT_EQ(second.partials_reused, 0);
+
+    // Nothing changed: every chunk's matches come from the cache
+    QueryStats repeat;
+    EXPECT_TRUE(same(db.query("dashboard", window, &repeat), before));
+    EXPECT_EQ(repeat.partials_reused, 5);
+    EXPECT_EQ(repeat.rows_scanned, 0);
+
+    // Only the points appended to the head chunk are scanned
+    db.insert("dashboard", std::vector<DataPoint>(half, points.end()));
+    QueryStats refresh;
+    auto after = db.query("dashboard", window, &refresh);
+    EXPECT_TRUE(same(after, points));
+    EXPECT_EQ(refresh.partials_reused, 5);
+    EXPECT_EQ(refresh.rows_scanned, 6);
+
+    // A window whose end moves forward extends the entry; another predicate does not share it
+    QueryStats shorter;
+    db.query("dashboard", Query(TimeRange(0, 4 * 3600 + 1000), true), &shorter);
+    QueryStats longer;
+    auto extended = db.query("dashboard", Query(TimeRange(0, 4 * 3600 + 2000), true), &longer);
+    EXPECT_EQ(extended.size(), 4 * 12 + 7);
+    EXPECT_EQ(longer.partials_reused, 5);
+    EXPECT_EQ(longer.rows_scanned, 3);
+    QueryStats filtered;
+    const Query high_values(window.m_time_range, true, 0, ValuePredicate::greater(3));
+    db.query("dashboard", high_values);
+    auto high = db.query("dashboard", high_values, &filtered);
+    EXPECT_EQ(filtered.partials_reused, 0);
+    for (const auto &point : high) {
+        EXPECT_GT(point.value, 3);
+    }
+}